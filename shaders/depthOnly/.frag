@@ -0,0 +1,4 @@
+#version 430 core
+
+void main() {
+}
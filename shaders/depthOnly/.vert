@@ -0,0 +1,14 @@
+#version 430 core
+layout(location = 0) in vec4 a_position;
+// per instance data, same locations as the prop shader
+layout(location = 6) in mat4 a_modelMat;
+
+// must match the prop shader bit for bit, the shading pass after the pre-pass tests with GL_EQUAL
+invariant gl_Position;
+
+uniform mat4 u_viewMat;
+uniform mat4 u_projectionMat;
+
+void main() {
+    gl_Position = u_projectionMat * u_viewMat * a_modelMat * a_position;
+}
@@ -1,8 +1,6 @@
-#version 330 core
+#version 430 core
 out vec4 o_color;
 
-uniform vec4 u_fgColor;
-uniform vec4 u_bgColor;
 uniform sampler2D u_atlas;
 uniform float u_screenPxRange;
 
@@ -10,6 +8,8 @@ in VS_OUT {
     vec2 texCoord;
     vec2 glyphOffset;
     vec2 glyphSize;
+    flat vec4 fgColor;
+    flat vec4 bgColor;
 } fs_in;
 
 float median(float r, float g, float b) {
@@ -22,6 +22,6 @@ void main() {
     float sd = median(msd.r, msd.g, msd.b);
     float screenPxDistance = u_screenPxRange * (sd - 0.5);
     float opacity = clamp(screenPxDistance + 0.5, 0.0, 1.0);
-    o_color = mix(u_bgColor, u_fgColor, opacity);
+    o_color = mix(fs_in.bgColor, fs_in.fgColor, opacity);
     gl_FragDepth = 0;
 }
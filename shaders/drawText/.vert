@@ -1,12 +1,15 @@
-#version 330 core
-layout(location = 0) in vec2 a_quadPosition;
+#version 430 core
+layout(location = 0) in vec2 a_offset;
 layout(location = 1) in vec2 a_quadSize;
 layout(location = 2) in vec2 a_glyphOffset;
 layout(location = 3) in vec2 a_glyphSize;
+layout(location = 4) in uint a_text;
 out VS_OUT {
     vec2 texCoord;
     vec2 glyphOffset;
     vec2 glyphSize;
+    flat vec4 fgColor;
+    flat vec4 bgColor;
 } vs_out;
 
 vec2 vertices[4] = vec2[4](
@@ -16,12 +19,27 @@ vec2 vertices[4] = vec2[4](
     vec2(0, 1)
 );
 
-uniform mat4 u_projMat;
+struct TextData
+{
+    mat4 matrix;
+    vec4 fgColor;
+    vec4 bgColor;
+    vec2 position; // in pixels
+    float size; // glyph offsets and sizes are in units of it
+    float _pad0;
+}; // 112 bytes
+layout(std430, binding = 6) readonly buffer u_texts {
+    TextData texts[];
+};
+
 uniform float u_depth = 0;
 void main() {
+    TextData text = texts[a_text];
     vs_out.texCoord = vertices[gl_VertexID];
     vs_out.glyphOffset = a_glyphOffset;
     vs_out.glyphSize = a_glyphSize;
-    vec4 position = u_projMat * vec4(a_quadPosition + vs_out.texCoord * a_quadSize, 0, 1);
+    vs_out.fgColor = text.fgColor;
+    vs_out.bgColor = text.bgColor;
+    vec4 position = text.matrix * vec4(text.position + (a_offset + vs_out.texCoord * a_quadSize) * text.size, 0, 1);
     gl_Position = vec4(position.xy, u_depth, position.w);
 }
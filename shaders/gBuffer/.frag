@@ -0,0 +1,47 @@
+#version 430 core
+layout(location = 0) out vec4 o_albedo; // rgb albedo, a specular strength
+layout(location = 1) out vec2 o_normal; // octahedral
+layout(location = 2) out float o_shininess; // over MAX_SHININESS
+
+const float opaqueTreshold = 0.9;
+const float MAX_SHININESS = 256.0; // see game::RenderTarget::MAX_SHININESS
+
+#include "material.glsl"
+
+in VS_OUT {
+    vec2 texCoords;
+    vec3 fragPos;
+    flat mat3 TBN;
+    flat vec4 color;
+} fs_in;
+
+uniform Material u_material;
+
+vec2 encodeOctahedral(vec3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 folded = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    return normal.z >= 0.0 ? normal.xy : folded;
+}
+
+void main() 
+{
+    vec2 texCoords = fs_in.texCoords;
+    vec4 albedo = texture(u_material.diffuse, texCoords) * fs_in.color;
+#ifdef ALPHA_TEST
+    if(albedo.a < opaqueTreshold) discard;
+#endif
+
+#ifdef HAS_NORMAL_MAP
+    vec3 normal = normalize(fs_in.TBN * normalize(texture(u_material.normal, texCoords).rgb * 2.0 - 1.0));
+#else
+    vec3 normal = normalize(fs_in.TBN[2]);
+#endif
+#ifdef HAS_ROUGH_MAP
+    o_albedo = vec4(albedo.rgb, 1.0 - texture(u_material.rough, texCoords).r);
+#else
+    o_albedo = vec4(albedo.rgb, 0.0);
+#endif
+    o_normal = encodeOctahedral(normal);
+    o_shininess = clamp(u_material.shininess / MAX_SHININESS, 0.0, 1.0);
+}
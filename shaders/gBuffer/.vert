@@ -0,0 +1,60 @@
+#version 430 core
+layout(location = 0) in vec4 a_position;
+layout(location = 1) in vec4 a_normal;
+layout(location = 2) in vec2 a_texCoord;
+layout(location = 3) in vec4 a_tangent;
+layout(location = 4) in ivec4 a_boneIDs;
+layout(location = 5) in vec4 a_weights;
+// per instance data
+layout(location = 6) in mat4 a_modelMat;
+layout(location = 10) in mat4 a_normalMat;
+layout(location = 14) in vec4 a_color;
+
+out VS_OUT {
+    vec2 texCoords;
+    vec3 fragPos;
+    flat mat3 TBN;
+    flat vec4 color;
+} vs_out;
+
+invariant gl_Position; // the depth pre-pass computes the same position
+
+const int MAX_BONE_INFLUENCE = 4;
+
+uniform mat4 u_viewMat;
+uniform mat4 u_projectionMat;
+
+#ifdef SKINNED
+layout(std430, binding = 5) readonly buffer u_bones {
+    mat4 u_boneMatrices[];
+};
+#endif
+uniform uint u_texCoordMult;
+
+void main() {
+#ifdef SKINNED
+    vec4 position = vec4(0);
+    for(int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+        if(a_boneIDs[i] == -1) continue;
+        if(a_boneIDs[i] >= u_boneMatrices.length()) {
+            position = a_position;
+            break;
+        }
+        vec4 localPosition = u_boneMatrices[a_boneIDs[i]] * a_position;
+        position += localPosition * a_weights[i];
+    }
+#else
+    vec4 position = a_position;
+#endif
+
+    gl_Position = u_projectionMat * u_viewMat * a_modelMat * position;
+    vs_out.texCoords = a_texCoord * u_texCoordMult;
+    vs_out.fragPos = vec3(a_modelMat * a_position);
+    
+    vec3 normal = normalize(vec3(a_normalMat * a_normal));
+    vec3 tangent = normalize(vec3(a_normalMat * vec4(a_tangent.xyz, 0.0)));
+    tangent = normalize(tangent - dot(tangent, normal) * normal);
+    vec3 bitangent = cross(tangent, normal);
+    vs_out.TBN = mat3(tangent, bitangent, normal);
+    vs_out.color = a_color;
+}
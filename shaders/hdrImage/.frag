@@ -2,14 +2,17 @@
 
 layout(binding = 0) uniform sampler2D u_texture;
 uniform float u_exposure = 1;
+uniform ivec2 u_renderSize; // of the part of u_texture that was rendered to, see dynamic resolution
+uniform ivec2 u_outputSize;
 
 out vec4 o_color;
 
 void main() {
-    vec2 texCoord = gl_FragCoord.xy / textureSize(u_texture, 0);
-    vec3 hdrColor = texture(u_texture, texCoord).rgb;
+    // pooled textures can be larger than the rendered part, keep the bilinear footprint inside it
+    vec2 texelCoord = clamp(gl_FragCoord.xy * vec2(u_renderSize) / vec2(u_outputSize), vec2(0.5), vec2(u_renderSize) - 0.5);
+    vec3 hdrColor = texture(u_texture, texelCoord / vec2(textureSize(u_texture, 0))).rgb;
     vec3 mappedColor = 1 - exp(-hdrColor * u_exposure);
     
     o_color = vec4(mappedColor, 1);
     o_color.rgb = pow(o_color.rgb, vec3(1/2.2)); // apply gamma correction
-}
\ No newline at end of file
+}
@@ -0,0 +1,15 @@
+// the light buffers, read only, see game::LightBuffer. shared by the shading passes and the cluster assignment
+#include "lightTypes.glsl"
+
+layout(std430, binding = 2) readonly buffer u_pointLights {
+    uint numPointLights;
+    PointLight pointLights[];
+};
+layout(std430, binding = 3) readonly buffer u_dirLights {
+    uint numDirLights;
+    DirLight dirLights[];
+};
+layout(std430, binding = 4) readonly buffer u_spotLights {
+    uint numSpotLights;
+    SpotLight spotLights[];
+};
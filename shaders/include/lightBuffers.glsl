@@ -0,0 +1,16 @@
+// the light buffers and clusters as the shading passes read them, see game::LightClusters::bind
+#include "lightBlocks.glsl"
+
+layout(std430, binding = 1) readonly buffer u_lightClusters {
+    Cluster clusters[];
+};
+uniform vec2 u_screenSize;
+uniform float u_clusterScale; // depth slice = log(view depth) * scale + bias
+uniform float u_clusterBias;
+
+uint getCluster(float viewDepth, vec2 fragCoord)
+{
+    uvec2 tile = uvec2(clamp(fragCoord / u_screenSize * vec2(GRID_X, GRID_Y), vec2(0), vec2(GRID_X - 1u, GRID_Y - 1u)));
+    uint slice = uint(clamp(log(max(viewDepth, 1e-6)) * u_clusterScale + u_clusterBias, 0.0, float(GRID_Z - 1u)));
+    return tile.x + tile.y * GRID_X + slice * GRID_X * GRID_Y;
+}
@@ -0,0 +1,39 @@
+// gpu side of the light buffers and clusters, mirrored by game::LightUpdater::Shader*Light and game::LightClusters::Cluster.
+// the cpu registers the layout it expects, see opengl::ShaderProgram::expectBufferLayout
+
+const uint GRID_X = 16u; // light clusters, see game::LightClusters
+const uint GRID_Y = 9u;
+const uint GRID_Z = 24u;
+const uint MAX_LIGHTS_PER_CLUSTER = 62u;
+
+struct PointLight
+{
+    vec3 color;
+    float attenuation;
+    vec3 position;
+    float radius;
+}; // 32 bytes
+struct DirLight
+{
+    vec3 direction;
+    float _pad0;
+    vec3 color;
+    float _pad1;
+}; // 32 bytes
+struct SpotLight
+{
+    vec3 position;
+    float innerConeAngle;
+    vec3 direction;
+    float outerConeAngle;
+    vec3 _pad1;
+    float attenuation;
+    vec3 color;
+    float radius;
+}; // 64 bytes
+struct Cluster
+{
+    uint pointCount;
+    uint spotCount;
+    uint lights[MAX_LIGHTS_PER_CLUSTER]; // point light indices, then spot light indices
+}; // 256 bytes
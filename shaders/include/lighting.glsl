@@ -0,0 +1,36 @@
+// light model of the forward shaders, the includer defines ambientKoeffitient
+#include "material.glsl"
+#include "lightBuffers.glsl"
+#include "surfaceLighting.glsl"
+
+vec3 getSpecularStrength(Material material, vec2 texCoords)
+{
+#ifdef HAS_ROUGH_MAP
+    return vec3(1.0) - texture(material.rough, texCoords).rgb;
+#else
+    return vec3(0); // as if the default white rough texture was bound
+#endif
+}
+Surface getSurface(Material material, vec3 normal, vec3 viewDir, vec2 texCoords, vec3 fragPos)
+{
+    Surface surface;
+    surface.position = fragPos;
+    surface.normal = normalize(normal);
+    surface.viewDir = normalize(viewDir);
+    surface.specular = getSpecularStrength(material, texCoords);
+    surface.shininess = material.shininess;
+    return surface;
+}
+
+vec4 calculateLight(PointLight light, Material material, vec3 normal, vec3 viewDir, vec2 texCoords, vec3 fragPos) 
+{
+    return vec4(calculateLight(light, getSurface(material, normal, viewDir, texCoords, fragPos)), 1.0);
+}
+vec4 calculateLight(DirLight light, Material material, vec3 normal, vec3 viewDir, vec2 texCoords, vec3 fragPos) 
+{
+    return vec4(calculateLight(light, getSurface(material, normal, viewDir, texCoords, fragPos)), 1.0);
+}
+vec4 calculateLight(SpotLight light, Material material, vec3 normal, vec3 viewDir, vec2 texCoords, vec3 fragPos)
+{
+    return vec4(calculateLight(light, getSurface(material, normal, viewDir, texCoords, fragPos)), 1.0);
+}
@@ -0,0 +1,10 @@
+// textures and constants of a mesh, see game::Renderer::drawGroups. which samplers are read depends on the variant,
+// see game::Renderer::MaterialFeature
+
+struct Material
+{
+    sampler2D diffuse;
+    sampler2D normal;
+    sampler2D rough;
+    float shininess;
+};
@@ -0,0 +1,49 @@
+// the light model, shared by the forward shaders and the deferred lighting pass. the includer defines ambientKoeffitient
+#include "lightTypes.glsl"
+
+// what the light model needs to know about a shaded point, the normal and the view direction are normalized
+struct Surface
+{
+    vec3 position;
+    vec3 normal;
+    vec3 viewDir;
+    vec3 specular; // strength per channel
+    float shininess;
+};
+
+vec3 calculateLight(PointLight light, Surface surface)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    float distanceLightFragment = length(light.position - surface.position);
+    if(distanceLightFragment > light.radius) return vec3(0); // the clusters only know the light up to its radius
+    float attenuation = 1.0 / (light.attenuation * distanceLightFragment * distanceLightFragment);
+
+    vec3 ambient = light.color * ambientKoeffitient * attenuation;
+    vec3 diffuse = light.color * attenuation * max(dot(surface.normal, lightDir), 0.0);
+    vec3 specular = light.color * attenuation * pow(max(dot(surface.normal, normalize(lightDir + surface.viewDir)), 0.0), surface.shininess) * surface.specular;
+    return ambient + diffuse + specular;
+}
+vec3 calculateLight(DirLight light, Surface surface)
+{
+    vec3 lightDir = normalize(-light.direction);
+
+    vec3 ambient = light.color * ambientKoeffitient;
+    vec3 diffuse = light.color * max(dot(surface.normal, lightDir), 0.0);
+    vec3 specular = light.color * pow(max(dot(surface.normal, normalize(lightDir + surface.viewDir)), 0.0), surface.shininess) * surface.specular;
+    return ambient + diffuse + specular;
+}
+vec3 calculateLight(SpotLight light, Surface surface)
+{
+    vec3 lightDir = normalize(light.position - surface.position);
+    float distanceLightFragment = length(light.position - surface.position);
+    if(distanceLightFragment > light.radius) return vec3(0);
+    float attenuation = 1.0 / (light.attenuation * distanceLightFragment * distanceLightFragment);
+
+    vec3 ambient = light.color * ambientKoeffitient * attenuation;
+    float theta = dot(lightDir, normalize(-light.direction));
+    if(theta <= light.outerConeAngle) return ambient;
+    float intensity = clamp((theta - light.outerConeAngle) / (light.innerConeAngle - light.outerConeAngle), 0.0, 1.0);
+    vec3 diffuse = light.color * intensity * attenuation * max(dot(surface.normal, lightDir), 0.0);
+    vec3 specular = light.color * intensity * attenuation * pow(max(dot(surface.normal, normalize(lightDir + surface.viewDir)), 0.0), surface.shininess) * surface.specular;
+    return ambient + diffuse + specular;
+}
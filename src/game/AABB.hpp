@@ -11,4 +11,10 @@ public:
         min = glm::min(min, point);
         max = glm::max(max, point);
     }
-};
\ No newline at end of file
+    inline void growToInclude(AABB const &other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    inline vec_t getCenter() const { return (min + max) * 0.5f; }
+    inline vec_t getExtents() const { return (max - min) * 0.5f; }
+};
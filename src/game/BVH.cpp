@@ -0,0 +1,181 @@
+#include "BVH.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+    constexpr unsigned MAX_DEPTH = 60; // traversal stacks hold 64 entries
+
+    AABB<glm::vec3> emptyBox()
+    {
+        return AABB<glm::vec3>{glm::vec3{std::numeric_limits<float>::max()}, glm::vec3{std::numeric_limits<float>::lowest()}};
+    }
+    float surfaceArea(AABB<glm::vec3> const &box)
+    {
+        glm::vec3 size = glm::max(box.max - box.min, glm::vec3{0});
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+    // entry distance of the ray into the box, or a negative value on miss
+    float intersectRay(AABB<glm::vec3> const &box, glm::vec3 const &origin, glm::vec3 const &inverseDirection, float maxDistance)
+    {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 tmin = glm::min(t0, t1);
+        glm::vec3 tmax = glm::max(t0, t1);
+        float enter = std::max({tmin.x, tmin.y, tmin.z, 0.0f});
+        float exit = std::min({tmax.x, tmax.y, tmax.z, maxDistance});
+        return enter <= exit ? enter : -1.0f;
+    }
+} // namespace
+
+game::BVH::BVH(std::vector<AABB<glm::vec3>> const &primitives)
+{
+    build(primitives);
+}
+
+void game::BVH::clear()
+{
+    m_nodes.clear();
+    m_order.clear();
+    m_primitiveBounds.clear();
+}
+
+void game::BVH::build(std::vector<AABB<glm::vec3>> const &primitives)
+{
+    clear();
+    if(primitives.empty()) return;
+    m_primitiveBounds = primitives;
+    m_order.resize(primitives.size());
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::vector<glm::vec3> centroids(primitives.size());
+    for(size_t i = 0; i < primitives.size(); ++i) {
+        centroids[i] = primitives[i].getCenter();
+    }
+
+    m_nodes.reserve(primitives.size() * 2);
+    m_nodes.push_back(Node{.bounds = {}, .offset = 0, .count = static_cast<unsigned>(primitives.size())});
+    subdivide(0, 0, centroids);
+    m_nodes.shrink_to_fit();
+}
+
+void game::BVH::subdivide(unsigned nodeIndex, unsigned depth, std::vector<glm::vec3> const &centroids)
+{
+    unsigned const first = m_nodes[nodeIndex].offset;
+    unsigned const count = m_nodes[nodeIndex].count;
+
+    AABB<glm::vec3> bounds = emptyBox();
+    AABB<glm::vec3> centroidBounds = emptyBox();
+    for(unsigned i = first; i < first + count; ++i) {
+        bounds.growToInclude(m_primitiveBounds[m_order[i]]);
+        centroidBounds.growToInclude(centroids[m_order[i]]);
+    }
+    m_nodes[nodeIndex].bounds = bounds;
+    if(count <= 1 || depth >= MAX_DEPTH) return;
+
+    // find the cheapest of BIN_COUNT - 1 candidate planes on every axis
+    struct Bin
+    {
+        AABB<glm::vec3> bounds = emptyBox();
+        unsigned count = 0;
+    };
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    unsigned bestPlane = 0;
+    glm::vec3 const extent = centroidBounds.max - centroidBounds.min;
+    for(int axis = 0; axis < 3; ++axis) {
+        if(extent[axis] <= 0) continue;
+        float const scale = BIN_COUNT / extent[axis];
+        Bin bins[BIN_COUNT];
+        for(unsigned i = first; i < first + count; ++i) {
+            unsigned bin = std::min(BIN_COUNT - 1, static_cast<unsigned>((centroids[m_order[i]][axis] - centroidBounds.min[axis]) * scale));
+            bins[bin].bounds.growToInclude(m_primitiveBounds[m_order[i]]);
+            ++bins[bin].count;
+        }
+        // sweep from both sides, leftCost[i] covers bins [0, i]
+        float leftCost[BIN_COUNT - 1];
+        AABB<glm::vec3> leftBounds = emptyBox();
+        unsigned leftCount = 0;
+        for(unsigned i = 0; i < BIN_COUNT - 1; ++i) {
+            leftBounds.growToInclude(bins[i].bounds);
+            leftCount += bins[i].count;
+            leftCost[i] = leftCount > 0 ? leftCount * surfaceArea(leftBounds) : 0;
+        }
+        AABB<glm::vec3> rightBounds = emptyBox();
+        unsigned rightCount = 0;
+        for(unsigned i = BIN_COUNT - 1; i > 0; --i) {
+            rightBounds.growToInclude(bins[i].bounds);
+            rightCount += bins[i].count;
+            float cost = leftCost[i - 1] + (rightCount > 0 ? rightCount * surfaceArea(rightBounds) : 0);
+            if(cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestPlane = i;
+            }
+        }
+    }
+
+    // keep the leaf if splitting does not pay off, one traversal step costs about as much as one box test
+    float const leafCost = count * surfaceArea(bounds);
+    if(bestAxis < 0 || (count <= MAX_LEAF_SIZE && bestCost + surfaceArea(bounds) >= leafCost)) return;
+
+    float const scale = BIN_COUNT / extent[bestAxis];
+    auto middle = std::partition(m_order.begin() + first, m_order.begin() + first + count, [&](unsigned primitive) {
+        return std::min(BIN_COUNT - 1, static_cast<unsigned>((centroids[primitive][bestAxis] - centroidBounds.min[bestAxis]) * scale)) < bestPlane;
+    });
+    unsigned leftCount = static_cast<unsigned>(middle - (m_order.begin() + first));
+    if(leftCount == 0 || leftCount == count) {
+        // every centroid fell into one bin, split at the median instead
+        leftCount = count / 2;
+        std::nth_element(m_order.begin() + first, m_order.begin() + first + leftCount, m_order.begin() + first + count, [&](unsigned a, unsigned b) {
+            return centroids[a][bestAxis] < centroids[b][bestAxis];
+        });
+    }
+
+    unsigned const leftIndex = static_cast<unsigned>(m_nodes.size());
+    m_nodes.push_back(Node{.bounds = {}, .offset = first, .count = leftCount});
+    subdivide(leftIndex, depth + 1, centroids);
+    unsigned const rightIndex = static_cast<unsigned>(m_nodes.size());
+    m_nodes.push_back(Node{.bounds = {}, .offset = first + leftCount, .count = count - leftCount});
+    subdivide(rightIndex, depth + 1, centroids);
+
+    m_nodes[nodeIndex].offset = rightIndex;
+    m_nodes[nodeIndex].count = 0;
+}
+
+std::optional<game::RayHit> game::BVH::raycast(Ray const &ray, float maxDistance) const
+{
+    if(m_nodes.empty()) return {};
+    glm::vec3 const inverseDirection = 1.0f / ray.direction; // infinities for axis aligned rays are handled by the slab test
+    std::optional<RayHit> closest;
+    unsigned stack[64];
+    unsigned stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0) {
+        Node const &node = m_nodes[stack[--stackSize]];
+        if(intersectRay(node.bounds, ray.origin, inverseDirection, maxDistance) < 0) continue;
+        if(node.isLeaf()) {
+            for(unsigned i = node.offset; i < node.offset + node.count; ++i) {
+                float distance = intersectRay(m_primitiveBounds[m_order[i]], ray.origin, inverseDirection, maxDistance);
+                if(distance < 0) continue;
+                closest = RayHit{.primitive = m_order[i], .distance = distance};
+                maxDistance = distance; // only closer hits from now on
+            }
+            continue;
+        }
+        // visit the nearer child first, so the farther one is more likely to be rejected by the shrunk max distance
+        unsigned left = static_cast<unsigned>(&node - m_nodes.data()) + 1;
+        unsigned right = node.offset;
+        float leftDistance = intersectRay(m_nodes[left].bounds, ray.origin, inverseDirection, maxDistance);
+        float rightDistance = intersectRay(m_nodes[right].bounds, ray.origin, inverseDirection, maxDistance);
+        if(leftDistance >= 0 && rightDistance >= 0) {
+            bool leftFirst = leftDistance <= rightDistance;
+            stack[stackSize++] = leftFirst ? right : left;
+            stack[stackSize++] = leftFirst ? left : right;
+        } else if(leftDistance >= 0) {
+            stack[stackSize++] = left;
+        } else if(rightDistance >= 0) {
+            stack[stackSize++] = right;
+        }
+    }
+    return closest;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "AABB.hpp"
+#include "Frustum.hpp"
+#include <vector>
+#include <optional>
+#include <limits>
+
+namespace game
+{
+    struct Ray
+    {
+        glm::vec3 origin{0};
+        glm::vec3 direction{0, 0, -1};
+    };
+    struct RayHit
+    {
+        unsigned primitive = 0;
+        float distance = 0;
+    };
+
+    /**
+     * bounding volume hierarchy over boxes that do not move, built top-down with the binned surface area heuristic.
+     * nodes are flattened depth first: the left child always follows its parent, only the right child index is stored
+     */
+    class BVH
+    {
+    public:
+        struct Node // 32 bytes, two nodes per cache line
+        {
+            AABB<glm::vec3> bounds;
+            unsigned offset = 0; // leaf -- first index into the primitive order, inner node -- index of the right child
+            unsigned count = 0;  // primitive count, 0 for inner nodes
+            inline bool isLeaf() const { return count > 0; }
+        };
+        static constexpr unsigned BIN_COUNT = 12;
+        static constexpr unsigned MAX_LEAF_SIZE = 4;
+    private:
+        std::vector<Node> m_nodes;
+        std::vector<unsigned> m_order; // primitive ids sorted so that every leaf covers a contiguous range
+        std::vector<AABB<glm::vec3>> m_primitiveBounds;
+
+        void subdivide(unsigned nodeIndex, unsigned depth, std::vector<glm::vec3> const &centroids);
+    public:
+        BVH() = default;
+        BVH(std::vector<AABB<glm::vec3>> const &primitives);
+
+        void build(std::vector<AABB<glm::vec3>> const &primitives);
+        void clear();
+
+        // callback(unsigned primitive) for every primitive whose box is not fully outside the frustum
+        template <typename Callback> void queryFrustum(Frustum const &frustum, Callback &&callback) const;
+        // callback(unsigned primitive) for every primitive whose box overlaps the box
+        template <typename Callback> void queryOverlap(AABB<glm::vec3> const &box, Callback &&callback) const;
+        // closest primitive box hit by the ray
+        std::optional<RayHit> raycast(Ray const &ray, float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+        inline bool empty() const { return m_nodes.empty(); }
+        inline size_t getPrimitiveCount() const { return m_primitiveBounds.size(); }
+        inline std::vector<Node> const &getNodes() const { return m_nodes; }
+        inline AABB<glm::vec3> const &getPrimitiveBounds(unsigned primitive) const { return m_primitiveBounds.at(primitive); }
+    };
+
+    inline bool overlaps(AABB<glm::vec3> const &first, AABB<glm::vec3> const &second)
+    {
+        return glm::all(glm::lessThanEqual(first.min, second.max)) && glm::all(glm::lessThanEqual(second.min, first.max));
+    }
+} // namespace game
+
+// ========================
+// Implementation
+// ========================
+
+template <typename Callback>
+void game::BVH::queryFrustum(Frustum const &frustum, Callback &&callback) const
+{
+    if(m_nodes.empty()) return;
+    unsigned stack[64];
+    unsigned stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0) {
+        unsigned nodeIndex = stack[--stackSize];
+        Node const &node = m_nodes[nodeIndex];
+        Frustum::Containment containment = frustum.classify(node.bounds);
+        if(containment == Frustum::OUTSIDE) continue;
+        if(containment == Frustum::INSIDE) {
+            // the whole subtree is visible, its leaves cover one contiguous range of the primitive order
+            unsigned last = nodeIndex;
+            while(!m_nodes[last].isLeaf()) last = m_nodes[last].offset;
+            unsigned first = nodeIndex;
+            while(!m_nodes[first].isLeaf()) first = first + 1;
+            for(unsigned i = m_nodes[first].offset; i < m_nodes[last].offset + m_nodes[last].count; ++i) {
+                callback(m_order[i]);
+            }
+            continue;
+        }
+        if(node.isLeaf()) {
+            for(unsigned i = node.offset; i < node.offset + node.count; ++i) {
+                if(frustum.intersects(m_primitiveBounds[m_order[i]])) callback(m_order[i]);
+            }
+        } else {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = nodeIndex + 1;
+        }
+    }
+}
+template <typename Callback>
+void game::BVH::queryOverlap(AABB<glm::vec3> const &box, Callback &&callback) const
+{
+    if(m_nodes.empty()) return;
+    unsigned stack[64];
+    unsigned stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0) {
+        unsigned nodeIndex = stack[--stackSize];
+        Node const &node = m_nodes[nodeIndex];
+        if(!overlaps(node.bounds, box)) continue;
+        if(node.isLeaf()) {
+            for(unsigned i = node.offset; i < node.offset + node.count; ++i) {
+                if(overlaps(m_primitiveBounds[m_order[i]], box)) callback(m_order[i]);
+            }
+        } else {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = nodeIndex + 1;
+        }
+    }
+}
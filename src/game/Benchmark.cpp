@@ -0,0 +1,216 @@
+#include "Benchmark.hpp"
+#include "BVH.hpp"
+#include "OcclusionRasterizer.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+    using Clock = std::chrono::high_resolution_clock;
+    double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() * 1.0E-6;
+    }
+    // the box is within tolerance of being outside one of the planes
+    bool onFrustumPlane(game::Frustum const &frustum, AABB<glm::vec3> const &box, float tolerance)
+    {
+        for(unsigned i = 0; i < 6; ++i) {
+            glm::vec4 plane = frustum.getPlane(i);
+            float distance = glm::dot(glm::vec3{plane}, box.getCenter()) + plane.w + glm::dot(glm::abs(glm::vec3{plane}), box.getExtents());
+            if(std::abs(distance) <= tolerance) return true;
+        }
+        return false;
+    }
+} // namespace
+
+int game::benchmarkCulling(size_t instanceCount)
+{
+    constexpr unsigned VIEW_COUNT = 64;
+    constexpr unsigned RAY_COUNT = 1024;
+    std::mt19937 random{42};
+
+    // boxes scattered in a cube, the cube grows with the count so density stays about the same
+    float const worldSize = 10.0f * std::cbrt(static_cast<float>(instanceCount));
+    std::uniform_real_distribution<float> positionDistribution{-worldSize / 2, worldSize / 2};
+    std::uniform_real_distribution<float> sizeDistribution{0.5f, 4.0f};
+    std::vector<AABB<glm::vec3>> boxes(instanceCount);
+    for(AABB<glm::vec3> &box : boxes) {
+        glm::vec3 center{positionDistribution(random), positionDistribution(random), positionDistribution(random)};
+        glm::vec3 extents = glm::vec3{sizeDistribution(random), sizeDistribution(random), sizeDistribution(random)} * 0.5f;
+        box = AABB<glm::vec3>{center - extents, center + extents};
+    }
+
+    auto start = Clock::now();
+    BVH bvh{boxes};
+    double buildTime = millisecondsSince(start);
+
+    std::uniform_real_distribution<float> angleDistribution{0, glm::two_pi<float>()};
+    std::vector<Frustum> frustums;
+    std::vector<Ray> rays;
+    for(unsigned i = 0; i < VIEW_COUNT; ++i) {
+        glm::vec3 eye{positionDistribution(random), positionDistribution(random), positionDistribution(random)};
+        float yaw = angleDistribution(random);
+        float pitch = (angleDistribution(random) / glm::two_pi<float>() - 0.5f) * 2.0f;
+        glm::vec3 forward{std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch)};
+        frustums.emplace_back(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, worldSize / 2) * glm::lookAt(eye, eye + forward, glm::vec3{0, 1, 0}));
+    }
+    for(unsigned i = 0; i < RAY_COUNT; ++i) {
+        float yaw = angleDistribution(random);
+        float pitch = (angleDistribution(random) / glm::two_pi<float>() - 0.5f) * 3.0f;
+        rays.push_back(Ray{
+            .origin = glm::vec3{positionDistribution(random), positionDistribution(random), positionDistribution(random)},
+            .direction = glm::vec3{std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch)}
+        });
+    }
+
+    size_t linearVisible = 0;
+    start = Clock::now();
+    for(Frustum const &frustum : frustums) {
+        for(AABB<glm::vec3> const &box : boxes) {
+            linearVisible += frustum.intersects(box);
+        }
+    }
+    double linearCullTime = millisecondsSince(start) / VIEW_COUNT;
+
+    size_t bvhVisible = 0;
+    start = Clock::now();
+    for(Frustum const &frustum : frustums) {
+        bvh.queryFrustum(frustum, [&bvhVisible](unsigned) { ++bvhVisible; });
+    }
+    double bvhCullTime = millisecondsSince(start) / VIEW_COUNT;
+
+    // the linear raycast mirrors BVH::raycast: closest box entry distance along the ray
+    size_t linearHits = 0;
+    start = Clock::now();
+    for(Ray const &ray : rays) {
+        glm::vec3 inverseDirection = 1.0f / ray.direction;
+        float closest = std::numeric_limits<float>::infinity();
+        for(AABB<glm::vec3> const &box : boxes) {
+            glm::vec3 t0 = (box.min - ray.origin) * inverseDirection;
+            glm::vec3 t1 = (box.max - ray.origin) * inverseDirection;
+            glm::vec3 tmin = glm::min(t0, t1);
+            glm::vec3 tmax = glm::max(t0, t1);
+            float enter = std::max({tmin.x, tmin.y, tmin.z, 0.0f});
+            float exit = std::min({tmax.x, tmax.y, tmax.z, closest});
+            if(enter <= exit) closest = enter;
+        }
+        linearHits += closest != std::numeric_limits<float>::infinity();
+    }
+    double linearRayTime = millisecondsSince(start) / RAY_COUNT;
+
+    size_t bvhHits = 0;
+    start = Clock::now();
+    for(Ray const &ray : rays) {
+        bvhHits += bvh.raycast(ray).has_value();
+    }
+    double bvhRayTime = millisecondsSince(start) / RAY_COUNT;
+
+    std::cout << instanceCount << " boxes, " << bvh.getNodes().size() << " bvh nodes built in " << buildTime << " ms\n";
+    std::cout << "frustum culling, average of " << VIEW_COUNT << " views:\n";
+    std::cout << "\tlinear: " << linearCullTime << " ms, " << linearVisible / VIEW_COUNT << " visible\n";
+    std::cout << "\tbvh:    " << bvhCullTime << " ms, " << bvhVisible / VIEW_COUNT << " visible\n";
+    std::cout << "closest hit raycast, average of " << RAY_COUNT << " rays:\n";
+    std::cout << "\tlinear: " << linearRayTime << " ms, " << linearHits << " hits\n";
+    std::cout << "\tbvh:    " << bvhRayTime << " ms, " << bvhHits << " hits\n";
+
+    // a leaf box can touch a plane its node was rejected or accepted by, within rounding. only the others are real mismatches
+    size_t cullMismatches = 0;
+    std::vector<bool> bvhFlags(boxes.size());
+    for(Frustum const &frustum : frustums) {
+        std::fill(bvhFlags.begin(), bvhFlags.end(), false);
+        bvh.queryFrustum(frustum, [&bvhFlags](unsigned primitive) { bvhFlags[primitive] = true; });
+        for(size_t i = 0; i < boxes.size(); ++i) {
+            if(bvhFlags[i] != frustum.intersects(boxes[i]) && !onFrustumPlane(frustum, boxes[i], worldSize * 1.0E-5f)) ++cullMismatches;
+        }
+    }
+
+    if(cullMismatches > 0 || linearHits != bvhHits) {
+        std::cout << "ERROR: bvh results differ from the linear results!\n";
+        return -1;
+    }
+    return 0;
+}
+
+int game::benchmarkOcclusion(size_t instanceCount)
+{
+    constexpr unsigned FRAME_COUNT = 64;
+    std::mt19937 random{42};
+
+    // a maze of walls around the camera and boxes scattered between them
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned> indices;
+    std::uniform_real_distribution<float> wallDistribution{-100, 100};
+    for(unsigned i = 0; i < 200; ++i) {
+        glm::vec3 center{wallDistribution(random), 0, wallDistribution(random)};
+        glm::vec3 along = i % 2 ? glm::vec3{8, 0, 0} : glm::vec3{0, 0, 8};
+        unsigned base = static_cast<unsigned>(vertices.size());
+        vertices.insert(vertices.end(), {center - along, center + along, center + along + glm::vec3{0, 10, 0}, center - along + glm::vec3{0, 10, 0}});
+        indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+    }
+    std::uniform_real_distribution<float> heightDistribution{0.5f, 8};
+    std::vector<AABB<glm::vec3>> boxes(instanceCount);
+    for(AABB<glm::vec3> &box : boxes) {
+        glm::vec3 center{wallDistribution(random), heightDistribution(random), wallDistribution(random)};
+        box = AABB<glm::vec3>{center - 0.5f, center + 0.5f};
+    }
+    std::vector<glm::mat4> views;
+    std::uniform_real_distribution<float> angleDistribution{0, glm::two_pi<float>()};
+    for(unsigned i = 0; i < FRAME_COUNT; ++i) {
+        glm::vec3 eye{wallDistribution(random) * 0.5f, 2, wallDistribution(random) * 0.5f};
+        float yaw = angleDistribution(random);
+        views.push_back(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f) * glm::lookAt(eye, eye + glm::vec3{std::cos(yaw), 0, std::sin(yaw)}, glm::vec3{0, 1, 0}));
+    }
+
+    OcclusionRasterizer rasterizer;
+    rasterizer.setOccluders(vertices, indices);
+    std::cout << rasterizer.getTriangleCount() << " occluder triangles, " << instanceCount << " boxes, " 
+        << rasterizer.getWidth() << "x" << rasterizer.getHeight() << " depth buffer\n";
+
+    char const *isaNames[] = {"scalar", "sse", "avx2"};
+    std::vector<std::vector<float>> firstDepth; // of the scalar run, per view
+    size_t firstOccluded = 0;
+    int result = 0;
+    for(OcclusionRasterizer::Isa isa : {OcclusionRasterizer::Isa::SCALAR, OcclusionRasterizer::Isa::SSE, OcclusionRasterizer::Isa::AVX2}) {
+        rasterizer.setIsa(isa);
+        if(rasterizer.getIsa() != isa) {
+            std::cout << "\t" << isaNames[static_cast<int>(isa)] << ": not supported\n";
+            continue;
+        }
+        double rasterTime = 0;
+        double testTime = 0;
+        size_t occluded = 0;
+        size_t mismatchedPixels = 0;
+        for(unsigned i = 0; i < FRAME_COUNT; ++i) {
+            auto start = Clock::now();
+            rasterizer.begin(views[i]);
+            DepthPyramid const &pyramid = rasterizer.finish();
+            rasterTime += millisecondsSince(start);
+
+            start = Clock::now();
+            for(AABB<glm::vec3> const &box : boxes) {
+                occluded += pyramid.isOccluded(box);
+            }
+            testTime += millisecondsSince(start);
+
+            if(isa == OcclusionRasterizer::Isa::SCALAR) {
+                firstDepth.push_back(rasterizer.getDepth());
+            } else {
+                for(size_t pixel = 0; pixel < firstDepth[i].size(); ++pixel) {
+                    mismatchedPixels += firstDepth[i][pixel] != rasterizer.getDepth()[pixel];
+                }
+            }
+        }
+        if(isa == OcclusionRasterizer::Isa::SCALAR) firstOccluded = occluded;
+        std::cout << "\t" << isaNames[static_cast<int>(isa)] << ": rasterization " << rasterTime / FRAME_COUNT << " ms, box tests " << testTime / FRAME_COUNT 
+            << " ms, " << occluded / FRAME_COUNT << " boxes occluded on average\n";
+        if(mismatchedPixels > 0 || occluded != firstOccluded) {
+            std::cout << "ERROR: " << mismatchedPixels << " pixels differ from the scalar result!\n";
+            result = -1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+namespace game
+{
+    // headless comparison of linear and bvh queries over generated boxes, returns the process exit code
+    int benchmarkCulling(size_t instanceCount);
+    // headless software occlusion rasterizer run over generated walls and boxes, compares the instruction sets, returns the process exit code
+    int benchmarkOcclusion(size_t instanceCount);
+
+    // how the scene benchmark sets RenderTarget::depthPrepass. BOTH measures the path twice, without the prepass and then with it
+    enum class PrepassOverride
+    {
+        SCENE, OFF, ON, BOTH
+    };
+} // namespace game
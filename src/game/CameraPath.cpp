@@ -0,0 +1,125 @@
+#include "CameraPath.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace
+{
+    glm::vec3 catmullRom(glm::vec3 const &p0, glm::vec3 const &p1, glm::vec3 const &p2, glm::vec3 const &p3, float t)
+    {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+    bool isVec3(json const &array)
+    {
+        return array.is_array() && array.size() == 3 && std::all_of(array.begin(), array.end(), [](json const &value){ return value.is_number(); });
+    }
+    glm::vec3 getVec3(json const &array)
+    {
+        return glm::vec3{array.at(0).get<float>(), array.at(1).get<float>(), array.at(2).get<float>()};
+    }
+} // namespace
+
+bool game::CameraPath::load(std::filesystem::path const &path)
+{
+    std::ifstream file{path};
+    if(!file) {
+        std::cout << "failed to open the camera path " << path << "\n";
+        return false;
+    }
+    json root = json::parse(file, nullptr, false);
+    if(root.is_discarded() || !root.contains("keys") || !root["keys"].is_array()) {
+        std::cout << "the camera path " << path << " has no keys\n";
+        return false;
+    }
+    glm::ivec2 fileResolution = resolution;
+    if(root.contains("resolution")) {
+        json const &size = root["resolution"];
+        if(!size.is_array() || size.size() != 2 || !size[0].is_number() || !size[1].is_number()) {
+            std::cout << "the resolution of the camera path " << path << " is not two numbers\n";
+            return false;
+        }
+        fileResolution = glm::ivec2{size[0].get<int>(), size[1].get<int>()};
+        if(fileResolution.x <= 0 || fileResolution.y <= 0) {
+            std::cout << "the resolution of the camera path " << path << " is not positive\n";
+            return false;
+        }
+    }
+    std::vector<Key> keys;
+    for(json const &key : root["keys"]) {
+        if(!key.is_object()
+            || (key.contains("time") && !key["time"].is_number())
+            || (key.contains("position") && !isVec3(key["position"]))
+            || (key.contains("rotation") && !isVec3(key["rotation"]))) {
+            std::cout << "key " << keys.size() << " of the camera path " << path << " is malformed, time is a number, position and rotation are 3 numbers\n";
+            return false;
+        }
+        keys.push_back(Key{
+            .time = key.value("time", 0.0f),
+            .position = key.contains("position") ? getVec3(key["position"]) : glm::vec3{0},
+            .rotation = key.contains("rotation") ? getVec3(key["rotation"]) : glm::vec3{0}
+        });
+    }
+
+    resolution = fileResolution;
+    if(root.contains("frames") && root["frames"].is_number_unsigned()) frames = root["frames"].get<unsigned>();
+    if(root.contains("warmup") && root["warmup"].is_number_unsigned()) warmupFrames = root["warmup"].get<unsigned>();
+
+    m_keys = std::move(keys);
+    std::stable_sort(m_keys.begin(), m_keys.end(), [](Key const &a, Key const &b){ return a.time < b.time; });
+    return !m_keys.empty();
+}
+
+bool game::CameraPath::save(std::filesystem::path const &path) const
+{
+    json keys = json::array();
+    for(Key const &key : m_keys) {
+        keys.push_back({
+            {"time", key.time},
+            {"position", {key.position.x, key.position.y, key.position.z}},
+            {"rotation", {key.rotation.x, key.rotation.y, key.rotation.z}}
+        });
+    }
+    json root = {
+        {"resolution", {resolution.x, resolution.y}},
+        {"frames", frames},
+        {"warmup", warmupFrames},
+        {"keys", keys}
+    };
+    std::ofstream file{path};
+    if(!file) {
+        std::cout << "failed to write the camera path " << path << "\n";
+        return false;
+    }
+    file << root.dump(4) << '\n';
+    return true;
+}
+
+void game::CameraPath::addKey(Key const &key)
+{
+    m_keys.push_back(key);
+}
+
+game::CameraPath::Key game::CameraPath::sample(float time) const
+{
+    if(m_keys.empty()) return Key{time, glm::vec3{0}, glm::vec3{0}};
+    if(time <= m_keys.front().time) return m_keys.front();
+    if(time >= m_keys.back().time) return m_keys.back();
+
+    // the segment between keys 1 and 2, the end keys are repeated as the outer control points
+    size_t next = std::upper_bound(m_keys.begin(), m_keys.end(), time, [](float time, Key const &key){ return time < key.time; }) - m_keys.begin();
+    Key const &k1 = m_keys[next - 1];
+    Key const &k2 = m_keys[next];
+    Key const &k0 = m_keys[next >= 2 ? next - 2 : next - 1];
+    Key const &k3 = m_keys[std::min(next + 1, m_keys.size() - 1)];
+    float t = k2.time > k1.time ? (time - k1.time) / (k2.time - k1.time) : 0;
+    return Key{
+        .time = time,
+        .position = catmullRom(k0.position, k1.position, k2.position, k3.position, t),
+        .rotation = catmullRom(k0.rotation, k1.rotation, k2.rotation, k3.rotation, t)
+    };
+}
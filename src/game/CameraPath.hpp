@@ -0,0 +1,48 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <vector>
+#include <filesystem>
+
+namespace game
+{
+    /**
+     * camera flight through keys, interpolated with a catmull-rom spline so the motion is smooth through every key.
+     * stored as json:
+     * {"resolution": [1280, 720], "frames": 600, "warmup": 30, "keys": [{"time": 0, "position": [x, y, z], "rotation": [pitch, yaw, roll]}, ...]}
+     * rotation is the euler rotation in degrees of OrientationEuler. the keys are sorted by time, which is in seconds
+     */
+    class CameraPath
+    {
+    public:
+        static constexpr unsigned DEFAULT_FRAMES = 600;
+        static constexpr unsigned DEFAULT_WARMUP_FRAMES = 30;
+        static constexpr glm::ivec2 DEFAULT_RESOLUTION{1280, 720}; // of the hidden window
+
+        struct Key
+        {
+            float time;
+            glm::vec3 position;
+            glm::vec3 rotation;
+        };
+    private:
+        std::vector<Key> m_keys;
+    public:
+        glm::ivec2 resolution = DEFAULT_RESOLUTION;
+        unsigned frames = DEFAULT_FRAMES;
+        unsigned warmupFrames = DEFAULT_WARMUP_FRAMES; // rendered from the first key, not measured
+
+        CameraPath() = default;
+
+        // false if the file is missing or has no keys
+        bool load(std::filesystem::path const &path);
+        bool save(std::filesystem::path const &path) const;
+
+        // keys have to be added in time order
+        void addKey(Key const &key);
+        // time is clamped to the keys
+        Key sample(float time) const;
+
+        inline std::vector<Key> const &getKeys() const { return m_keys; }
+        inline float getDuration() const { return m_keys.empty() ? 0 : m_keys.back().time - m_keys.front().time; }
+    };
+} // namespace game
@@ -148,27 +148,15 @@ void game::CameraController::update(std::set<ecs::Entity_t> const &entities, dou
     for (; !m_keyQueue.empty(); m_keyQueue.pop()) {
         KeyEvent const &event = m_keyQueue.front();
         for(ecs::Entity_t const &entity : entities) {
-            if(event.key == GLFW_KEY_R && glfwGetKey(event.window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS && event.action == GLFW_PRESS && ecs::entityHasComponent<opengl::ShaderProgram>(entity)) { // hot reload shaders
-                opengl::ShaderProgram &shader = ecs::get<opengl::ShaderProgram>(entity);
-                
-                opengl::ShaderProgram copy = shader;
-                if(!shader.collectShaders(shader.getPath())) {
-                    std::cout << "failed to collect shaders from directory \"" << shader.getPath() << "\":\n" << shader.getLog();
-                    std::swap(shader, copy);
-                    continue;
-                };
-                if(!shader.compileShaders()) {
-                    std::cout << "failed to compile shaders in directory \"" << shader.getPath() << "\":\n" << shader.getLog();
-                    std::swap(shader, copy);
-                    continue;
-                }
-            }
             if(event.key == GLFW_KEY_ESCAPE && event.action == GLFW_PRESS && ecs::entityHasComponent<ControllableCamera>(entity)) {
                 bool &locked = ecs::get<ControllableCamera>(entity).locked;
                 locked = !locked;
             }
         }
     }
+    for(ecs::Entity_t const &entity : entities) { // reloaded by the file watcher of the main loop
+        if(ecs::entityHasComponent<opengl::ShaderProgram>(entity)) ecs::get<opengl::ShaderProgram>(entity).poll();
+    }
 
     for (; !m_mouseQueue.empty(); m_mouseQueue.pop()) {
         MouseEvent const &event = m_mouseQueue.front();
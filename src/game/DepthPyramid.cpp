@@ -0,0 +1,90 @@
+#include "DepthPyramid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void game::DepthPyramid::clear()
+{
+    m_levels.clear();
+}
+
+void game::DepthPyramid::assign(float const *depth, int width, int height, glm::mat4 const &viewProjection)
+{
+    m_viewProjection = viewProjection;
+    if(width <= 0 || height <= 0) {
+        m_levels.clear();
+        return;
+    }
+    unsigned levelCount = 1 + static_cast<unsigned>(std::floor(std::log2(std::max(width, height))));
+    m_levels.resize(levelCount);
+    m_levels[0].width = width;
+    m_levels[0].height = height;
+    m_levels[0].depth.assign(depth, depth + static_cast<size_t>(width) * height);
+
+    for(unsigned i = 1; i < levelCount; ++i) {
+        Level const &source = m_levels[i - 1];
+        Level &level = m_levels[i];
+        level.width = std::max(1, source.width / 2);
+        level.height = std::max(1, source.height / 2);
+        level.depth.resize(static_cast<size_t>(level.width) * level.height);
+        for(int y = 0; y < level.height; ++y) {
+            int sourceY1 = y == level.height - 1 ? source.height : std::min(source.height, y * 2 + 2);
+            for(int x = 0; x < level.width; ++x) {
+                int sourceX1 = x == level.width - 1 ? source.width : std::min(source.width, x * 2 + 2);
+                float result = 0;
+                for(int sourceY = y * 2; sourceY < sourceY1; ++sourceY) {
+                    for(int sourceX = x * 2; sourceX < sourceX1; ++sourceX) {
+                        result = std::max(result, source.depth[static_cast<size_t>(sourceY) * source.width + sourceX]);
+                    }
+                }
+                level.depth[static_cast<size_t>(y) * level.width + x] = result;
+            }
+        }
+    }
+}
+
+bool game::DepthPyramid::isOccluded(AABB<glm::vec3> const &box) const
+{
+    if(m_levels.empty()) return false;
+
+    // screen rectangle and nearest depth of the box
+    glm::vec2 minNDC{std::numeric_limits<float>::max()};
+    glm::vec2 maxNDC{std::numeric_limits<float>::lowest()};
+    float minDepth = std::numeric_limits<float>::max();
+    for(unsigned corner = 0; corner < 8; ++corner) {
+        glm::vec3 point{corner & 1 ? box.max.x : box.min.x, corner & 2 ? box.max.y : box.min.y, corner & 4 ? box.max.z : box.min.z};
+        glm::vec4 clip = m_viewProjection * glm::vec4{point, 1};
+        if(clip.w <= 1e-5f) return false; // crosses the camera plane, the projection is unbounded
+        glm::vec3 ndc = glm::vec3{clip} / clip.w;
+        minNDC = glm::min(minNDC, glm::vec2{ndc});
+        maxNDC = glm::max(maxNDC, glm::vec2{ndc});
+        minDepth = std::min(minDepth, ndc.z * 0.5f + 0.5f);
+    }
+    if(maxNDC.x < -1 || maxNDC.y < -1 || minNDC.x > 1 || minNDC.y > 1) return false; // off screen, the frustum test decides
+    if(minDepth <= 0) return false;
+
+    Level const &finest = m_levels.front();
+    glm::vec2 size{finest.width, finest.height};
+    glm::ivec2 minTexel = glm::ivec2{glm::clamp((minNDC * 0.5f + 0.5f) * size, glm::vec2{0}, size - 1.0f)};
+    glm::ivec2 maxTexel = glm::ivec2{glm::clamp((maxNDC * 0.5f + 0.5f) * size, glm::vec2{0}, size - 1.0f)};
+
+    // the coarsest level where the rectangle spans at most 2x2 texels
+    int extent = std::max(maxTexel.x - minTexel.x, maxTexel.y - minTexel.y);
+    unsigned levelIndex = 0;
+    while(extent > 1 && levelIndex + 1 < m_levels.size()) {
+        extent >>= 1;
+        ++levelIndex;
+    }
+    Level const &level = m_levels[levelIndex];
+    glm::ivec2 const last{level.width - 1, level.height - 1};
+    glm::ivec2 const first = glm::min(minTexel >> static_cast<int>(levelIndex), last);
+    glm::ivec2 const end = glm::min(maxTexel >> static_cast<int>(levelIndex), last);
+
+    float maxDepth = 0;
+    for(int y = first.y; y <= end.y; ++y) {
+        for(int x = first.x; x <= end.x; ++x) {
+            maxDepth = std::max(maxDepth, level.depth[static_cast<size_t>(y) * level.width + x]);
+        }
+    }
+    return minDepth > maxDepth;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "AABB.hpp"
+#include <vector>
+
+namespace game
+{
+    /**
+     * cpu side max-depth mip chain of a depth buffer plus the view projection it was rendered with.
+     * world space boxes are tested against it conservatively: a box is occluded only if its nearest point
+     * is farther than everything drawn in the screen rectangle it covers
+     */
+    class DepthPyramid
+    {
+    public:
+        struct Level
+        {
+            int width = 0;
+            int height = 0;
+            std::vector<float> depth; // window space depth, [0, 1], rows bottom to top
+        };
+    private:
+        std::vector<Level> m_levels;
+        glm::mat4 m_viewProjection{1.0f};
+    public:
+        DepthPyramid() = default;
+
+        // takes the finest level and builds the coarser ones. the texel at the odd edge of a level also covers the extra finer texels
+        void assign(float const *depth, int width, int height, glm::mat4 const &viewProjection);
+        void clear();
+        bool isOccluded(AABB<glm::vec3> const &box) const;
+
+        inline bool empty() const { return m_levels.empty(); }
+        inline std::vector<Level> const &getLevels() const { return m_levels; }
+        inline glm::mat4 const &getViewProjection() const { return m_viewProjection; }
+    };
+} // namespace game
@@ -0,0 +1,251 @@
+#include "DynamicAABBTree.hpp"
+#include <algorithm>
+
+namespace
+{
+    AABB<glm::vec3> merge(AABB<glm::vec3> const &first, AABB<glm::vec3> const &second)
+    {
+        return AABB<glm::vec3>{glm::min(first.min, second.min), glm::max(first.max, second.max)};
+    }
+    bool contains(AABB<glm::vec3> const &outer, AABB<glm::vec3> const &inner)
+    {
+        return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+    }
+    float surfaceArea(AABB<glm::vec3> const &box)
+    {
+        glm::vec3 size = box.max - box.min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+    float intersectRay(AABB<glm::vec3> const &box, glm::vec3 const &origin, glm::vec3 const &inverseDirection, float maxDistance)
+    {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 tmin = glm::min(t0, t1);
+        glm::vec3 tmax = glm::max(t0, t1);
+        float enter = std::max({tmin.x, tmin.y, tmin.z, 0.0f});
+        float exit = std::min({tmax.x, tmax.y, tmax.z, maxDistance});
+        return enter <= exit ? enter : -1.0f;
+    }
+    AABB<glm::vec3> fatten(AABB<glm::vec3> const &bounds, glm::vec3 const &displacement)
+    {
+        using game::DynamicAABBTree;
+        AABB<glm::vec3> fat{bounds.min - DynamicAABBTree::FAT_MARGIN, bounds.max + DynamicAABBTree::FAT_MARGIN};
+        // stretch the box along the predicted movement
+        glm::vec3 predicted = displacement * DynamicAABBTree::DISPLACEMENT_MULTIPLIER;
+        fat.min += glm::min(predicted, glm::vec3{0});
+        fat.max += glm::max(predicted, glm::vec3{0});
+        return fat;
+    }
+} // namespace
+
+unsigned game::DynamicAABBTree::allocateNode()
+{
+    if(m_freeList == NULL_NODE) {
+        m_nodes.emplace_back();
+        m_nodes.back().height = 0;
+        return static_cast<unsigned>(m_nodes.size() - 1);
+    }
+    unsigned node = m_freeList;
+    m_freeList = m_nodes[node].parent;
+    m_nodes[node] = Node{};
+    m_nodes[node].height = 0;
+    return node;
+}
+void game::DynamicAABBTree::freeNode(unsigned node)
+{
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_freeList = node;
+}
+
+unsigned game::DynamicAABBTree::insert(AABB<glm::vec3> const &bounds, unsigned userData)
+{
+    unsigned proxy = allocateNode();
+    m_nodes[proxy].bounds = fatten(bounds, glm::vec3{0});
+    m_nodes[proxy].userData = userData;
+    insertLeaf(proxy);
+    ++m_proxyCount;
+    return proxy;
+}
+void game::DynamicAABBTree::remove(unsigned proxy)
+{
+    assert(proxy < m_nodes.size() && m_nodes[proxy].isLeaf() && m_nodes[proxy].height == 0);
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --m_proxyCount;
+}
+bool game::DynamicAABBTree::move(unsigned proxy, AABB<glm::vec3> const &bounds, glm::vec3 const &displacement)
+{
+    assert(proxy < m_nodes.size() && m_nodes[proxy].isLeaf() && m_nodes[proxy].height == 0);
+    AABB<glm::vec3> const &fat = m_nodes[proxy].bounds;
+    if(contains(fat, bounds)) {
+        // still inside, unless the fat bounds have become much larger than needed (the proxy slowed down)
+        AABB<glm::vec3> huge = fatten(bounds, displacement * 4.0f);
+        huge.min -= 4.0f * FAT_MARGIN;
+        huge.max += 4.0f * FAT_MARGIN;
+        if(contains(huge, fat)) return false;
+    }
+    removeLeaf(proxy);
+    m_nodes[proxy].bounds = fatten(bounds, displacement);
+    insertLeaf(proxy);
+    return true;
+}
+
+void game::DynamicAABBTree::insertLeaf(unsigned leaf)
+{
+    if(m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // descend to the sibling that increases the total surface area the least
+    AABB<glm::vec3> const leafBounds = m_nodes[leaf].bounds;
+    unsigned index = m_root;
+    while(!m_nodes[index].isLeaf()) {
+        Node const &node = m_nodes[index];
+        float area = surfaceArea(node.bounds);
+        float combinedArea = surfaceArea(merge(node.bounds, leafBounds));
+        float cost = 2.0f * combinedArea; // cost of a new parent for this node and the leaf
+        float inheritanceCost = 2.0f * (combinedArea - area); // minimum cost of pushing the leaf further down
+
+        auto descendCost = [&](unsigned child) {
+            float childArea = surfaceArea(merge(leafBounds, m_nodes[child].bounds));
+            return m_nodes[child].isLeaf() ? childArea + inheritanceCost : childArea - surfaceArea(m_nodes[child].bounds) + inheritanceCost;
+        };
+        float leftCost = descendCost(node.left);
+        float rightCost = descendCost(node.right);
+        if(cost < leftCost && cost < rightCost) break;
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+    unsigned sibling = index;
+
+    unsigned oldParent = m_nodes[sibling].parent;
+    unsigned newParent = allocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].bounds = merge(leafBounds, m_nodes[sibling].bounds);
+    m_nodes[newParent].height = m_nodes[sibling].height + 1;
+    m_nodes[newParent].left = sibling;
+    m_nodes[newParent].right = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+    if(oldParent != NULL_NODE) {
+        if(m_nodes[oldParent].left == sibling) m_nodes[oldParent].left = newParent;
+        else m_nodes[oldParent].right = newParent;
+    } else {
+        m_root = newParent;
+    }
+
+    refitUpwards(m_nodes[leaf].parent);
+}
+void game::DynamicAABBTree::removeLeaf(unsigned leaf)
+{
+    if(leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+    unsigned parent = m_nodes[leaf].parent;
+    unsigned grandParent = m_nodes[parent].parent;
+    unsigned sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+    if(grandParent != NULL_NODE) {
+        // the sibling takes the place of the parent
+        if(m_nodes[grandParent].left == parent) m_nodes[grandParent].left = sibling;
+        else m_nodes[grandParent].right = sibling;
+        m_nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitUpwards(grandParent);
+    } else {
+        m_root = sibling;
+        m_nodes[sibling].parent = NULL_NODE;
+        freeNode(parent);
+    }
+}
+void game::DynamicAABBTree::refitUpwards(unsigned index)
+{
+    while(index != NULL_NODE) {
+        index = balance(index);
+        Node &node = m_nodes[index];
+        node.height = 1 + std::max(m_nodes[node.left].height, m_nodes[node.right].height);
+        node.bounds = merge(m_nodes[node.left].bounds, m_nodes[node.right].bounds);
+        index = node.parent;
+    }
+}
+
+// rotates the taller child up if the subtree at a is imbalanced, returns the new subtree root
+unsigned game::DynamicAABBTree::balance(unsigned a)
+{
+    if(m_nodes[a].isLeaf() || m_nodes[a].height < 2) return a;
+    unsigned b = m_nodes[a].left;
+    unsigned c = m_nodes[a].right;
+    int heightDifference = m_nodes[c].height - m_nodes[b].height;
+
+    // the taller child replaces a, a adopts its shorter grandchild
+    auto rotateUp = [&](unsigned up, unsigned other, bool upIsRight) -> unsigned {
+        unsigned f = m_nodes[up].left;
+        unsigned g = m_nodes[up].right;
+        m_nodes[up].left = a;
+        m_nodes[up].parent = m_nodes[a].parent;
+        m_nodes[a].parent = up;
+        if(m_nodes[up].parent != NULL_NODE) {
+            unsigned parent = m_nodes[up].parent;
+            if(m_nodes[parent].left == a) m_nodes[parent].left = up;
+            else m_nodes[parent].right = up;
+        } else {
+            m_root = up;
+        }
+        unsigned keep = m_nodes[f].height > m_nodes[g].height ? f : g; // stays under the rotated node
+        unsigned give = keep == f ? g : f; // moves under a, in place of up
+        m_nodes[up].right = keep;
+        if(upIsRight) m_nodes[a].right = give;
+        else m_nodes[a].left = give;
+        m_nodes[give].parent = a;
+
+        m_nodes[a].bounds = merge(m_nodes[other].bounds, m_nodes[give].bounds);
+        m_nodes[a].height = 1 + std::max(m_nodes[other].height, m_nodes[give].height);
+        m_nodes[up].bounds = merge(m_nodes[a].bounds, m_nodes[keep].bounds);
+        m_nodes[up].height = 1 + std::max(m_nodes[a].height, m_nodes[keep].height);
+        return up;
+    };
+    if(heightDifference > 1) return rotateUp(c, b, true);
+    if(heightDifference < -1) return rotateUp(b, c, false);
+    return a;
+}
+
+void game::DynamicAABBTree::rebalance(unsigned nodeCount)
+{
+    if(m_nodes.empty()) return;
+    for(unsigned i = 0; i < nodeCount && i < m_nodes.size(); ++i) {
+        m_rebalanceCursor = (m_rebalanceCursor + 1) % m_nodes.size();
+        Node const &node = m_nodes[m_rebalanceCursor];
+        if(node.height < 2) continue; // free nodes, leaves and parents of two leaves are always balanced
+        if(std::abs(m_nodes[node.left].height - m_nodes[node.right].height) <= 1) continue;
+        unsigned subtreeRoot = balance(m_rebalanceCursor);
+        refitUpwards(m_nodes[subtreeRoot].parent);
+    }
+}
+
+std::optional<game::RayHit> game::DynamicAABBTree::raycast(Ray const &ray, float maxDistance) const
+{
+    if(m_root == NULL_NODE) return {};
+    glm::vec3 const inverseDirection = 1.0f / ray.direction;
+    std::optional<RayHit> closest;
+    unsigned stack[128];
+    unsigned stackSize = 0;
+    stack[stackSize++] = m_root;
+    while(stackSize > 0) {
+        unsigned nodeIndex = stack[--stackSize];
+        Node const &node = m_nodes[nodeIndex];
+        float distance = intersectRay(node.bounds, ray.origin, inverseDirection, maxDistance);
+        if(distance < 0) continue;
+        if(node.isLeaf()) {
+            closest = RayHit{.primitive = nodeIndex, .distance = distance};
+            maxDistance = distance;
+        } else {
+            assert(stackSize + 2 <= 128);
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = node.left;
+        }
+    }
+    return closest;
+}
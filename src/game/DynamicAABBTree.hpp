@@ -0,0 +1,127 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "AABB.hpp"
+#include "Frustum.hpp"
+#include "BVH.hpp"
+#include <vector>
+#include <optional>
+#include <limits>
+#include <cassert>
+
+namespace game
+{
+    /**
+     * bounding volume tree over moving boxes (after Box2D's b2DynamicTree).
+     * leaves store fattened bounds, so a proxy is only reinserted once its tight bounds leave them.
+     * the tree is kept balanced with AVL style rotations on every insertion / removal and by rebalance()
+     */
+    class DynamicAABBTree
+    {
+    public:
+        static constexpr unsigned NULL_NODE = std::numeric_limits<unsigned>::max();
+        static constexpr float FAT_MARGIN = 0.1f; // world units added on every side of the tight bounds
+        static constexpr float DISPLACEMENT_MULTIPLIER = 4.0f; // how many frames of displacement the fat bounds predict
+        struct Node
+        {
+            AABB<glm::vec3> bounds; // fattened for leaves
+            unsigned parent = NULL_NODE; // next free node while in the free list
+            unsigned left = NULL_NODE;
+            unsigned right = NULL_NODE;
+            int height = -1; // 0 for leaves, -1 for free nodes
+            unsigned userData = 0;
+            inline bool isLeaf() const { return left == NULL_NODE; }
+        };
+    private:
+        std::vector<Node> m_nodes;
+        unsigned m_root = NULL_NODE;
+        unsigned m_freeList = NULL_NODE;
+        unsigned m_proxyCount = 0;
+        unsigned m_rebalanceCursor = 0;
+
+        unsigned allocateNode();
+        void freeNode(unsigned node);
+        void insertLeaf(unsigned leaf);
+        void removeLeaf(unsigned leaf);
+        unsigned balance(unsigned node);
+        void refitUpwards(unsigned node); // balances and refits every ancestor up to the root
+    public:
+        DynamicAABBTree() = default;
+
+        // returns the proxy id
+        unsigned insert(AABB<glm::vec3> const &bounds, unsigned userData);
+        void remove(unsigned proxy);
+        // displacement is the expected movement until the next call, returns true if the proxy was reinserted
+        bool move(unsigned proxy, AABB<glm::vec3> const &bounds, glm::vec3 const &displacement = glm::vec3{0});
+        // applies rotations to at most nodeCount internal nodes, continuing where the previous call stopped
+        void rebalance(unsigned nodeCount);
+
+        // callback(unsigned proxy) for every proxy whose fat bounds are not fully outside the frustum
+        template <typename Callback> void queryFrustum(Frustum const &frustum, Callback &&callback) const;
+        // callback(unsigned proxy) for every proxy whose fat bounds overlap the box
+        template <typename Callback> void queryOverlap(AABB<glm::vec3> const &box, Callback &&callback) const;
+        // callback(unsigned proxyA, unsigned proxyB) once for every pair of proxies with overlapping fat bounds
+        template <typename Callback> void queryPairs(Callback &&callback) const;
+        // closest fat bounds hit by the ray, RayHit::primitive is the proxy
+        std::optional<RayHit> raycast(Ray const &ray, float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+        inline unsigned getUserData(unsigned proxy) const { assert(m_nodes.at(proxy).isLeaf()); return m_nodes[proxy].userData; }
+        inline AABB<glm::vec3> const &getFatBounds(unsigned proxy) const { assert(m_nodes.at(proxy).isLeaf()); return m_nodes[proxy].bounds; }
+        inline unsigned getProxyCount() const { return m_proxyCount; }
+        inline int getHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+    };
+} // namespace game
+
+// ========================
+// Implementation
+// ========================
+
+template <typename Callback>
+void game::DynamicAABBTree::queryFrustum(Frustum const &frustum, Callback &&callback) const
+{
+    if(m_root == NULL_NODE) return;
+    unsigned stack[128];
+    unsigned stackSize = 0;
+    stack[stackSize++] = m_root;
+    while(stackSize > 0) {
+        unsigned nodeIndex = stack[--stackSize];
+        Node const &node = m_nodes[nodeIndex];
+        if(!frustum.intersects(node.bounds)) continue;
+        if(node.isLeaf()) {
+            callback(nodeIndex);
+        } else {
+            assert(stackSize + 2 <= 128);
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = node.left;
+        }
+    }
+}
+template <typename Callback>
+void game::DynamicAABBTree::queryOverlap(AABB<glm::vec3> const &box, Callback &&callback) const
+{
+    if(m_root == NULL_NODE) return;
+    unsigned stack[128];
+    unsigned stackSize = 0;
+    stack[stackSize++] = m_root;
+    while(stackSize > 0) {
+        unsigned nodeIndex = stack[--stackSize];
+        Node const &node = m_nodes[nodeIndex];
+        if(!overlaps(node.bounds, box)) continue;
+        if(node.isLeaf()) {
+            callback(nodeIndex);
+        } else {
+            assert(stackSize + 2 <= 128);
+            stack[stackSize++] = node.right;
+            stack[stackSize++] = node.left;
+        }
+    }
+}
+template <typename Callback>
+void game::DynamicAABBTree::queryPairs(Callback &&callback) const
+{
+    for(unsigned proxy = 0; proxy < m_nodes.size(); ++proxy) {
+        if(m_nodes[proxy].height != 0) continue; // only leaves
+        queryOverlap(m_nodes[proxy].bounds, [&](unsigned other) {
+            if(other > proxy) callback(proxy, other);
+        });
+    }
+}
@@ -0,0 +1,35 @@
+#include "DynamicResolution.hpp"
+#include <algorithm>
+#include <cmath>
+
+void game::DynamicResolution::update(float targetFrameTime, float minScale)
+{
+    if(std::optional<double> time = m_timer.poll()) {
+        m_frameTime = m_frameTime == 0 ? time.value() : m_frameTime + (time.value() - m_frameTime) * SMOOTHING;
+    }
+    ++m_framesSinceChange;
+    if(targetFrameTime <= 0) {
+        m_scale = 1;
+        return;
+    }
+    if(m_frameTime == 0 || m_framesSinceChange < COOLDOWN_FRAMES) return;
+
+    float scale = m_scale;
+    if(m_frameTime > targetFrameTime) {
+        // the frame time is roughly proportional to the pixel count
+        scale = m_scale * static_cast<float>(std::sqrt(targetFrameTime * HEADROOM / m_frameTime));
+        scale = std::floor(scale / SCALE_STEP) * SCALE_STEP;
+    } else if(m_frameTime < targetFrameTime * SCALE_UP_THRESHOLD) {
+        scale = std::round((m_scale + SCALE_STEP) / SCALE_STEP) * SCALE_STEP;
+    }
+    scale = std::clamp(scale, std::clamp(minScale, SCALE_STEP, 1.0f), 1.0f);
+    if(scale != m_scale) {
+        m_scale = scale;
+        m_framesSinceChange = 0;
+    }
+}
+
+glm::ivec2 game::DynamicResolution::getRenderSize(int width, int height) const
+{
+    return glm::max(glm::ivec2{glm::round(glm::vec2{width, height} * m_scale)}, glm::ivec2{1});
+}
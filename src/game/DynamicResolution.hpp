@@ -0,0 +1,38 @@
+#pragma once
+#include "opengl/GpuTimer.hpp"
+#include "glm/glm.hpp"
+
+namespace game
+{
+    /**
+     * picks the internal resolution scale of one render target from its measured gpu frame time.
+     * the time is smoothed and changes are quantized and spaced out, so the scale does not oscillate around the budget
+     */
+    class DynamicResolution
+    {
+    public:
+        static constexpr float SCALE_STEP = 0.05f;
+        static constexpr unsigned COOLDOWN_FRAMES = 8; // after a change, the queries in flight still measured the old scale
+        static constexpr float SMOOTHING = 0.2f; // weight of the newest measurement
+        static constexpr float SCALE_UP_THRESHOLD = 0.75f; // of the budget, below it the scale grows again
+        static constexpr float HEADROOM = 0.9f; // scaling down aims a bit below the budget
+    private:
+        opengl::GpuTimer m_timer;
+        double m_frameTime = 0; // smoothed, milliseconds
+        float m_scale = 1;
+        unsigned m_framesSinceChange = 0;
+    public:
+        DynamicResolution() = default;
+        DynamicResolution(DynamicResolution const &) = delete;
+        DynamicResolution &operator=(DynamicResolution const &) = delete;
+
+        // targetFrameTime 0 -- full resolution
+        void update(float targetFrameTime, float minScale);
+        // of the frame at the scale update returned
+        glm::ivec2 getRenderSize(int width, int height) const;
+
+        inline opengl::GpuTimer &getTimer() { return m_timer; }
+        inline float getScale() const { return m_scale; }
+        inline double getFrameTime() const { return m_frameTime; }
+    };
+} // namespace game
@@ -0,0 +1,173 @@
+#include "FrameGraph.hpp"
+#include "opengl/StateCache.hpp"
+#include "utils/Profiler.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+    int roundUp(int size, int step)
+    {
+        return std::max(1, (size + step - 1) / step * step);
+    }
+    size_t getTexelSize(GLenum format)
+    {
+        switch(format) {
+        case GL_RGBA32F:            return 16;
+        case GL_RGBA16F:            return 8;
+        case GL_R8:                 return 1;
+        case GL_RG8:                return 2;
+        default:                    return 4; // rgba8, rg16, r32f, depth24 stencil8 ...
+        }
+    }
+} // namespace
+
+opengl::Texture const &game::TexturePool::acquire(Desc const &desc)
+{
+    Desc rounded{roundUp(desc.width, SIZE_STEP), roundUp(desc.height, SIZE_STEP), desc.format};
+    // smallest free texture that fits
+    Entry *best = nullptr;
+    for(std::unique_ptr<Entry> const &entry : m_textures) {
+        if(entry->inUse || entry->desc.format != rounded.format || entry->desc.width < rounded.width || entry->desc.height < rounded.height) continue;
+        if(!best || entry->desc.width * entry->desc.height < best->desc.width * best->desc.height) best = entry.get();
+    }
+    if(!best) {
+        best = m_textures.emplace_back(std::make_unique<Entry>()).get();
+        best->desc = rounded;
+        best->texture.bind();
+        glTexStorage2D(GL_TEXTURE_2D, 1, rounded.format, rounded.width, rounded.height);
+    }
+    best->inUse = true;
+    best->lastUse = m_frame;
+    return best->texture;
+}
+
+void game::TexturePool::release(opengl::Texture const &texture)
+{
+    auto entry = std::find_if(m_textures.begin(), m_textures.end(), [&](std::unique_ptr<Entry> const &entry){ return &entry->texture == &texture; });
+    assert(entry != m_textures.end() && (*entry)->inUse);
+    (*entry)->inUse = false;
+    (*entry)->lastUse = m_frame;
+}
+
+opengl::Framebuffer const &game::TexturePool::getFramebuffer(std::vector<std::pair<GLenum, opengl::Texture const *>> const &attachments)
+{
+    std::vector<std::pair<GLenum, unsigned>> key;
+    for(auto const &[attachment, texture] : attachments) {
+        key.emplace_back(attachment, texture->getRenderID());
+    }
+    auto cached = std::find_if(m_framebuffers.begin(), m_framebuffers.end(), [&](std::unique_ptr<FramebufferEntry> const &entry){ return entry->attachments == key; });
+    if(cached != m_framebuffers.end()) {
+        (*cached)->lastUse = m_frame;
+        return (*cached)->framebuffer;
+    }
+
+    FramebufferEntry &entry = *m_framebuffers.emplace_back(std::make_unique<FramebufferEntry>());
+    entry.attachments = key;
+    entry.lastUse = m_frame;
+    entry.framebuffer.bind();
+    std::vector<GLenum> drawBuffers;
+    for(auto const &[attachment, texture] : attachments) {
+        entry.framebuffer.attach(*texture, attachment);
+        if(attachment >= GL_COLOR_ATTACHMENT0 && attachment <= GL_COLOR_ATTACHMENT15) drawBuffers.push_back(attachment);
+    }
+    if(drawBuffers.empty()) {
+        glDrawBuffer(GL_NONE);
+    } else {
+        glDrawBuffers(static_cast<int>(drawBuffers.size()), drawBuffers.data());
+    }
+    assert(entry.framebuffer.isComplete());
+    opengl::getStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+    return entry.framebuffer;
+}
+
+void game::TexturePool::endFrame()
+{
+    ++m_frame;
+    auto isStale = [&](unsigned lastUse){ return m_frame - lastUse > EVICT_FRAMES; };
+    // framebuffers first, they reference the textures
+    std::vector<unsigned> evicted;
+    for(std::unique_ptr<Entry> const &entry : m_textures) {
+        if(!entry->inUse && isStale(entry->lastUse)) evicted.push_back(entry->texture.getRenderID());
+    }
+    m_framebuffers.erase(std::remove_if(m_framebuffers.begin(), m_framebuffers.end(), [&](std::unique_ptr<FramebufferEntry> const &entry){
+        bool usesEvicted = std::any_of(entry->attachments.begin(), entry->attachments.end(), [&](std::pair<GLenum, unsigned> const &attachment){
+            return std::find(evicted.begin(), evicted.end(), attachment.second) != evicted.end();
+        });
+        return usesEvicted || isStale(entry->lastUse);
+    }), m_framebuffers.end());
+    m_textures.erase(std::remove_if(m_textures.begin(), m_textures.end(), [&](std::unique_ptr<Entry> const &entry){ return !entry->inUse && isStale(entry->lastUse); }), m_textures.end());
+}
+
+size_t game::TexturePool::getByteSize() const
+{
+    size_t size = 0;
+    for(std::unique_ptr<Entry> const &entry : m_textures) {
+        size += static_cast<size_t>(entry->desc.width) * entry->desc.height * getTexelSize(entry->desc.format);
+    }
+    return size;
+}
+
+game::FrameGraph::FrameGraph(TexturePool &pool) :
+    m_pool(pool)
+{
+}
+
+game::FrameGraph::Resource game::FrameGraph::createTexture(std::string const &name, int width, int height, GLenum format)
+{
+    m_resources.push_back(ResourceEntry{
+        .name = name,
+        .desc = TexturePool::Desc{width, height, format}
+    });
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+void game::FrameGraph::addPass(std::string const &name, std::vector<Resource> const &reads, std::vector<Resource> const &writes, std::function<void()> const &execute)
+{
+    m_passes.push_back(Pass{name, reads, writes, execute});
+}
+
+void game::FrameGraph::execute()
+{
+    // lifetimes
+    for(unsigned pass = 0; pass < m_passes.size(); ++pass) {
+        for(auto const *resources : {&m_passes[pass].reads, &m_passes[pass].writes}) {
+            for(Resource resource : *resources) {
+                ResourceEntry &entry = m_resources.at(resource);
+                entry.firstPass = std::min(entry.firstPass, pass);
+                entry.lastPass = std::max(entry.lastPass, pass);
+            }
+        }
+    }
+
+    for(unsigned pass = 0; pass < m_passes.size(); ++pass) {
+        for(ResourceEntry &entry : m_resources) {
+            if(entry.firstPass == pass) entry.texture = &m_pool.acquire(entry.desc);
+        }
+        {
+            profiler::GpuScope scope{m_passes[pass].name};
+            m_passes[pass].execute();
+        }
+        for(ResourceEntry &entry : m_resources) {
+            if(entry.lastPass != pass || !entry.texture) continue;
+            m_pool.release(*entry.texture);
+            entry.texture = nullptr;
+        }
+    }
+}
+
+opengl::Texture const &game::FrameGraph::getTexture(Resource resource) const
+{
+    ResourceEntry const &entry = m_resources.at(resource);
+    assert(entry.texture && "the resource is not alive, declare it as a read or write of the pass");
+    return *entry.texture;
+}
+
+opengl::Framebuffer const &game::FrameGraph::getFramebuffer(std::vector<std::pair<GLenum, Resource>> const &attachments) const
+{
+    std::vector<std::pair<GLenum, opengl::Texture const *>> textures;
+    for(auto const &[attachment, resource] : attachments) {
+        textures.emplace_back(attachment, &getTexture(resource));
+    }
+    return m_pool.getFramebuffer(textures);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "opengl/Texture.hpp"
+#include "opengl/Framebuffer.hpp"
+#include "glad/gl.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <utility>
+
+namespace game
+{
+    /**
+     * render targets that only live within a frame, shared by every camera and every frame graph.
+     * sizes are rounded up to SIZE_STEP and a free texture at least as large as asked for is reused, so dragging the window
+     * or cameras of different sizes do not reallocate. textures unused for EVICT_FRAMES frames are deleted
+     */
+    class TexturePool
+    {
+    public:
+        static constexpr int SIZE_STEP = 128;
+        static constexpr unsigned EVICT_FRAMES = 120;
+
+        struct Desc
+        {
+            int width;
+            int height;
+            GLenum format; // sized internal format
+        };
+    private:
+        struct Entry
+        {
+            Desc desc;
+            opengl::Texture texture{GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE}; // linear for upscaling, the passes fetch texels
+            bool inUse = false;
+            unsigned lastUse = 0;
+        };
+        struct FramebufferEntry
+        {
+            std::vector<std::pair<GLenum, unsigned>> attachments; // attachment point, texture
+            opengl::Framebuffer framebuffer{0};
+            unsigned lastUse = 0;
+        };
+        std::vector<std::unique_ptr<Entry>> m_textures; // stable addresses, handed out by reference
+        std::vector<std::unique_ptr<FramebufferEntry>> m_framebuffers;
+        unsigned m_frame = 0;
+    public:
+        TexturePool() = default;
+        TexturePool(TexturePool const &) = delete;
+        TexturePool &operator=(TexturePool const &) = delete;
+
+        // the texture may be larger than desc, passes address it by texel and stay inside the viewport
+        opengl::Texture const &acquire(Desc const &desc);
+        void release(opengl::Texture const &texture);
+        // cached by attachments, color attachments are drawn to in the given order
+        opengl::Framebuffer const &getFramebuffer(std::vector<std::pair<GLenum, opengl::Texture const *>> const &attachments);
+        // evicts what was not used for a while
+        void endFrame();
+
+        inline size_t getTextureCount() const { return m_textures.size(); }
+        size_t getByteSize() const;
+    };
+
+    /**
+     * the passes of one camera frame, declared with the transient textures they read and write.
+     * execute() runs them in declaration order, acquiring every texture from the pool right before its first pass and
+     * releasing it right after its last one, so textures of the same format with disjoint lifetimes share memory
+     */
+    class FrameGraph
+    {
+    public:
+        using Resource = unsigned;
+    private:
+        struct ResourceEntry
+        {
+            std::string name;
+            TexturePool::Desc desc;
+            opengl::Texture const *texture = nullptr; // only while alive
+            unsigned firstPass = ~0u;
+            unsigned lastPass = 0;
+        };
+        struct Pass
+        {
+            std::string name;
+            std::vector<Resource> reads;
+            std::vector<Resource> writes;
+            std::function<void()> execute;
+        };
+        TexturePool &m_pool;
+        std::vector<ResourceEntry> m_resources;
+        std::vector<Pass> m_passes;
+    public:
+        explicit FrameGraph(TexturePool &pool);
+        FrameGraph(FrameGraph const &) = delete;
+        FrameGraph &operator=(FrameGraph const &) = delete;
+
+        Resource createTexture(std::string const &name, int width, int height, GLenum format);
+        void addPass(std::string const &name, std::vector<Resource> const &reads, std::vector<Resource> const &writes, std::function<void()> const &execute);
+        void execute();
+
+        // only valid inside a pass declaring the resource
+        opengl::Texture const &getTexture(Resource resource) const;
+        opengl::Framebuffer const &getFramebuffer(std::vector<std::pair<GLenum, Resource>> const &attachments) const;
+        inline std::string const &getName(Resource resource) const { return m_resources.at(resource).name; }
+    };
+} // namespace game
@@ -0,0 +1,122 @@
+#include "Frustum.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    // summed in the order of the sse path, so the scalar tests agree with it on boxes right on a plane
+    inline float planeDistance(float normalX, float normalY, float normalZ, float distance, glm::vec3 const &center)
+    {
+        return distance + (normalX * center.x + (normalY * center.y + normalZ * center.z));
+    }
+    inline float planeRadius(float normalX, float normalY, float normalZ, glm::vec3 const &extents)
+    {
+        return std::abs(normalX) * extents.x + (std::abs(normalY) * extents.y + std::abs(normalZ) * extents.z);
+    }
+} // namespace
+
+AABB<glm::vec3> game::transformAABB(AABB<glm::vec3> const &box, glm::mat4 const &matrix)
+{
+    glm::vec3 center = glm::vec3{matrix * glm::vec4{box.getCenter(), 1}};
+    glm::mat3 absolute{glm::abs(glm::vec3{matrix[0]}), glm::abs(glm::vec3{matrix[1]}), glm::abs(glm::vec3{matrix[2]})};
+    glm::vec3 extents = absolute * box.getExtents();
+    return AABB<glm::vec3>{center - extents, center + extents};
+}
+game::BoundingSphere game::transformSphere(BoundingSphere const &sphere, glm::mat4 const &matrix)
+{
+    float maxScale = std::max({glm::length(glm::vec3{matrix[0]}), glm::length(glm::vec3{matrix[1]}), glm::length(glm::vec3{matrix[2]})});
+    return BoundingSphere{
+        .center = glm::vec3{matrix * glm::vec4{sphere.center, 1}},
+        .radius = sphere.radius * maxScale
+    };
+}
+
+game::Frustum::Frustum(glm::mat4 const &viewProjection)
+{
+    // Gribb & Hartmann: planes are sums / differences of the matrix rows. glm is column major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; ++i) {
+        rows[i] = glm::vec4{viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]};
+    }
+    glm::vec4 const planes[6] = {
+        rows[3] + rows[0], // left
+        rows[3] - rows[0], // right
+        rows[3] + rows[1], // bottom
+        rows[3] - rows[1], // top
+        rows[3] + rows[2], // near
+        rows[3] - rows[2], // far
+    };
+    for(unsigned i = 0; i < 8; ++i) {
+        glm::vec4 plane = planes[std::min(i, 5u)];
+        plane /= glm::length(glm::vec3{plane});
+        m_normalX[i] = plane.x;
+        m_normalY[i] = plane.y;
+        m_normalZ[i] = plane.z;
+        m_distance[i] = plane.w;
+    }
+}
+
+glm::vec4 game::Frustum::getPlane(unsigned index) const
+{
+    return glm::vec4{m_normalX[index], m_normalY[index], m_normalZ[index], m_distance[index]};
+}
+
+bool game::Frustum::intersects(AABB<glm::vec3> const &box) const
+{
+    glm::vec3 center = box.getCenter();
+    glm::vec3 extents = box.getExtents();
+    // the box is outside if it is fully behind any plane: dot(n, center) + d + dot(|n|, extents) < 0
+#ifdef FRUSTUM_USE_SSE
+    __m128 const centerX = _mm_set1_ps(center.x), centerY = _mm_set1_ps(center.y), centerZ = _mm_set1_ps(center.z);
+    __m128 const extentX = _mm_set1_ps(extents.x), extentY = _mm_set1_ps(extents.y), extentZ = _mm_set1_ps(extents.z);
+    __m128 const signMask = _mm_set1_ps(-0.0f);
+    int outside = 0;
+    for(unsigned i = 0; i < 8; i += 4) {
+        __m128 normalX = _mm_load_ps(m_normalX + i);
+        __m128 normalY = _mm_load_ps(m_normalY + i);
+        __m128 normalZ = _mm_load_ps(m_normalZ + i);
+        __m128 distance = _mm_add_ps(_mm_load_ps(m_distance + i), _mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_add_ps(_mm_mul_ps(normalY, centerY), _mm_mul_ps(normalZ, centerZ))));
+        __m128 radius = _mm_add_ps(
+            _mm_mul_ps(_mm_andnot_ps(signMask, normalX), extentX), _mm_add_ps(
+            _mm_mul_ps(_mm_andnot_ps(signMask, normalY), extentY),
+            _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentZ)));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+    }
+    return outside == 0;
+#else
+    for(unsigned i = 0; i < 6; ++i) {
+        float distance = planeDistance(m_normalX[i], m_normalY[i], m_normalZ[i], m_distance[i], center);
+        float radius = planeRadius(m_normalX[i], m_normalY[i], m_normalZ[i], extents);
+        if(distance + radius < 0) return false;
+    }
+    return true;
+#endif
+}
+
+game::Frustum::Containment game::Frustum::classify(AABB<glm::vec3> const &box) const
+{
+    glm::vec3 center = box.getCenter();
+    glm::vec3 extents = box.getExtents();
+    Containment result = INSIDE;
+    for(unsigned i = 0; i < 6; ++i) {
+        float distance = planeDistance(m_normalX[i], m_normalY[i], m_normalZ[i], m_distance[i], center);
+        float radius = planeRadius(m_normalX[i], m_normalY[i], m_normalZ[i], extents);
+        if(distance + radius < 0) return OUTSIDE;
+        if(distance - radius < 0) result = INTERSECTING;
+    }
+    return result;
+}
+
+bool game::Frustum::intersects(BoundingSphere const &sphere) const
+{
+    for(unsigned i = 0; i < 6; ++i) {
+        float distance = m_normalX[i] * sphere.center.x + m_normalY[i] * sphere.center.y + m_normalZ[i] * sphere.center.z + m_distance[i];
+        if(distance < -sphere.radius) return false;
+    }
+    return true;
+}
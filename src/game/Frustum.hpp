@@ -0,0 +1,43 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "AABB.hpp"
+
+namespace game
+{
+    struct BoundingSphere
+    {
+        glm::vec3 center{0};
+        float radius = 0;
+    };
+
+    // world space bounds of a local box (Arvo's method, exact for the transformed box, conservative for its contents)
+    AABB<glm::vec3> transformAABB(AABB<glm::vec3> const &box, glm::mat4 const &matrix);
+    BoundingSphere transformSphere(BoundingSphere const &sphere, glm::mat4 const &matrix);
+
+    /**
+     * camera frustum planes extracted from a view projection matrix.
+     * the planes are kept in structure of arrays layout, so one box is tested against 4 planes per simd instruction
+     */
+    class Frustum
+    {
+    public:
+        enum Containment
+        {
+            OUTSIDE, INTERSECTING, INSIDE
+        };
+    private:
+        // 6 planes padded to 8 by repeating the last ones
+        alignas(16) float m_normalX[8];
+        alignas(16) float m_normalY[8];
+        alignas(16) float m_normalZ[8];
+        alignas(16) float m_distance[8];
+    public:
+        Frustum() = default;
+        Frustum(glm::mat4 const &viewProjection);
+
+        bool intersects(AABB<glm::vec3> const &box) const;
+        Containment classify(AABB<glm::vec3> const &box) const; // INSIDE lets hierarchies accept whole subtrees without further tests
+        bool intersects(BoundingSphere const &sphere) const;
+        glm::vec4 getPlane(unsigned index) const;
+    };
+} // namespace game
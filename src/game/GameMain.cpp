@@ -8,28 +8,46 @@
 #include <memory>
 #include <random>
 #include <iostream>
+#include <algorithm>
 #include "utils/Model.hpp"
 #include "LevelParser.hpp"
+#include "utils/Profiler.hpp"
+#include "utils/FileWatcher.hpp"
+#include "CameraPath.hpp"
+#include "Benchmark.hpp"
+#include "opengl/StateCache.hpp"
+#include "json.hpp"
+#include <fstream>
+#include <optional>
+#include <cmath>
+#include <cctype>
 
 void registerEcs();
 
 namespace game
 {
-    void gameMain(GLFWwindow *mainWindow);
+    void gameMain(GLFWwindow *mainWindow, std::filesystem::path const &recordPath);
+    int benchmarkLights(GLFWwindow *mainWindow, unsigned maxLightCount);
+    int benchmarkScene(GLFWwindow *mainWindow, std::filesystem::path const &scenePath, CameraPath const &cameraPath, std::filesystem::path const &outputPath, PrepassOverride prepass);
 } // namespace game
 
-ecs::Entity_t makeSceneEntity(std::filesystem::path const &filepath)
+void loadScene(ecs::Entity_t sceneEntity, std::filesystem::path const &filepath)
 {
-    ecs::Entity_t result = ecs::makeEntity<game::Scene>();
-    game::Scene &scene = ecs::get<game::Scene>(result);
+    game::Scene &scene = ecs::get<game::Scene>(sceneEntity);
     scene = game::getLevelParser().parseScene(filepath);
     if(scene.containedEntities.size() == 0) {
         std::cout << "failed to load scene \"" << filepath << "\"!\n";
     }
     if(game::getLevelParser().getErrorString() != "") {
         std::cout << game::getLevelParser().getErrorString() << '\n';
+        game::getLevelParser().clearError();
     }
     ecs::getSystemManager().getEntities().insert(scene.containedEntities.begin(), scene.containedEntities.end());
+}
+ecs::Entity_t makeSceneEntity(std::filesystem::path const &filepath)
+{
+    ecs::Entity_t result = ecs::makeEntity<game::Scene>();
+    loadScene(result, filepath);
     return result;
 }
 ecs::Entity_t makeWindowEntity(GLFWwindow *window) 
@@ -43,13 +61,115 @@ ecs::Entity_t makeWindowEntity(GLFWwindow *window)
 ecs::Entity_t makeLightStorageEntity() 
 {
     using namespace game;
-    ecs::Entity_t lightStorageEntity = ecs::makeEntity<LightUBO, LightUpdater::LightStorage>();
-    ecs::get<LightUBO>(lightStorageEntity) = {};
+    ecs::Entity_t lightStorageEntity = ecs::makeEntity<LightBuffers, LightUpdater::LightStorage>();
+    ecs::get<LightBuffers>(lightStorageEntity) = {};
     ecs::get<LightUpdater::LightStorage>(lightStorageEntity) = {};
     return lightStorageEntity;
 }
 
-void game::gameMain(GLFWwindow *window) 
+std::optional<ecs::Entity_t> findCameraEntity()
+{
+    std::set<ecs::Entity_t> const &entities = ecs::getSystemManager().getEntities();
+    auto cameraEntity = std::find_if(entities.begin(), entities.end(), [](ecs::Entity_t const &entity){ return ecs::entityHasComponent<game::Camera>(entity) && ecs::entityHasComponent<game::RenderTarget>(entity); });
+    if(cameraEntity == entities.end()) return {};
+    return *cameraEntity;
+}
+
+// the stages are named by their extension alone (".frag"), which std::filesystem takes for a stem
+std::string getExtension(std::filesystem::path const &path)
+{
+    std::string name = path.filename().string();
+    size_t dot = name.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : name.substr(dot);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c){ return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+// destroys the entities of the scenes and parses them again, the models are imported again first. the controllable camera keeps its place
+void reloadScenes(std::set<ecs::Entity_t> const &sceneEntities, std::set<std::filesystem::path> const &models)
+{
+    using namespace game;
+    std::optional<ecs::Entity_t> camera = findCameraEntity();
+    std::optional<Position> position;
+    std::optional<OrientationEuler> rotation;
+    std::optional<bool> locked;
+    if(camera && ecs::entityHasComponent<ControllableCamera>(*camera)) {
+        if(ecs::entityHasComponent<Position>(*camera)) position = ecs::get<Position>(*camera);
+        if(ecs::entityHasComponent<OrientationEuler>(*camera)) rotation = ecs::get<OrientationEuler>(*camera);
+        locked = ecs::get<ControllableCamera>(*camera).locked;
+    }
+
+    for(ecs::Entity_t const &sceneEntity : sceneEntities) {
+        for(ecs::Entity_t const &entity : ecs::get<Scene>(sceneEntity).containedEntities) {
+            ecs::destroyEntity(entity);
+        }
+    }
+    for(std::filesystem::path const &model : models) {
+        getLevelParser().forgetModel(model); // every scene using it is reloaded, its geometry is freed with the entities above
+    }
+    for(ecs::Entity_t const &sceneEntity : sceneEntities) {
+        std::filesystem::path filepath = ecs::get<Scene>(sceneEntity).filePath;
+        loadScene(sceneEntity, filepath);
+        std::cout << "reloaded " << filepath << '\n';
+    }
+
+    camera = findCameraEntity();
+    if(!camera || !ecs::entityHasComponent<ControllableCamera>(*camera)) return;
+    if(position && ecs::entityHasComponent<Position>(*camera)) ecs::get<Position>(*camera) = *position;
+    if(rotation && ecs::entityHasComponent<OrientationEuler>(*camera)) ecs::get<OrientationEuler>(*camera) = *rotation;
+    if(locked) ecs::get<ControllableCamera>(*camera).locked = *locked;
+}
+
+/*
+ * rebuilds what depends on the changed files: the shader programs that use a file are recompiled, textures are uploaded again in place
+ * and the scenes whose file or models changed are parsed again, the unchanged models and textures come from the cache.
+ * true if a scene was reloaded, its entities are new then
+ */
+bool reloadChangedFiles(std::vector<std::filesystem::path> const &files)
+{
+    static std::set<std::string> const SHADER_EXTENSIONS{".vert", ".geom", ".frag", ".comp", ".glsl"};
+    static std::set<std::string> const IMAGE_EXTENSIONS{".png", ".jpg", ".jpeg", ".tga", ".bmp"};
+    std::set<ecs::Entity_t> scenes;
+    std::set<std::filesystem::path> models;
+    for(std::filesystem::path const &file : files) {
+        std::string extension = getExtension(file);
+        if(SHADER_EXTENSIONS.count(extension)) {
+            std::shared_ptr<game::Renderer> renderer = ecs::getSystemManager().getSystem<game::Renderer>();
+            unsigned count = renderer ? renderer->reloadShaders(file) : 0;
+            for(ecs::Entity_t const &entity : ecs::getSystemManager().getEntities()) {
+                if(!ecs::entityHasComponent<opengl::ShaderProgram>(entity)) continue;
+                opengl::ShaderProgram &shader = ecs::get<opengl::ShaderProgram>(entity);
+                if(shader.dependsOn(file) && shader.reload()) ++count;
+            }
+            if(count > 0) std::cout << "recompiling " << count << " shader programs using " << file << '\n';
+        } else if(IMAGE_EXTENSIONS.count(extension)) {
+            if(game::getLevelParser().reloadTexture(file) > 0) std::cout << "reloaded " << file << '\n';
+        } else { // a scene or a model file
+            std::filesystem::path path = std::filesystem::weakly_canonical(file);
+            std::optional<std::filesystem::path> model = game::getLevelParser().findModel(path);
+            for(ecs::Entity_t const &entity : ecs::getSystemManager().getEntities()) {
+                if(!ecs::entityHasComponent<game::Scene>(entity)) continue;
+                game::Scene const &scene = ecs::get<game::Scene>(entity);
+                bool sceneChanged = std::filesystem::weakly_canonical(scene.filePath) == path;
+                if(sceneChanged) {
+                    std::ifstream stream{scene.filePath};
+                    if(!nlohmann::json::accept(stream)) { // half edited, the next save comes
+                        std::cout << "not reloading " << scene.filePath << ", it is not valid json\n";
+                        continue;
+                    }
+                }
+                if(sceneChanged || (model && scene.models.count(*model))) scenes.insert(entity);
+            }
+            if(model) models.insert(*model);
+        }
+    }
+    if(scenes.empty()) return false;
+    reloadScenes(scenes, models);
+    return true;
+}
+
+// recordPath -- if not empty, the flight of the camera is saved there as a camera path on exit
+void game::gameMain(GLFWwindow *window, std::filesystem::path const &recordPath) 
 {
     registerEcs();
     glfwSetKeyCallback(window, game::key_callback);
@@ -61,6 +181,7 @@ void game::gameMain(GLFWwindow *window)
     // ecs::getSystemManager().getEntities().insert(makeSceneEntity("res/scenes/plane.json"));
     ecs::getSystemManager().getEntities().insert(makeSceneEntity("res/scenes/sponza.json"));
     ecs::getSystemManager().getEntities().insert(makeLightStorageEntity());
+    FileWatcher watcher{{"shaders", "res"}};
     
     // ====================
 
@@ -75,21 +196,335 @@ void game::gameMain(GLFWwindow *window)
         }  
     }; 
     fpsShower.detach();
+
+    constexpr double RECORD_INTERVAL = 0.25; // seconds between camera path keys
+    CameraPath recordedPath;
+    std::optional<ecs::Entity_t> recordedCamera = findCameraEntity();
+    double recordTime = 0;
+    double nextKeyTime = 0;
     while (!glfwWindowShouldClose(window))
     {
         auto start = std::chrono::high_resolution_clock::now();
+        if(reloadChangedFiles(watcher.takeChanges())) recordedCamera = findCameraEntity();
         
-        ecs::getSystemManager().update(deltatime);
+        {
+            profiler::CpuScope scope{"frame"};
+            ecs::getSystemManager().update(deltatime);
+        }
+        opengl::getStreamBuffer().endFrame();
+        profiler::getProfiler().endFrame();
+
+        if(!recordPath.empty() && recordedCamera && recordTime >= nextKeyTime
+            && ecs::entityHasComponent<Position>(*recordedCamera) && ecs::entityHasComponent<OrientationEuler>(*recordedCamera)) {
+            recordedPath.addKey(CameraPath::Key{
+                .time = static_cast<float>(recordTime),
+                .position = ecs::get<Position>(*recordedCamera).position,
+                .rotation = ecs::get<OrientationEuler>(*recordedCamera).rotation
+            });
+            nextKeyTime = recordTime + RECORD_INTERVAL;
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
         deltatime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() * 1.0E-6;
+        recordTime += deltatime;
+    }
+    if(!recordPath.empty() && recordedPath.save(recordPath)) {
+        std::cout << "saved " << recordedPath.getKeys().size() << " camera path keys to " << recordPath << "\n";
+    }
+}
+
+/*
+ * renders sponza with a growing number of random point lights, forward and deferred on every step.
+ * the measured frames are bracketed by glFinish, so the average covers the gpu work too. vsync is turned off
+ */
+int game::benchmarkLights(GLFWwindow *window, unsigned maxLightCount)
+{
+    constexpr unsigned WARMUP_FRAMES = 20;
+    constexpr unsigned MEASURED_FRAMES = 100;
+    registerEcs();
+    ecs::getSystemManager().getEntities().insert(makeWindowEntity(window));
+    ecs::Entity_t sceneEntity = makeSceneEntity("res/scenes/sponza.json");
+    ecs::getSystemManager().getEntities().insert(sceneEntity);
+    ecs::getSystemManager().getEntities().insert(makeLightStorageEntity());
+
+    std::set<ecs::Entity_t> const &entities = ecs::getSystemManager().getEntities();
+    auto cameraEntity = std::find_if(entities.begin(), entities.end(), [](ecs::Entity_t const &entity){ return ecs::entityHasComponent<RenderTarget>(entity); });
+    if(cameraEntity == entities.end()) {
+        std::cout << "no camera to benchmark!\n";
+        return 1;
+    }
+    RenderTarget &rtarget = ecs::get<RenderTarget>(*cameraEntity);
+    Scene const &scene = ecs::get<Scene>(sceneEntity);
+    AABB<glm::vec3> bounds = scene.staticBVH.empty() ? AABB<glm::vec3>{glm::vec3{-10, 0, -5}, glm::vec3{10, 10, 5}} : scene.staticBVH.getNodes().front().bounds;
+
+    glfwSwapInterval(0);
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> unit{0, 1};
+
+    std::cout << "lights\tforward ms\tdeferred ms\n";
+    unsigned lightCount = 0;
+    for(unsigned targetCount = 16; targetCount <= std::max(maxLightCount, 16u); targetCount *= 2) {
+        for(; lightCount < targetCount; ++lightCount) {
+            ecs::Entity_t light = ecs::makeEntity<Light, PointLight, Position>();
+            ecs::get<Light>(light) = {.color = glm::vec3{unit(random), unit(random), unit(random)}};
+            ecs::get<PointLight>(light) = {.attenuation = 10.0f};
+            ecs::get<Position>(light) = {bounds.min + (bounds.max - bounds.min) * glm::vec3{unit(random), unit(random), unit(random)}};
+            ecs::getSystemManager().getEntities().insert(light);
+        }
+        double times[2] = {};
+        RenderTarget::Shading const modes[2] = {RenderTarget::Shading::FORWARD, RenderTarget::Shading::DEFERRED};
+        for(unsigned mode = 0; mode < 2; ++mode) {
+            rtarget.shading = modes[mode];
+            std::chrono::high_resolution_clock::time_point start;
+            for(unsigned frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES; ++frame) {
+                if(frame == WARMUP_FRAMES) {
+                    glFinish();
+                    start = std::chrono::high_resolution_clock::now();
+                }
+                ecs::getSystemManager().update(1.0 / 60);
+                opengl::getStreamBuffer().endFrame();
+                profiler::getProfiler().endFrame();
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            glFinish();
+            times[mode] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count() * 1.0E-3 / MEASURED_FRAMES;
+        }
+        std::cout << targetCount << '\t' << times[0] << "\t\t" << times[1] << '\n';
+        if(glfwWindowShouldClose(window)) break;
+    }
+    return 0;
+}
+
+struct FrameTimes
+{
+    double cpu; // update and submission, milliseconds
+    double gpu;
+    double frame; // including the swap
+};
+struct StartupTimes
+{
+    double milliseconds = 0; // systems and scene, the shader programs are only submitted
+    double firstFrame = 0; // presented, drawn with whatever programs were ready
+    double shadersReady = 0; // every program compiled
+    opengl::ShaderProgram::CompileStats shaders{};
+};
+struct TimeSummary
+{
+    double mean, p50, p90, p95, p99, max;
+};
+TimeSummary summarize(std::vector<double> times)
+{
+    if(times.empty()) return {};
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](double p){ return times[std::min(times.size() - 1, static_cast<size_t>(std::ceil(p * times.size())) - 1)]; };
+    double sum = 0;
+    for(double time : times) sum += time;
+    return TimeSummary{sum / times.size(), percentile(0.5), percentile(0.9), percentile(0.95), percentile(0.99), times.back()};
+}
+// csv if the extension says so, json otherwise
+bool writeFrameTimes(std::filesystem::path const &path, std::filesystem::path const &scenePath, glm::ivec2 resolution, StartupTimes const &startup, std::vector<FrameTimes> const &frames)
+{
+    using json = nlohmann::json;
+    std::vector<double> cpu, gpu, frame;
+    for(FrameTimes const &times : frames) {
+        cpu.push_back(times.cpu);
+        gpu.push_back(times.gpu);
+        frame.push_back(times.frame);
+    }
+    TimeSummary const summaries[3] = {summarize(cpu), summarize(gpu), summarize(frame)};
+    char const *const names[3] = {"cpu", "gpu", "frame"};
+
+    std::cout << "startup " << startup.milliseconds << " ms, first frame at " << startup.firstFrame << " ms, shaders ready at " << startup.shadersReady << " ms\n";
+    std::cout << "shaders took " << startup.shaders.milliseconds << " ms on the main thread ("
+        << startup.shaders.compiled << " compiled, " << startup.shaders.loadedFromCache << " from the binary cache)\n";
+    std::cout << "\tmean\tp50\tp90\tp95\tp99\tmax (ms)\n";
+    for(unsigned i = 0; i < 3; ++i) {
+        TimeSummary const &summary = summaries[i];
+        std::cout << names[i] << '\t' << summary.mean << '\t' << summary.p50 << '\t' << summary.p90 << '\t' << summary.p95 << '\t' << summary.p99 << '\t' << summary.max << '\n';
+    }
+
+    std::ofstream file{path};
+    if(!file) {
+        std::cout << "failed to write the results to " << path << "\n";
+        return false;
+    }
+    if(path.extension() == ".csv") {
+        // the summary rows follow the frames, named in the frame column
+        file << "frame,cpu_ms,gpu_ms,frame_ms\n";
+        for(size_t i = 0; i < frames.size(); ++i) {
+            file << i << ',' << frames[i].cpu << ',' << frames[i].gpu << ',' << frames[i].frame << '\n';
+        }
+        auto row = [&](char const *name, double TimeSummary::*field){ file << name << ',' << summaries[0].*field << ',' << summaries[1].*field << ',' << summaries[2].*field << '\n'; };
+        row("mean", &TimeSummary::mean);
+        row("p50", &TimeSummary::p50);
+        row("p90", &TimeSummary::p90);
+        row("p95", &TimeSummary::p95);
+        row("p99", &TimeSummary::p99);
+        row("max", &TimeSummary::max);
+        file << "startup," << startup.milliseconds << ",,\n";
+        file << "first frame," << startup.firstFrame << ",,\n";
+        file << "shaders ready," << startup.shadersReady << ",,\n";
+        return true;
+    }
+    json root = {
+        {"scene", scenePath.string()},
+        {"resolution", {resolution.x, resolution.y}},
+        {"startup", {
+            {"ms", startup.milliseconds},
+            {"first frame ms", startup.firstFrame},
+            {"shaders ready ms", startup.shadersReady},
+            {"shader ms", startup.shaders.milliseconds},
+            {"shaders compiled", startup.shaders.compiled},
+            {"shaders from cache", startup.shaders.loadedFromCache}
+        }},
+        {"summary", json::object()},
+        {"frames", json::array()}
+    };
+    for(unsigned i = 0; i < 3; ++i) {
+        TimeSummary const &summary = summaries[i];
+        root["summary"][names[i]] = {{"mean", summary.mean}, {"p50", summary.p50}, {"p90", summary.p90}, {"p95", summary.p95}, {"p99", summary.p99}, {"max", summary.max}};
+    }
+    for(FrameTimes const &times : frames) {
+        root["frames"].push_back({{"cpu", times.cpu}, {"gpu", times.gpu}, {"frame", times.frame}});
+    }
+    file << root.dump(4) << '\n';
+    return true;
+}
+
+/*
+ * flies the first camera of the scene along the camera path and records the cpu, gpu and whole time of every frame.
+ * the window is expected to be hidden and sized to the path resolution. vsync and dynamic resolution are turned off,
+ * animations advance by a fixed step, so runs only differ by the machine. gpu times are read back after the last frame.
+ * the startup time covers the systems and the scene, it is cold or warm depending on the program binary cache.
+ * frames are rendered from the first key until every shader program is compiled, the measured frames only start after that.
+ * the prepass override replaces the depth prepass flag of every render target, BOTH runs the path once per setting
+ */
+int game::benchmarkScene(GLFWwindow *window, std::filesystem::path const &scenePath, CameraPath const &cameraPath, std::filesystem::path const &outputPath, PrepassOverride prepass)
+{
+    constexpr double FRAME_STEP = 1.0 / 60;
+    auto startupBegin = std::chrono::steady_clock::now();
+    registerEcs();
+    ecs::getSystemManager().getEntities().insert(makeWindowEntity(window));
+    ecs::getSystemManager().getEntities().insert(makeSceneEntity(scenePath));
+    ecs::getSystemManager().getEntities().insert(makeLightStorageEntity());
+    StartupTimes startup{
+        .milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count()
+    };
+
+    std::optional<ecs::Entity_t> cameraEntity = findCameraEntity();
+    if(!cameraEntity) {
+        std::cout << "no camera to benchmark!\n";
+        return 1;
+    }
+    for(ecs::Entity_t const &entity : ecs::getSystemManager().getEntities()) {
+        if(ecs::entityHasComponent<RenderTarget>(entity)) ecs::get<RenderTarget>(entity).targetFrameTime = 0;
+        if(ecs::entityHasComponent<ControllableCamera>(entity)) ecs::get<ControllableCamera>(entity).locked = false; // no mouse look
+    }
+    if(!ecs::entityHasComponent<Position>(*cameraEntity)) ecs::addComponent<Position>(*cameraEntity);
+    if(!ecs::entityHasComponent<OrientationEuler>(*cameraEntity)) ecs::addComponent<OrientationEuler>(*cameraEntity);
+    Camera &camera = ecs::get<Camera>(*cameraEntity);
+
+    glfwSwapInterval(0);
+    CameraPath::Key firstKey = cameraPath.sample(cameraPath.getKeys().empty() ? 0 : cameraPath.getKeys().front().time);
+    ecs::get<Position>(*cameraEntity).position = firstKey.position;
+    ecs::get<OrientationEuler>(*cameraEntity).rotation = firstKey.rotation;
+    for(bool first = true; first || opengl::ShaderProgram::getCompilingCount() > 0; first = false) {
+        ecs::getSystemManager().update(FRAME_STEP);
+        opengl::getStreamBuffer().endFrame();
+        profiler::getProfiler().endFrame();
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+        if(first) {
+            glFinish();
+            startup.firstFrame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+        }
+    }
+    glFinish();
+    startup.shadersReady = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupBegin).count();
+    startup.shaders = opengl::ShaderProgram::getCompileStats();
+
+    auto measure = [&]() {
+        std::vector<unsigned> queries(cameraPath.frames);
+        glGenQueries(static_cast<int>(queries.size()), queries.data());
+        std::vector<FrameTimes> frames;
+        float startTime = cameraPath.getKeys().empty() ? 0 : cameraPath.getKeys().front().time;
+        for(unsigned frame = 0; frame < cameraPath.warmupFrames + cameraPath.frames && !glfwWindowShouldClose(window); ++frame) {
+            bool measured = frame >= cameraPath.warmupFrames;
+            if(frame == cameraPath.warmupFrames) opengl::getStateCache().resetCounters();
+            unsigned index = measured ? frame - cameraPath.warmupFrames : 0;
+            float progress = measured && cameraPath.frames > 1 ? static_cast<float>(index) / (cameraPath.frames - 1) : 0;
+            CameraPath::Key key = cameraPath.sample(startTime + progress * cameraPath.getDuration());
+            ecs::get<Position>(*cameraEntity).position = key.position;
+            ecs::get<OrientationEuler>(*cameraEntity).rotation = key.rotation;
+
+            auto start = std::chrono::steady_clock::now();
+            if(measured) glBeginQuery(GL_TIME_ELAPSED, queries[index]);
+            ecs::getSystemManager().update(FRAME_STEP);
+            if(measured) glEndQuery(GL_TIME_ELAPSED);
+            opengl::getStreamBuffer().endFrame();
+            profiler::getProfiler().endFrame();
+            auto submitted = std::chrono::steady_clock::now();
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            if(!measured) continue;
+            frames.push_back(FrameTimes{
+                .cpu = std::chrono::duration<double, std::milli>(submitted - start).count(),
+                .gpu = 0,
+                .frame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+            });
+        }
+        glFinish();
+        for(size_t i = 0; i < frames.size(); ++i) { // fewer than the path has if the window was closed
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+            frames[i].gpu = nanoseconds * 1.0E-6;
+        }
+        glDeleteQueries(static_cast<int>(queries.size()), queries.data());
+
+        std::cout << frames.size() << " frames of " << scenePath << " at " << camera.width << "x" << camera.height << '\n';
+        if(!frames.empty()) {
+            opengl::StateCache::Counters const &counters = opengl::getStateCache().getCounters();
+            std::cout << "gl state changes per frame: " << counters.issued / frames.size() << " issued, " << counters.skipped / frames.size() << " skipped\n";
+        }
+        return frames;
+    };
+    auto setPrepass = [](bool enabled) {
+        for(ecs::Entity_t const &entity : ecs::getSystemManager().getEntities()) {
+            if(ecs::entityHasComponent<RenderTarget>(entity)) ecs::get<RenderTarget>(entity).depthPrepass = enabled;
+        }
+    };
+    glm::ivec2 resolution{camera.width, camera.height};
+    if(prepass != PrepassOverride::BOTH) {
+        if(prepass != PrepassOverride::SCENE) setPrepass(prepass == PrepassOverride::ON);
+        return writeFrameTimes(outputPath, scenePath, resolution, startup, measure()) ? 0 : 1;
+    }
+
+    // the same path twice, the results go next to each other: bench.json -> bench-prepass-off.json and bench-prepass-on.json
+    double meanFrame[2] = {};
+    double meanGpu[2] = {};
+    bool written = true;
+    for(bool enabled : {false, true}) {
+        std::cout << "depth prepass " << (enabled ? "on" : "off") << ":\n";
+        setPrepass(enabled);
+        std::vector<FrameTimes> frames = measure();
+        std::filesystem::path path = outputPath;
+        path.replace_filename(outputPath.stem().string() + (enabled ? "-prepass-on" : "-prepass-off") + outputPath.extension().string());
+        written = writeFrameTimes(path, scenePath, resolution, startup, frames) && written;
+        for(FrameTimes const &times : frames) {
+            meanFrame[enabled] += times.frame / frames.size();
+            meanGpu[enabled] += times.gpu / frames.size();
+        }
     }
+    std::cout << "depth prepass delta (on - off): frame " << meanFrame[1] - meanFrame[0] << " ms, gpu " << meanGpu[1] - meanGpu[0] << " ms\n";
+    return written ? 0 : 1;
 }
 
 void registerEcs()
 {
     using namespace game;
+    ecs::getSystemManager().registerSystem<MovementSystem>();
     ecs::getSystemManager().registerSystem<Renderer>();
     ecs::getSystemManager().registerSystem<CameraController>();
     ecs::getSystemManager().registerSystem<Animator>();
@@ -117,4 +552,7 @@ void registerEcs()
     ecs::getComponentManager().registerComponent<DirectionalLight>();
     ecs::getComponentManager().registerComponent<game::Transparent>();
     ecs::getComponentManager().registerComponent<game::SemiTransparent>();
+    ecs::getComponentManager().registerComponent<game::StaticGeometry>();
+    ecs::getComponentManager().registerComponent<game::DynamicGeometry>();
+    ecs::getComponentManager().registerComponent<Velocity>();
 }
\ No newline at end of file
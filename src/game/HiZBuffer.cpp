@@ -0,0 +1,115 @@
+#include "HiZBuffer.hpp"
+#include "opengl/StateCache.hpp"
+#include <algorithm>
+#include <cmath>
+
+game::HiZBuffer::~HiZBuffer()
+{
+    for(Readback &readback : m_readbacks) {
+        if(readback.fence) glDeleteSync(readback.fence);
+    }
+}
+
+glm::ivec2 game::HiZBuffer::getLevelSize(int level) const
+{
+    return glm::max(glm::ivec2{m_width, m_height} >> level, glm::ivec2{1});
+}
+
+void game::HiZBuffer::resize(int depthWidth, int depthHeight)
+{
+    if(m_pyramid.getRenderID() == 0) {
+        m_pyramid = opengl::Texture{GL_NEAREST_MIPMAP_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE};
+        for(Readback &readback : m_readbacks) {
+            readback.buffer = opengl::PixelBuffer{0};
+        }
+    }
+    m_width = std::max(1, depthWidth / 2);
+    m_height = std::max(1, depthHeight / 2);
+    m_levelCount = 1 + static_cast<int>(std::log2(std::max(m_width, m_height)));
+    m_readbackLevel = 0;
+    while(getLevelSize(m_readbackLevel).x > MAX_READBACK_WIDTH && m_readbackLevel + 1 < m_levelCount) ++m_readbackLevel;
+
+    m_pyramid.bind();
+    for(int level = 0; level < m_levelCount; ++level) {
+        glm::ivec2 size = getLevelSize(level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, size.x, size.y, 0, GL_RED, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_levelCount - 1);
+
+    glm::ivec2 readbackSize = getLevelSize(m_readbackLevel);
+    for(Readback &readback : m_readbacks) {
+        if(readback.fence) {
+            glDeleteSync(readback.fence); // the old contents have the old size
+            readback.fence = nullptr;
+        }
+        readback.buffer.bind();
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(readbackSize.x) * readbackSize.y * sizeof(float), nullptr, GL_STREAM_READ);
+    }
+    opengl::getStateCache().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_cpuPyramid.clear();
+}
+
+void game::HiZBuffer::build(opengl::ShaderProgram const &shader, opengl::Texture const &depth, int width, int height, glm::mat4 const &viewProjection)
+{
+    if(std::max(1, width / 2) != m_width || std::max(1, height / 2) != m_height || m_pyramid.getRenderID() == 0) resize(width, height);
+
+    shader.bind();
+    glUniform1i(shader.getUniform("u_source"), 0);
+    glm::ivec2 sourceSize{width, height};
+    for(int level = 0; level < m_levelCount; ++level) {
+        if(level == 0) {
+            depth.bind(0);
+            glUniform1i(shader.getUniform("u_sourceLevel"), 0);
+        } else {
+            m_pyramid.bind(0);
+            glUniform1i(shader.getUniform("u_sourceLevel"), level - 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT); // the previous level was written as an image
+        }
+        glUniform2i(shader.getUniform("u_sourceSize"), sourceSize.x, sourceSize.y);
+        glBindImageTexture(0, m_pyramid.getRenderID(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        glm::ivec2 size = getLevelSize(level);
+        glDispatchCompute((size.x + 7) / 8, (size.y + 7) / 8, 1);
+        sourceSize = size;
+    }
+    opengl::getStateCache().useProgram(0);
+
+    // start the readback, unless the slot is still waiting for the gpu (then the cpu pyramid just ages a frame)
+    Readback &readback = m_readbacks[m_nextReadback];
+    if(readback.fence) return;
+    glMemoryBarrier(GL_PIXEL_BUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+    readback.buffer.bind();
+    m_pyramid.bind();
+    glGetTexImage(GL_TEXTURE_2D, m_readbackLevel, GL_RED, GL_FLOAT, nullptr);
+    opengl::getStateCache().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.viewProjection = viewProjection;
+    m_nextReadback = (m_nextReadback + 1) % READBACK_COUNT;
+}
+
+bool game::HiZBuffer::poll()
+{
+    // slots finish in submission order, the newest finished one wins
+    Readback *newest = nullptr;
+    for(unsigned i = 0; i < READBACK_COUNT; ++i) {
+        Readback &readback = m_readbacks[(m_nextReadback + i) % READBACK_COUNT];
+        if(!readback.fence) continue;
+        GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        newest = &readback;
+    }
+    if(!newest) return false;
+
+    glm::ivec2 size = getLevelSize(m_readbackLevel);
+    newest->buffer.bind();
+    float const *depth = static_cast<float const *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<size_t>(size.x) * size.y * sizeof(float), GL_MAP_READ_BIT));
+    if(depth) {
+        m_cpuPyramid.assign(depth, size.x, size.y, newest->viewProjection);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    opengl::getStateCache().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return depth != nullptr;
+}
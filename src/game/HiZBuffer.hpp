@@ -0,0 +1,53 @@
+#pragma once
+#include "glad/gl.h"
+#include "glm/glm.hpp"
+#include "opengl/Texture.hpp"
+#include "opengl/Shader.hpp"
+#include "opengl/PixelBuffer.hpp"
+#include "DepthPyramid.hpp"
+#include <array>
+
+namespace game
+{
+    /**
+     * hierarchical z buffer of one render target. the max depth pyramid is built on the gpu from the depth buffer of the opaque pass,
+     * then a low resolution level is read back without stalling (pixel buffers + fences) and tested against on the cpu one or two frames later
+     */
+    class HiZBuffer
+    {
+    public:
+        static constexpr unsigned READBACK_COUNT = 3;
+        static constexpr int MAX_READBACK_WIDTH = 256;
+    private:
+        struct Readback
+        {
+            opengl::PixelBuffer buffer;
+            GLsync fence = nullptr;
+            glm::mat4 viewProjection{1.0f};
+        };
+        opengl::Texture m_pyramid;
+        int m_width = 0; // of the pyramid base, half of the depth buffer
+        int m_height = 0;
+        int m_levelCount = 0;
+        int m_readbackLevel = 0;
+        std::array<Readback, READBACK_COUNT> m_readbacks;
+        unsigned m_nextReadback = 0;
+        DepthPyramid m_cpuPyramid;
+
+        void resize(int depthWidth, int depthHeight);
+        glm::ivec2 getLevelSize(int level) const;
+    public:
+        HiZBuffer() = default;
+        HiZBuffer(HiZBuffer const &) = delete;
+        HiZBuffer &operator=(HiZBuffer const &) = delete;
+        ~HiZBuffer();
+
+        // builds the pyramid from the depth texture and starts an asynchronous readback
+        void build(opengl::ShaderProgram const &shader, opengl::Texture const &depth, int width, int height, glm::mat4 const &viewProjection);
+        // moves the newest finished readback into the cpu pyramid, returns false if none has finished since the last call
+        bool poll();
+
+        inline DepthPyramid const &getPyramid() const { return m_cpuPyramid; }
+        inline opengl::Texture const &getTexture() const { return m_pyramid; }
+    };
+} // namespace game
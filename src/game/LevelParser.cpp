@@ -3,6 +3,8 @@
 #include "Controller.hpp"
 #include "json.hpp"
 #include "Animator.hpp"
+#include "Renderer.hpp"
+#include "utils/Profiler.hpp"
 using json = nlohmann::json;
 constexpr glm::vec4 clearColor{0, 0, 0, 1};
 game::LevelParser::~LevelParser() = default;
@@ -100,6 +102,36 @@ void game::LevelParser::addTexture(ecs::Entity_t const &modelEntity, std::filesy
         mesh.textures.push_back(texture);
     }
 }
+unsigned game::LevelParser::reloadTexture(std::filesystem::path const &path)
+{
+    unsigned count = 0;
+    for(auto &[filepath, texture] : m_textureCache) {
+        if(std::filesystem::weakly_canonical(filepath) == std::filesystem::weakly_canonical(path) && texture.reload()) ++count;
+    }
+    for(auto &[filepath, model] : m_modelCache) {
+        count += model.reloadTexture(path);
+    }
+    return count;
+}
+std::optional<std::filesystem::path> game::LevelParser::findModel(std::filesystem::path const &path) const
+{
+    std::filesystem::path file = std::filesystem::weakly_canonical(path);
+    for(auto const &[filepath, model] : m_modelCache) {
+        std::filesystem::path modelFile = std::filesystem::weakly_canonical(filepath);
+        if(modelFile == file || (modelFile.parent_path() == file.parent_path() && modelFile.stem() == file.stem())) return modelFile;
+    }
+    return {};
+}
+void game::LevelParser::forgetModel(std::filesystem::path const &path)
+{
+    for(auto iter = m_modelCache.begin(); iter != m_modelCache.end();) {
+        if(std::filesystem::weakly_canonical(iter->first) != std::filesystem::weakly_canonical(path)) {
+            ++iter;
+            continue;
+        }
+        iter = m_modelCache.erase(iter);
+    }
+}
 template<size_t L = 3>
 glm::vec<L, float> getVecFromJSON(json const &jsonObj) {
     assert(jsonObj.is_array());
@@ -127,8 +159,37 @@ GLFWwindow * findWindow() {
     }
 }
 
+game::RenderTarget::OcclusionCulling getOcclusionCulling(json const &jsonentity)
+{
+    using game::RenderTarget;
+    std::string mode = jsonentity.contains("occlusion culling") && jsonentity.at("occlusion culling").is_string() ? jsonentity["occlusion culling"].get<std::string>() : "hi-z";
+    if(mode == "software") return RenderTarget::OcclusionCulling::SOFTWARE;
+    if(mode == "none") return RenderTarget::OcclusionCulling::NONE;
+    return RenderTarget::OcclusionCulling::HI_Z;
+}
+game::RenderTarget::Shading getShading(json const &jsonentity)
+{
+    using game::RenderTarget;
+    std::string mode = jsonentity.contains("shading") && jsonentity.at("shading").is_string() ? jsonentity["shading"].get<std::string>() : "forward";
+    return mode == "deferred" ? RenderTarget::Shading::DEFERRED : RenderTarget::Shading::FORWARD;
+}
+void game::LevelParser::addOccluder(Scene &scene, std::filesystem::path const &path, glm::mat4 const &modelMat)
+{
+    model::Model occluder{path, model::LOAD_DATA};
+    for(model::Mesh const &mesh : occluder.getMeshes()) {
+        if(!mesh.data.has_value() || mesh.data->indices.size() % 3 != 0) continue; // triangles only
+        unsigned base = static_cast<unsigned>(scene.occluderVertices.size());
+        for(glm::vec4 const &position : mesh.data->positions) {
+            scene.occluderVertices.push_back(glm::vec3{modelMat * glm::vec4{glm::vec3{position}, 1}});
+        }
+        for(unsigned index : mesh.data->indices) {
+            scene.occluderIndices.push_back(base + index);
+        }
+    }
+}
 game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
 { // FIXME: good luck reading it. 
+    profiler::CpuScope scope{"parse scene", "load"};
     std::ifstream filestream{filepath};
     if(!filestream) {
         m_errorStr = "failed to open file";
@@ -159,6 +220,7 @@ game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
                     false;
                 std::set<ecs::Entity_t> lights;
                 std::tie(entity, lights) = createModel(path, flipWindingOrder, flipTextures);
+                scene.models.insert(std::filesystem::weakly_canonical(path));
                 scene.containedEntities.insert(lights.begin(), lights.end());
                 ecs::addComponent(entity, MaterialProperties{});
                 MaterialProperties &materialProperties = ecs::get<MaterialProperties>(entity);
@@ -186,6 +248,9 @@ game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
                 if(jsonentity.contains("scale") && jsonentity.at("scale").is_array()) {
                     ecs::addComponent<game::Scale>(entity, {static_cast<glm::vec3>(getVecFromJSON(jsonentity["scale"]))});
                 }
+                if(jsonentity.contains("velocity") && jsonentity.at("velocity").is_array()) {
+                    ecs::addComponent<game::Velocity>(entity, {static_cast<glm::vec3>(getVecFromJSON(jsonentity["velocity"]))});
+                }
                 if(jsonentity.contains("repeat textures") && jsonentity.at("repeat textures").is_number()) {
                     ecs::addComponent(entity, RepeatTexture{jsonentity["repeat textures"].get<unsigned>()});
                 }
@@ -209,6 +274,11 @@ game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
                     }
                     ecs::addComponent(entity, color);
                 }
+                if(jsonentity.contains("occluder") && jsonentity.at("occluder").is_boolean() && jsonentity.at("occluder").get<bool>()) {
+                    addOccluder(scene, path, getModelMat(entity));
+                } else if(jsonentity.contains("occluder") && jsonentity.at("occluder").is_string()) { // simplified occluder mesh
+                    addOccluder(scene, jsonentity["occluder"].get<std::string>(), getModelMat(entity));
+                }
                 if(
                     (jsonentity.contains("transparent") && jsonentity.at("transparent").is_boolean() && jsonentity.at("transparent").get<bool>()) || 
                     (ecs::entityHasComponent<Color>(entity) && ecs::get<Color>(entity).color.a < 1)
@@ -231,6 +301,15 @@ game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
                 };
                 ecs::get<RenderTarget>(entity) = {};
                 ecs::get<RenderTarget>(entity).clearColor = clearColor;
+                ecs::get<RenderTarget>(entity).occlusionCulling = getOcclusionCulling(jsonentity);
+                ecs::get<RenderTarget>(entity).depthPrepass = jsonentity.contains("depth prepass") && jsonentity.at("depth prepass").is_boolean() && jsonentity["depth prepass"].get<bool>();
+                ecs::get<RenderTarget>(entity).shading = getShading(jsonentity);
+                if(jsonentity.contains("target frame time") && jsonentity.at("target frame time").is_number()) {
+                    ecs::get<RenderTarget>(entity).targetFrameTime = jsonentity["target frame time"].get<float>();
+                }
+                if(jsonentity.contains("min resolution scale") && jsonentity.at("min resolution scale").is_number()) {
+                    ecs::get<RenderTarget>(entity).minResolutionScale = jsonentity["min resolution scale"].get<float>();
+                }
                 ecs::get<Camera>(entity) = {};
                 ecs::get<Window>(entity) = {window};
 
@@ -244,6 +323,15 @@ game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
                 entity = ecs::makeEntity<Camera, PerspectiveProjection, RenderTarget>();
                 ecs::get<RenderTarget>(entity) = {};
                 ecs::get<RenderTarget>(entity).clearColor = clearColor;
+                ecs::get<RenderTarget>(entity).occlusionCulling = getOcclusionCulling(jsonentity);
+                ecs::get<RenderTarget>(entity).depthPrepass = jsonentity.contains("depth prepass") && jsonentity.at("depth prepass").is_boolean() && jsonentity["depth prepass"].get<bool>();
+                ecs::get<RenderTarget>(entity).shading = getShading(jsonentity);
+                if(jsonentity.contains("target frame time") && jsonentity.at("target frame time").is_number()) {
+                    ecs::get<RenderTarget>(entity).targetFrameTime = jsonentity["target frame time"].get<float>();
+                }
+                if(jsonentity.contains("min resolution scale") && jsonentity.at("min resolution scale").is_number()) {
+                    ecs::get<RenderTarget>(entity).minResolutionScale = jsonentity["min resolution scale"].get<float>();
+                }
                 ecs::get<Camera>(entity) = {};
 
                 if(jsonentity.contains("position")) {
@@ -328,5 +416,46 @@ game::Scene game::LevelParser::parseScene(std::filesystem::path const &filepath)
             scene.containedEntities.insert(entity);
         }
     }
+    buildStaticBVH(scene);
+    buildDynamicTree(scene);
     return scene;
 }
+
+void game::buildStaticBVH(Scene &scene)
+{
+    std::vector<AABB<glm::vec3>> bounds;
+    scene.staticInstances.clear();
+    for(ecs::Entity_t const &entity : scene.containedEntities) {
+        if(!ecs::entityHasComponent<model::Model>(entity) || ecs::entityHasComponent<Velocity>(entity) || ecs::entityHasComponent<Animation>(entity)) continue;
+        glm::mat4 modelMat = getModelMat(entity);
+        std::vector<model::Mesh> const &meshes = ecs::get<model::Model>(entity).getMeshes();
+        for(unsigned i = 0; i < meshes.size(); ++i) {
+            if(!meshes[i].drawable.has_value()) continue;
+            bounds.push_back(transformAABB(meshes[i].bounds, modelMat));
+            scene.staticInstances.push_back(StaticInstance{.entity = entity, .mesh = i});
+        }
+        if(!ecs::entityHasComponent<StaticGeometry>(entity)) ecs::addComponent<StaticGeometry>(entity);
+    }
+    scene.staticBVH.build(bounds);
+}
+void game::buildDynamicTree(Scene &scene)
+{
+    for(ecs::Entity_t const &entity : scene.containedEntities) {
+        if(!ecs::entityHasComponent<model::Model>(entity) || !(ecs::entityHasComponent<Velocity>(entity) || ecs::entityHasComponent<Animation>(entity))) continue;
+        if(ecs::entityHasComponent<DynamicGeometry>(entity)) continue;
+        AABB<glm::vec3> bounds = transformAABB(ecs::get<model::Model>(entity).getBounds(), getModelMat(entity));
+        ecs::addComponent(entity, DynamicGeometry{scene.dynamicTree.insert(bounds, entity)});
+    }
+}
+std::optional<ecs::Entity_t> game::raycastScene(Scene const &scene, Ray const &ray, float maxDistance)
+{
+    std::optional<ecs::Entity_t> result;
+    if(std::optional<RayHit> hit = scene.staticBVH.raycast(ray, maxDistance)) {
+        result = scene.staticInstances[hit->primitive].entity;
+        maxDistance = hit->distance;
+    }
+    if(std::optional<RayHit> hit = scene.dynamicTree.raycast(ray, maxDistance)) {
+        result = scene.dynamicTree.getUserData(hit->primitive);
+    }
+    return result;
+}
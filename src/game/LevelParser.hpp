@@ -4,14 +4,35 @@
 #include "utils/ECS.hpp"
 #include "utils/Model.hpp"
 #include "utils/Text.hpp"
+#include "BVH.hpp"
+#include "DynamicAABBTree.hpp"
 
 namespace game
 {
+    struct StaticInstance
+    {
+        ecs::Entity_t entity;
+        unsigned mesh;
+    };
     struct Scene
     {
         std::set<ecs::Entity_t> containedEntities;
         std::filesystem::path filePath;
+        std::set<std::filesystem::path> models; // canonical paths of the prop model files, a change to one of them reloads the scene
+        BVH staticBVH; // world space mesh bounds of the entities that never move
+        std::vector<StaticInstance> staticInstances; // bvh primitive -> mesh
+        DynamicAABBTree dynamicTree; // models with velocity or animation, user data is the entity
+        std::vector<std::pair<ecs::Entity_t, ecs::Entity_t>> broadphasePairs; // moving entities with overlapping bounds, refreshed by MovementSystem
+        // world space triangles of the props marked as occluders, for the software occlusion rasterizer
+        std::vector<glm::vec3> occluderVertices;
+        std::vector<unsigned> occluderIndices;
     };
+    // builds the bvh over the models without velocity or animation and marks them with StaticGeometry. call again if any of them moves
+    void buildStaticBVH(Scene &scene);
+    // inserts the models with velocity or animation into the dynamic tree and gives them a DynamicGeometry component
+    void buildDynamicTree(Scene &scene);
+    // closest entity whose bounds the ray hits, static meshes are tested with tight bounds, moving entities with fat bounds
+    std::optional<ecs::Entity_t> raycastScene(Scene const &scene, Ray const &ray, float maxDistance = std::numeric_limits<float>::infinity());
     class LevelParser
     {
     private:
@@ -22,10 +43,17 @@ namespace game
         std::pair<ecs::Entity_t, std::set<ecs::Entity_t>> createModel(std::filesystem::path const &filepath, bool flipWindingOrder, bool flipTextures);
         text::Font &createFont(std::filesystem::path atlas, std::filesystem::path metadata);
         void addTexture(ecs::Entity_t const &modelEntity, std::filesystem::path const &path, std::string const &type, bool flipTextures);
+        void addOccluder(Scene &scene, std::filesystem::path const &path, glm::mat4 const &modelMat);
     public:
         LevelParser() = default;
         ~LevelParser();
         Scene parseScene(std::filesystem::path const &filepath);
+        // reloads the cached textures made from the file in place, the entities share them. the number of reloaded textures
+        unsigned reloadTexture(std::filesystem::path const &path);
+        // canonical path of the cached model the file belongs to: the model file itself, or one next to it with the same name (the .mtl of an .obj)
+        std::optional<std::filesystem::path> findModel(std::filesystem::path const &path) const;
+        // drops the cached model, so the next scene that uses it imports it again. its geometry is freed with the last entity holding a copy
+        void forgetModel(std::filesystem::path const &path);
         inline std::string const &getErrorString() const { return m_errorStr; }
         inline void clearError() { m_errorStr = ""; }
     };
@@ -0,0 +1,47 @@
+#include "LightBuffer.hpp"
+#include "opengl/StreamBuffer.hpp"
+#include "opengl/StateCache.hpp"
+#include "glad/gl.h"
+#include <algorithm>
+#include <cstring>
+
+void game::LightBuffer::update(void const *lights, size_t count, size_t stride)
+{
+    std::byte const *bytes = static_cast<std::byte const *>(lights);
+    if(m_buffer.getRenderID() == 0) {
+        m_buffer = opengl::SSBO{0}; // dummy argument
+    }
+    if(count > m_capacity || m_capacity == 0) {
+        m_capacity = std::max({count, m_capacity * 2, MIN_CAPACITY});
+        m_buffer.bind();
+        glBufferData(GL_SHADER_STORAGE_BUFFER, HEADER_SIZE + m_capacity * stride, nullptr, GL_DYNAMIC_DRAW);
+        opengl::getStateCache().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        m_uploaded.clear(); // the old contents are gone
+        m_count = 0;
+        unsigned header[4] = {static_cast<unsigned>(count), 0, 0, 0};
+        opengl::getStreamBuffer().upload(m_buffer.getRenderID(), 0, header, HEADER_SIZE);
+    } else if(count != m_count) {
+        unsigned header = static_cast<unsigned>(count);
+        opengl::getStreamBuffer().upload(m_buffer.getRenderID(), 0, &header, sizeof(header));
+    }
+
+    // first and one past the last light that differs from the uploaded ones
+    size_t uploadedCount = m_uploaded.size() / stride;
+    size_t first = 0;
+    while(first < count && first < uploadedCount && std::memcmp(bytes + first * stride, m_uploaded.data() + first * stride, stride) == 0) ++first;
+    size_t last = count;
+    if(count <= uploadedCount) {
+        while(last > first && std::memcmp(bytes + (last - 1) * stride, m_uploaded.data() + (last - 1) * stride, stride) == 0) --last;
+    }
+    if(last > first) {
+        opengl::getStreamBuffer().upload(m_buffer.getRenderID(), HEADER_SIZE + first * stride, bytes + first * stride, (last - first) * stride);
+    }
+
+    m_uploaded.assign(bytes, bytes + count * stride);
+    m_count = count;
+}
+
+void game::LightBuffer::bind(unsigned binding) const
+{
+    m_buffer.bindingPoint(binding);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "opengl/ShaderStorage.hpp"
+#include <vector>
+#include <cstddef>
+
+namespace game
+{
+    /**
+     * growable shader storage buffer of one light type: a uint count padded to 16 bytes, then the lights (std430).
+     * grows by doubling and otherwise only uploads the range of lights that changed since the last update
+     */
+    class LightBuffer
+    {
+    public:
+        static constexpr size_t HEADER_SIZE = 16;
+        static constexpr size_t MIN_CAPACITY = 16;
+    private:
+        opengl::SSBO m_buffer;
+        size_t m_capacity = 0; // in lights
+        size_t m_count = 0;
+        std::vector<std::byte> m_uploaded; // the lights currently in the buffer
+
+        void update(void const *lights, size_t count, size_t stride);
+    public:
+        template<typename Light>
+        inline void update(std::vector<Light> const &lights) { update(lights.data(), lights.size(), sizeof(Light)); }
+        void bind(unsigned binding) const;
+
+        inline bool empty() const { return m_buffer.getRenderID() == 0; } // nothing was uploaded yet
+        inline size_t getCount() const { return m_count; }
+        inline size_t getCapacity() const { return m_capacity; }
+    };
+} // namespace game
@@ -0,0 +1,114 @@
+#include "LightClusters.hpp"
+#include "opengl/StreamBuffer.hpp"
+#include "opengl/StateCache.hpp"
+#include "glad/gl.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstddef>
+
+namespace
+{
+    // view space point on the line of constant ndc xy at the given distance in front of the camera, works for both projections
+    glm::vec3 viewPointAtDepth(glm::mat4 const &invProjMat, glm::vec2 const &ndc, float depth)
+    {
+        glm::vec4 nearPoint = invProjMat * glm::vec4{ndc, -1, 1};
+        glm::vec4 farPoint = invProjMat * glm::vec4{ndc, 1, 1};
+        nearPoint /= nearPoint.w;
+        farPoint /= farPoint.w;
+        float t = (depth + nearPoint.z) / (nearPoint.z - farPoint.z);
+        return glm::mix(glm::vec3{nearPoint}, glm::vec3{farPoint}, t);
+    }
+    bool sphereIntersects(glm::vec3 const &center, float radius, AABB<glm::vec3> const &box)
+    {
+        glm::vec3 offset = center - glm::clamp(center, box.min, box.max);
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+} // namespace
+
+game::LightClusters::LightClusters() :
+    m_clusters{0}
+{
+    // the Cluster struct of shaders/include/lightTypes.glsl
+    opengl::ShaderProgram::expectBufferLayout({"clusters[0].pointCount", static_cast<int>(offsetof(Cluster, pointCount)), static_cast<int>(sizeof(Cluster))});
+    opengl::ShaderProgram::expectBufferLayout({"clusters[0].spotCount",  static_cast<int>(offsetof(Cluster, spotCount)),  static_cast<int>(sizeof(Cluster))});
+    opengl::ShaderProgram::expectBufferLayout({"clusters[0].lights[0]",  static_cast<int>(offsetof(Cluster, lights)),     static_cast<int>(sizeof(Cluster))});
+    if(GLAD_GL_VERSION_4_3) {
+        m_shader = std::make_unique<opengl::ShaderProgram>("shaders/lightClusters");
+    }
+    m_clusters.bind();
+    glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * sizeof(Cluster), nullptr, GL_DYNAMIC_DRAW);
+    opengl::getStateCache().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+AABB<glm::vec3> game::LightClusters::getClusterBounds(glm::uvec3 const &cell, glm::mat4 const &invProjMat) const
+{
+    glm::vec2 ndcMin = glm::vec2{cell.x, cell.y} / glm::vec2{GRID_X, GRID_Y} * 2.0f - 1.0f;
+    glm::vec2 ndcMax = glm::vec2{cell.x + 1, cell.y + 1} / glm::vec2{GRID_X, GRID_Y} * 2.0f - 1.0f;
+    float depthNear = m_znear * std::pow(m_zfar / m_znear, static_cast<float>(cell.z) / GRID_Z);
+    float depthFar = m_znear * std::pow(m_zfar / m_znear, static_cast<float>(cell.z + 1) / GRID_Z);
+
+    AABB<glm::vec3> bounds{glm::vec3{std::numeric_limits<float>::max()}, glm::vec3{std::numeric_limits<float>::lowest()}};
+    for(unsigned corner = 0; corner < 8; ++corner) {
+        glm::vec2 ndc{corner & 1 ? ndcMax.x : ndcMin.x, corner & 2 ? ndcMax.y : ndcMin.y};
+        bounds.growToInclude(viewPointAtDepth(invProjMat, ndc, corner & 4 ? depthFar : depthNear));
+    }
+    return bounds;
+}
+
+void game::LightClusters::buildOnCpu(glm::mat4 const &viewMat, glm::mat4 const &projMat, std::vector<glm::vec4> const &pointLights, std::vector<glm::vec4> const &spotLights)
+{
+    // the same assignment as the compute shader
+    glm::mat4 invProjMat = glm::inverse(projMat);
+    std::vector<glm::vec4> viewPointLights(pointLights.size());
+    std::vector<glm::vec4> viewSpotLights(spotLights.size());
+    std::transform(pointLights.begin(), pointLights.end(), viewPointLights.begin(), [&](glm::vec4 const &light){ return glm::vec4{glm::vec3{viewMat * glm::vec4{glm::vec3{light}, 1}}, light.w}; });
+    std::transform(spotLights.begin(), spotLights.end(), viewSpotLights.begin(), [&](glm::vec4 const &light){ return glm::vec4{glm::vec3{viewMat * glm::vec4{glm::vec3{light}, 1}}, light.w}; });
+
+    m_cpuClusters.resize(CLUSTER_COUNT);
+    for(unsigned index = 0; index < CLUSTER_COUNT; ++index) {
+        glm::uvec3 cell{index % GRID_X, index / GRID_X % GRID_Y, index / (GRID_X * GRID_Y)};
+        AABB<glm::vec3> bounds = getClusterBounds(cell, invProjMat);
+        Cluster &cluster = m_cpuClusters[index];
+        cluster.pointCount = 0;
+        cluster.spotCount = 0;
+        for(unsigned i = 0; i < viewPointLights.size() && cluster.pointCount < MAX_LIGHTS_PER_CLUSTER; ++i) {
+            if(sphereIntersects(glm::vec3{viewPointLights[i]}, viewPointLights[i].w, bounds)) cluster.lights[cluster.pointCount++] = i;
+        }
+        for(unsigned i = 0; i < viewSpotLights.size() && cluster.pointCount + cluster.spotCount < MAX_LIGHTS_PER_CLUSTER; ++i) {
+            if(sphereIntersects(glm::vec3{viewSpotLights[i]}, viewSpotLights[i].w, bounds)) cluster.lights[cluster.pointCount + cluster.spotCount++] = i;
+        }
+    }
+    opengl::getStreamBuffer().upload(m_clusters.getRenderID(), 0, m_cpuClusters.data(), m_cpuClusters.size() * sizeof(Cluster));
+}
+
+void game::LightClusters::build(glm::mat4 const &viewMat, glm::mat4 const &projMat, float znear, float zfar,
+    std::vector<glm::vec4> const &pointLights, std::vector<glm::vec4> const &spotLights, bool useLightBuffers)
+{
+    m_znear = std::max(znear, 1e-3f); // the slices are exponential
+    m_zfar = std::max(zfar, m_znear * 2);
+
+    if(!usesComputeShader() || !useLightBuffers) {
+        buildOnCpu(viewMat, projMat, useLightBuffers ? pointLights : std::vector<glm::vec4>{}, useLightBuffers ? spotLights : std::vector<glm::vec4>{});
+        return;
+    }
+    glm::mat4 invProjMat = glm::inverse(projMat);
+    m_shader->bind();
+    glUniformMatrix4fv(m_shader->getUniform("u_viewMat"), 1, GL_FALSE, &viewMat[0][0]);
+    glUniformMatrix4fv(m_shader->getUniform("u_invProjectionMat"), 1, GL_FALSE, &invProjMat[0][0]);
+    glUniform1f(m_shader->getUniform("u_znear"), m_znear);
+    glUniform1f(m_shader->getUniform("u_zfar"), m_zfar);
+    m_clusters.bindingPoint(BINDING);
+    glDispatchCompute((CLUSTER_COUNT + 63) / 64, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    opengl::getStateCache().useProgram(0);
+}
+
+void game::LightClusters::bind(opengl::ShaderProgram const &shader, int screenWidth, int screenHeight) const
+{
+    float logDepthRange = std::log(m_zfar / m_znear);
+    m_clusters.bindingPoint(BINDING);
+    glUniform2f(shader.getUniform("u_screenSize"), static_cast<float>(screenWidth), static_cast<float>(screenHeight));
+    glUniform1f(shader.getUniform("u_clusterScale"), GRID_Z / logDepthRange);
+    glUniform1f(shader.getUniform("u_clusterBias"), -static_cast<float>(GRID_Z) * std::log(m_znear) / logDepthRange);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "opengl/ShaderStorage.hpp"
+#include "opengl/Shader.hpp"
+#include "AABB.hpp"
+#include <array>
+#include <vector>
+#include <memory>
+
+namespace game
+{
+    /**
+     * light index lists of the view frustum split into GRID_X * GRID_Y screen tiles and GRID_Z exponential depth slices.
+     * the prop / oit fragment shaders only shade the point and spot lights of the cluster they fall into.
+     * built by the lightClusters compute shader straight from the light buffers, or on the cpu if compute shaders are missing
+     */
+    class LightClusters
+    {
+    public:
+        static constexpr unsigned GRID_X = 16;
+        static constexpr unsigned GRID_Y = 9;
+        static constexpr unsigned GRID_Z = 24;
+        static constexpr unsigned CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+        static constexpr unsigned MAX_LIGHTS_PER_CLUSTER = 62; // the cluster is 256 bytes with both counters
+        static constexpr unsigned BINDING = 1; // shader storage binding point, the light buffers follow
+
+        struct Cluster // std430
+        {
+            unsigned pointCount;
+            unsigned spotCount;
+            std::array<unsigned, MAX_LIGHTS_PER_CLUSTER> lights; // point light indices, then spot light indices
+        };
+    private:
+        opengl::SSBO m_clusters;
+        std::unique_ptr<opengl::ShaderProgram> m_shader; // null without compute shader support
+        std::vector<Cluster> m_cpuClusters;
+        float m_znear = 0;
+        float m_zfar = 0;
+
+        AABB<glm::vec3> getClusterBounds(glm::uvec3 const &cell, glm::mat4 const &invProjMat) const;
+        void buildOnCpu(glm::mat4 const &viewMat, glm::mat4 const &projMat, std::vector<glm::vec4> const &pointLights, std::vector<glm::vec4> const &spotLights);
+    public:
+        LightClusters();
+        LightClusters(LightClusters const &) = delete;
+        LightClusters &operator=(LightClusters const &) = delete;
+
+        /*
+         * pointLights / spotLights -- world space position and radius of the lights in the light buffers, in the same order.
+         * only read by the cpu path; the compute shader reads the buffers, which have to be bound if useLightBuffers is set
+         */
+        void build(glm::mat4 const &viewMat, glm::mat4 const &projMat, float znear, float zfar,
+            std::vector<glm::vec4> const &pointLights, std::vector<glm::vec4> const &spotLights, bool useLightBuffers);
+        // binds the clusters and sets the uniforms the fragment shader needs to find its cluster
+        void bind(opengl::ShaderProgram const &shader, int screenWidth, int screenHeight) const;
+
+        // the cpu path builds the clusters while the compute shader compiles
+        inline void pollShader() { if(m_shader) m_shader->poll(); }
+        // false if the compute shader does not depend on the file or failed to collect
+        inline bool reloadShader(std::filesystem::path const &file) { return m_shader && m_shader->dependsOn(file) && m_shader->reload(); }
+        inline bool usesComputeShader() const { return m_shader && m_shader->isReady(); }
+        inline std::vector<Cluster> const &getCpuClusters() const { return m_cpuClusters; }
+    };
+} // namespace game
@@ -0,0 +1,294 @@
+#include "OcclusionRasterizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define OCCLUSION_USE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define OCCLUSION_TARGET_AVX2
+#else
+#define OCCLUSION_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    // screen space triangle, ready for rows [minY, maxY]
+    struct TriangleSetup
+    {
+        int minX, maxX, minY, maxY;
+        float edge[3];  // edge functions at the center of pixel (minX, minY)
+        float edgeDX[3];
+        float edgeDY[3];
+        float depth;    // depth at the center of pixel (minX, minY)
+        float depthDX;
+        float depthDY;
+    };
+
+    void rasterizeScalar(TriangleSetup const &triangle, float *depthBuffer, int width)
+    {
+        for(int y = triangle.minY; y <= triangle.maxY; ++y) {
+            float const row = static_cast<float>(y - triangle.minY);
+            float *depthRow = depthBuffer + static_cast<size_t>(y) * width;
+            for(int x = triangle.minX; x <= triangle.maxX; ++x) {
+                float const column = static_cast<float>(x - triangle.minX);
+                bool covered = true;
+                for(int i = 0; i < 3; ++i) {
+                    covered = covered && (triangle.edge[i] + triangle.edgeDY[i] * row) + triangle.edgeDX[i] * column >= 0;
+                }
+                if(!covered) continue;
+                float depth = std::clamp((triangle.depth + triangle.depthDY * row) + triangle.depthDX * column, 0.0f, 1.0f);
+                depthRow[x] = std::min(depthRow[x], depth);
+            }
+        }
+    }
+
+#ifdef OCCLUSION_USE_SIMD
+    // lanes left of minX are evaluated too, they are outside the triangle (or inside its bounding box but not covered) like any other pixel
+    void rasterizeSSE(TriangleSetup const &triangle, float *depthBuffer, int width)
+    {
+        int const startX = triangle.minX & ~3;
+        __m128 const lanes = _mm_setr_ps(0, 1, 2, 3);
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const one = _mm_set1_ps(1);
+        for(int y = triangle.minY; y <= triangle.maxY; ++y) {
+            float const row = static_cast<float>(y - triangle.minY);
+            float *depthRow = depthBuffer + static_cast<size_t>(y) * width;
+            __m128 edgeRow[3];
+            __m128 edgeDX[3];
+            for(int i = 0; i < 3; ++i) {
+                edgeRow[i] = _mm_set1_ps(triangle.edge[i] + triangle.edgeDY[i] * row);
+                edgeDX[i] = _mm_set1_ps(triangle.edgeDX[i]);
+            }
+            __m128 const depthRowStart = _mm_set1_ps(triangle.depth + triangle.depthDY * row);
+            __m128 const depthDX = _mm_set1_ps(triangle.depthDX);
+            for(int x = startX; x <= triangle.maxX; x += 4) {
+                __m128 column = _mm_add_ps(_mm_set1_ps(static_cast<float>(x - triangle.minX)), lanes);
+                __m128 mask = _mm_cmpge_ps(_mm_add_ps(edgeRow[0], _mm_mul_ps(edgeDX[0], column)), zero);
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(edgeRow[1], _mm_mul_ps(edgeDX[1], column)), zero));
+                mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(edgeRow[2], _mm_mul_ps(edgeDX[2], column)), zero));
+                if(_mm_movemask_ps(mask) == 0) continue;
+                __m128 depth = _mm_min_ps(_mm_max_ps(_mm_add_ps(depthRowStart, _mm_mul_ps(depthDX, column)), zero), one);
+                __m128 old = _mm_loadu_ps(depthRow + x);
+                __m128 result = _mm_or_ps(_mm_and_ps(mask, _mm_min_ps(old, depth)), _mm_andnot_ps(mask, old));
+                _mm_storeu_ps(depthRow + x, result);
+            }
+        }
+    }
+    OCCLUSION_TARGET_AVX2 void rasterizeAVX2(TriangleSetup const &triangle, float *depthBuffer, int width)
+    {
+        int const startX = triangle.minX & ~7;
+        __m256 const lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 const zero = _mm256_setzero_ps();
+        __m256 const one = _mm256_set1_ps(1);
+        for(int y = triangle.minY; y <= triangle.maxY; ++y) {
+            float const row = static_cast<float>(y - triangle.minY);
+            float *depthRow = depthBuffer + static_cast<size_t>(y) * width;
+            __m256 edgeRow[3];
+            __m256 edgeDX[3];
+            for(int i = 0; i < 3; ++i) {
+                edgeRow[i] = _mm256_set1_ps(triangle.edge[i] + triangle.edgeDY[i] * row);
+                edgeDX[i] = _mm256_set1_ps(triangle.edgeDX[i]);
+            }
+            __m256 const depthRowStart = _mm256_set1_ps(triangle.depth + triangle.depthDY * row);
+            __m256 const depthDX = _mm256_set1_ps(triangle.depthDX);
+            for(int x = startX; x <= triangle.maxX; x += 8) {
+                __m256 column = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x - triangle.minX)), lanes);
+                __m256 mask = _mm256_cmp_ps(_mm256_add_ps(edgeRow[0], _mm256_mul_ps(edgeDX[0], column)), zero, _CMP_GE_OQ);
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(edgeRow[1], _mm256_mul_ps(edgeDX[1], column)), zero, _CMP_GE_OQ));
+                mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(edgeRow[2], _mm256_mul_ps(edgeDX[2], column)), zero, _CMP_GE_OQ));
+                if(_mm256_movemask_ps(mask) == 0) continue;
+                __m256 depth = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(depthRowStart, _mm256_mul_ps(depthDX, column)), zero), one);
+                __m256 old = _mm256_loadu_ps(depthRow + x);
+                _mm256_storeu_ps(depthRow + x, _mm256_blendv_ps(old, _mm256_min_ps(old, depth), mask));
+            }
+        }
+    }
+#endif
+
+    // clips the triangle against the near plane (z >= -w), the result is a convex polygon of 0, 3 or 4 vertices
+    unsigned clipNear(glm::vec4 const (&triangle)[3], glm::vec4 (&polygon)[4])
+    {
+        unsigned count = 0;
+        for(unsigned i = 0; i < 3; ++i) {
+            glm::vec4 const &current = triangle[i];
+            glm::vec4 const &next = triangle[(i + 1) % 3];
+            float currentDistance = current.z + current.w;
+            float nextDistance = next.z + next.w;
+            if(currentDistance >= 0) polygon[count++] = current;
+            if((currentDistance >= 0) != (nextDistance >= 0)) {
+                polygon[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+            }
+        }
+        return count;
+    }
+} // namespace
+
+game::OcclusionRasterizer::Isa game::OcclusionRasterizer::getSupportedIsa()
+{
+#ifdef OCCLUSION_USE_SIMD
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0 ? Isa::AVX2 : Isa::SSE;
+#else
+    return __builtin_cpu_supports("avx2") ? Isa::AVX2 : Isa::SSE;
+#endif
+#else
+    return Isa::SCALAR;
+#endif
+}
+
+game::OcclusionRasterizer::OcclusionRasterizer(int width, int height, unsigned threadCount) :
+    m_width((std::max(width, 8) + 7) & ~7), m_height(std::max(height, 1)), m_isa(getSupportedIsa())
+{
+    m_depth.resize(static_cast<size_t>(m_width) * m_height, 1.0f);
+    if(threadCount == 0) {
+        threadCount = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+    }
+    threadCount = std::min<unsigned>(threadCount, m_height);
+    for(unsigned i = 0; i < threadCount; ++i) {
+        m_workers.emplace_back(&OcclusionRasterizer::workerLoop, this, i);
+    }
+}
+game::OcclusionRasterizer::~OcclusionRasterizer()
+{
+    {
+        std::unique_lock lock{m_mutex};
+        m_done.wait(lock, [this]() { return m_pendingBands == 0; });
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for(std::thread &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void game::OcclusionRasterizer::setOccluders(std::vector<glm::vec3> vertices, std::vector<unsigned> indices)
+{
+    assert(!m_running);
+    m_vertices = std::move(vertices);
+    m_indices = std::move(indices);
+    m_indices.resize(m_indices.size() / 3 * 3);
+}
+void game::OcclusionRasterizer::setIsa(Isa isa)
+{
+    m_isa = std::min(isa, getSupportedIsa());
+}
+
+void game::OcclusionRasterizer::begin(glm::mat4 const &viewProjection)
+{
+    std::unique_lock lock{m_mutex};
+    assert(!m_running);
+    m_viewProjection = viewProjection;
+    m_pendingBands = static_cast<unsigned>(m_workers.size());
+    m_running = true;
+    ++m_generation;
+    lock.unlock();
+    m_wake.notify_all();
+}
+game::DepthPyramid const &game::OcclusionRasterizer::finish()
+{
+    {
+        std::unique_lock lock{m_mutex};
+        if(!m_running) return m_result;
+        m_done.wait(lock, [this]() { return m_pendingBands == 0; });
+        m_running = false;
+    }
+    m_result.assign(m_depth.data(), m_width, m_height, m_viewProjection);
+    return m_result;
+}
+
+void game::OcclusionRasterizer::workerLoop(unsigned band)
+{
+    unsigned generation = 0;
+    while(true) {
+        {
+            std::unique_lock lock{m_mutex};
+            m_wake.wait(lock, [&]() { return m_quit || m_generation != generation; });
+            if(m_quit) return;
+            generation = m_generation;
+        }
+        int const bandCount = static_cast<int>(m_workers.size());
+        rasterizeBand(m_height * static_cast<int>(band) / bandCount, m_height * (static_cast<int>(band) + 1) / bandCount);
+        {
+            std::lock_guard lock{m_mutex};
+            --m_pendingBands;
+        }
+        m_done.notify_all();
+    }
+}
+
+void game::OcclusionRasterizer::rasterizeBand(int rowBegin, int rowEnd)
+{
+    std::fill(m_depth.begin() + static_cast<size_t>(rowBegin) * m_width, m_depth.begin() + static_cast<size_t>(rowEnd) * m_width, 1.0f);
+    glm::vec2 const size{m_width, m_height};
+
+    for(size_t index = 0; index < m_indices.size(); index += 3) {
+        glm::vec4 clip[3];
+        for(unsigned i = 0; i < 3; ++i) {
+            clip[i] = m_viewProjection * glm::vec4{m_vertices[m_indices[index + i]], 1};
+        }
+        // trivially outside one of the side planes
+        bool outside = false;
+        for(int axis = 0; axis < 2 && !outside; ++axis) {
+            outside = (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) ||
+                      (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w);
+        }
+        if(outside) continue;
+
+        glm::vec4 polygon[4];
+        unsigned vertexCount = clipNear(clip, polygon);
+        glm::vec3 screen[4];
+        for(unsigned i = 0; i < vertexCount; ++i) {
+            glm::vec3 ndc = glm::vec3{polygon[i]} / std::max(polygon[i].w, 1e-6f);
+            screen[i] = glm::vec3{(glm::vec2{ndc} * 0.5f + 0.5f) * size, ndc.z * 0.5f + 0.5f};
+        }
+
+        for(unsigned fan = 1; fan + 1 < vertexCount; ++fan) {
+            glm::vec3 a = screen[0];
+            glm::vec3 b = screen[fan];
+            glm::vec3 c = screen[fan + 1];
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if(std::abs(area) < 1e-8f) continue;
+            if(area < 0) { // both windings are occluders, make it counter clockwise
+                std::swap(b, c);
+                area = -area;
+            }
+
+            TriangleSetup triangle;
+            triangle.minX = std::max(0, static_cast<int>(std::floor(std::min({a.x, b.x, c.x}))));
+            triangle.maxX = std::min(m_width - 1, static_cast<int>(std::ceil(std::max({a.x, b.x, c.x}))));
+            triangle.minY = std::max(rowBegin, static_cast<int>(std::floor(std::min({a.y, b.y, c.y}))));
+            triangle.maxY = std::min(rowEnd - 1, static_cast<int>(std::ceil(std::max({a.y, b.y, c.y}))));
+            if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+
+            // edge function of p -> q, positive on the inner side
+            glm::vec2 const start{triangle.minX + 0.5f, triangle.minY + 0.5f};
+            glm::vec3 const *edges[3][2] = {{&a, &b}, {&b, &c}, {&c, &a}};
+            for(int i = 0; i < 3; ++i) {
+                glm::vec3 const &p = *edges[i][0];
+                glm::vec3 const &q = *edges[i][1];
+                triangle.edgeDX[i] = -(q.y - p.y);
+                triangle.edgeDY[i] = q.x - p.x;
+                triangle.edge[i] = (q.x - p.x) * (start.y - p.y) - (q.y - p.y) * (start.x - p.x);
+            }
+            triangle.depthDX = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+            triangle.depthDY = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+            triangle.depth = a.z + triangle.depthDX * (start.x - a.x) + triangle.depthDY * (start.y - a.y);
+
+            switch(m_isa) {
+#ifdef OCCLUSION_USE_SIMD
+            case Isa::AVX2: rasterizeAVX2(triangle, m_depth.data(), m_width); break;
+            case Isa::SSE:  rasterizeSSE(triangle, m_depth.data(), m_width); break;
+#endif
+            default:        rasterizeScalar(triangle, m_depth.data(), m_width); break;
+            }
+        }
+    }
+}
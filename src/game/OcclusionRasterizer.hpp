@@ -0,0 +1,69 @@
+#pragma once
+#include "glm/glm.hpp"
+#include "DepthPyramid.hpp"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace game
+{
+    /**
+     * software rasterizer drawing occluder triangles into a small depth buffer on worker threads, no gpu involved.
+     * every worker owns a band of rows. pixels are processed 8 (avx2) or 4 (sse) at a time: the edge functions give
+     * a coverage mask and the interpolated depth is min-blended under it. the result is tested through DepthPyramid, like the hi-z buffer
+     */
+    class OcclusionRasterizer
+    {
+    public:
+        enum class Isa
+        {
+            SCALAR, SSE, AVX2
+        };
+        static constexpr int DEFAULT_WIDTH = 256;
+        static constexpr int DEFAULT_HEIGHT = 128;
+    private:
+        int m_width = 0; // multiple of 8, so simd rows never cross into the next one
+        int m_height = 0;
+        std::vector<float> m_depth;
+        std::vector<glm::vec3> m_vertices; // world space
+        std::vector<unsigned> m_indices;
+        glm::mat4 m_viewProjection{1.0f};
+        Isa m_isa = Isa::SCALAR;
+        DepthPyramid m_result;
+
+        std::vector<std::thread> m_workers;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        unsigned m_generation = 0;
+        unsigned m_pendingBands = 0;
+        bool m_running = false;
+        bool m_quit = false;
+
+        void workerLoop(unsigned band);
+        void rasterizeBand(int rowBegin, int rowEnd);
+    public:
+        // threadCount 0 -- chosen from the hardware concurrency
+        OcclusionRasterizer(int width = DEFAULT_WIDTH, int height = DEFAULT_HEIGHT, unsigned threadCount = 0);
+        OcclusionRasterizer(OcclusionRasterizer const &) = delete;
+        OcclusionRasterizer &operator=(OcclusionRasterizer const &) = delete;
+        ~OcclusionRasterizer();
+
+        // world space triangle list. must not be called between begin and finish
+        void setOccluders(std::vector<glm::vec3> vertices, std::vector<unsigned> indices);
+        // falls back to the best supported instruction set
+        void setIsa(Isa isa);
+        // starts rasterizing on the workers and returns immediately
+        void begin(glm::mat4 const &viewProjection);
+        // waits for the workers and returns the depth pyramid of the frame
+        DepthPyramid const &finish();
+
+        inline Isa getIsa() const { return m_isa; }
+        inline size_t getTriangleCount() const { return m_indices.size() / 3; }
+        inline int getWidth() const { return m_width; }
+        inline int getHeight() const { return m_height; }
+        inline std::vector<float> const &getDepth() const { return m_depth; }
+        static Isa getSupportedIsa();
+    };
+} // namespace game
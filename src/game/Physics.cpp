@@ -1,4 +1,38 @@
 #include "Physics.hpp"
+#include "Renderer.hpp"
+#include "LevelParser.hpp"
+
+namespace
+{
+    constexpr unsigned REBALANCE_NODES_PER_FRAME = 64;
+} // namespace
+
+void updateDynamicTree(game::Scene &scene, double deltatime)
+{
+    using namespace game;
+    for(ecs::Entity_t const &entity : scene.containedEntities) {
+        if(!ecs::entityHasComponent<DynamicGeometry>(entity)) continue;
+        AABB<glm::vec3> bounds = transformAABB(ecs::get<model::Model>(entity).getBounds(), getModelMat(entity));
+        glm::vec3 displacement = ecs::entityHasComponent<Velocity>(entity) ? ecs::get<Velocity>(entity).velocity * (float) deltatime : glm::vec3{0};
+        scene.dynamicTree.move(ecs::get<DynamicGeometry>(entity).proxy, bounds, displacement); // no-op while the bounds stay inside the fat bounds
+    }
+    scene.dynamicTree.rebalance(REBALANCE_NODES_PER_FRAME);
+
+    // broadphase: moving against moving and moving against static
+    scene.broadphasePairs.clear();
+    scene.dynamicTree.queryPairs([&scene](unsigned proxyA, unsigned proxyB) {
+        scene.broadphasePairs.emplace_back(scene.dynamicTree.getUserData(proxyA), scene.dynamicTree.getUserData(proxyB));
+    });
+    for(ecs::Entity_t const &entity : scene.containedEntities) {
+        if(!ecs::entityHasComponent<DynamicGeometry>(entity) || !ecs::entityHasComponent<Velocity>(entity)) continue;
+        std::set<ecs::Entity_t> touched; // one pair per static entity, not per mesh
+        scene.staticBVH.queryOverlap(scene.dynamicTree.getFatBounds(ecs::get<DynamicGeometry>(entity).proxy), [&](unsigned primitive) {
+            if(touched.insert(scene.staticInstances[primitive].entity).second) {
+                scene.broadphasePairs.emplace_back(entity, scene.staticInstances[primitive].entity);
+            }
+        });
+    }
+}
 
 void game::MovementSystem::update(std::set<ecs::Entity_t> const &entities, double deltatime)
 {
@@ -6,4 +40,8 @@ void game::MovementSystem::update(std::set<ecs::Entity_t> const &entities, doubl
         if(!(ecs::entityHasComponent<Position>(entity) && ecs::entityHasComponent<Velocity>(entity))) continue;
         ecs::get<Position>(entity).position += ecs::get<Velocity>(entity).velocity * (float) deltatime;
     }
-}
\ No newline at end of file
+    for(ecs::Entity_t const &entity : entities) {
+        if(!ecs::entityHasComponent<Scene>(entity)) continue;
+        updateDynamicTree(ecs::get<Scene>(entity), deltatime);
+    }
+}
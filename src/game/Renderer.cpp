@@ -4,6 +4,12 @@
 #include "Animator.hpp"
 #include "game/Physics.hpp"
 #include "utils/Model.hpp"
+#include "opengl/StateCache.hpp"
+#include "LevelParser.hpp"
+#include "utils/Profiler.hpp"
+#include <algorithm>
+#include <limits>
+#include <cstddef>
 
 glm::mat4 getProjMat(ecs::Entity_t const &entity) 
 {
@@ -48,7 +54,7 @@ glm::mat4 getViewMat(ecs::Entity_t const &entity)
         return glm::mat4{1.0f};
     }
 }
-glm::mat4 getModelMat(ecs::Entity_t const &entity) 
+glm::mat4 game::getModelMat(ecs::Entity_t const &entity) 
 {
     glm::mat4 modelMat{1.0f};
     if(ecs::entityHasComponent<game::ModelMatrix>(entity)) {
@@ -70,26 +76,6 @@ glm::mat4 getModelMat(ecs::Entity_t const &entity)
     }
     return modelMat;
 }
-void draw(game::Drawable const &drawable) {
-    drawable.va.bind();
-    if(drawable.ib.has_value()) {
-        drawable.ib.value().bind();
-        glDrawElements(drawable.mode, drawable.count, GL_UNSIGNED_INT, nullptr);
-    } else {
-        glDrawArrays(drawable.mode, 0, drawable.count);
-    }
-}
-void drawText(ecs::Entity_t const &textEntity, game::Camera const &camera) {
-    using namespace game;
-    assert(ecs::entityHasComponent<Text>(textEntity));
-    Text const &text = ecs::get<Text>(textEntity);
-    glm::mat4 matrix = text.matrix.value_or(glm::ortho<float>(
-        0, camera.width, 
-        0, camera.height,
-        -1, 1
-    ));
-    text.font->drawText(text.text, text.position * glm::vec2{camera.width, camera.height}, text.size * camera.height, text.fgColor, text.bgColor, matrix);
-}
 std::optional<std::vector<glm::mat4> const *> getBoneMatrices(ecs::Entity_t const &entity)
 {
     std::optional<std::vector<glm::mat4> const *> boneMatrices = {};
@@ -102,7 +88,9 @@ std::optional<std::vector<glm::mat4> const *> getBoneMatrices(ecs::Entity_t cons
 void setDefaultTexture(std::string const &type, std::set<std::string> const &boundTextureTypes, std::map<std::string, opengl::Texture> const &defaultTextures, size_t &textureCounter, opengl::ShaderProgram const &shader)
 {
     if(boundTextureTypes.find(type) == boundTextureTypes.end()) {
-        glUniform1i(shader.getUniform("u_material." + type), static_cast<int>(textureCounter));
+        int location = shader.getUniform("u_material." + type);
+        if(location == -1) return; // not sampled by this variant
+        glUniform1i(location, static_cast<int>(textureCounter));
         opengl::Texture const *texture = defaultTextures.find(type) != defaultTextures.end() ? 
             &defaultTextures.at(type) : 
             &defaultTextures.at("");
@@ -117,7 +105,9 @@ void setTextures(model::Mesh const &mesh, opengl::ShaderProgram const &shader, s
     size_t textureCount = 0;
     std::set<std::string> boundTextureTypes;
     for(auto const &texture : mesh.textures) {
-        glUniform1i(shader.getUniform("u_material." + texture.type), static_cast<int>(textureCount));
+        int location = shader.getUniform("u_material." + texture.type);
+        if(location == -1) continue; // not sampled by this variant
+        glUniform1i(location, static_cast<int>(textureCount));
         texture.bind(static_cast<unsigned>(textureCount));
         boundTextureTypes.insert(texture.type);
         ++textureCount;
@@ -129,246 +119,713 @@ void setTextures(model::Mesh const &mesh, opengl::ShaderProgram const &shader, s
     setDefaultTexture("AO",       boundTextureTypes, defaultTextures, textureCount, shader);
     setDefaultTexture("height",   boundTextureTypes, defaultTextures, textureCount, shader);
 }
-void game::Renderer::drawModel(ecs::Entity_t const &entity, opengl::ShaderProgram const &shader) const
+// the color alpha or semi transparency may drop fragments of the opaque pass, the textures aside
+bool needsAlphaTest(ecs::Entity_t const &entity)
+{
+    float const opaqueAlpha = opengl::Texture::OPAQUE_ALPHA / 255.0f;
+    return ecs::entityHasComponent<game::SemiTransparent>(entity) || (ecs::entityHasComponent<game::Color>(entity) && ecs::get<game::Color>(entity).color.a < opaqueAlpha);
+}
+// entities with equal keys share the model and all the material state set per mesh, so they can be drawn as instances of each other
+using BatchKey = std::tuple<aiScene const *, std::vector<unsigned>, unsigned, float, std::vector<glm::mat4> const *, bool>;
+BatchKey getBatchKey(ecs::Entity_t const &entity)
 {
-    assert(ecs::entityHasComponent<model::Model>(entity));
     model::Model const &model = ecs::get<model::Model>(entity);
-    glm::mat4 modelMat = getModelMat(entity);
-    std::optional<std::vector<glm::mat4> const *> boneMatrices = getBoneMatrices(entity);
-    
+    std::vector<unsigned> textures;
     for(auto const &mesh : model.getMeshes()) {
-        if(!mesh.drawable.has_value()) continue;
+        for(auto const &texture : mesh.textures) {
+            textures.push_back(texture.getRenderID());
+        }
+        textures.push_back(0); // mesh separator
+    }
+    return BatchKey{
+        model.getScene(),
+        textures,
+        ecs::entityHasComponent<game::RepeatTexture>(entity) ? ecs::get<game::RepeatTexture>(entity).num : 1,
+        ecs::entityHasComponent<game::MaterialProperties>(entity) ? ecs::get<game::MaterialProperties>(entity).shininess : 0,
+        getBoneMatrices(entity).value_or(nullptr), // animated entities own their bone matrices, so they never share a batch
+        needsAlphaTest(entity) // the batch shares a shader variant
+    };
+}
+bool isVisible(model::Mesh const &mesh, glm::mat4 const &modelMat, game::Frustum const &frustum, game::DepthPyramid const *occluders)
+{
+    if(!frustum.intersects(game::transformSphere(mesh.boundingSphere, modelMat))) return false;
+    AABB<glm::vec3> bounds = game::transformAABB(mesh.bounds, modelMat);
+    return frustum.intersects(bounds) && !(occluders && occluders->isOccluded(bounds));
+}
+opengl::InterleavedInstancingVertexBufferLayout const &getInstanceLayout()
+{
+    static opengl::InterleavedInstancingVertexBufferLayout const layout{
+        {4, GL_FLOAT, 1}, {4, GL_FLOAT, 1}, {4, GL_FLOAT, 1}, {4, GL_FLOAT, 1}, // model matrix
+        {4, GL_FLOAT, 1}, {4, GL_FLOAT, 1}, {4, GL_FLOAT, 1}, {4, GL_FLOAT, 1}, // normal matrix
+        {4, GL_FLOAT, 1} // color
+    };
+    return layout;
+}
+// distance at which color / (attenuation * distance^2) falls below LIGHT_CUTOFF
+// drops the per camera state of the cameras that are gone, e.g. recreated by a scene reload
+template <typename Map_t>
+void pruneCameras(Map_t &perCamera, std::set<ecs::Entity_t> const &entities)
+{
+    for(auto iter = perCamera.begin(); iter != perCamera.end();) {
+        if(entities.count(iter->first) && ecs::entityHasComponent<game::Camera>(iter->first) && ecs::entityHasComponent<game::RenderTarget>(iter->first)) {
+            ++iter;
+            continue;
+        }
+        iter = perCamera.erase(iter);
+    }
+}
+float getLightRadius(glm::vec3 const &color, float attenuation)
+{
+    float intensity = std::max({color.r, color.g, color.b});
+    if(attenuation <= 0) return std::numeric_limits<float>::max();
+    return std::sqrt(std::max(intensity, 0.0f) / (attenuation * game::LIGHT_CUTOFF));
+}
+void game::Renderer::cullStaticGeometry(std::set<ecs::Entity_t> const &entities, game::Frustum const &frustum)
+{
+    m_staticVisibility.clear();
+    for(ecs::Entity_t const &entity : entities) {
+        if(!ecs::entityHasComponent<Scene>(entity)) continue;
+        Scene const &scene = ecs::get<Scene>(entity);
+        scene.staticBVH.queryFrustum(frustum, [&](unsigned primitive) {
+            if(isOccluded(scene.staticBVH.getPrimitiveBounds(primitive))) return;
+            StaticInstance const &instance = scene.staticInstances[primitive];
+            std::vector<bool> &meshes = m_staticVisibility[instance.entity];
+            if(meshes.empty()) meshes.resize(ecs::get<model::Model>(instance.entity).getMeshes().size());
+            meshes[instance.mesh] = true;
+        });
+    }
+}
+void game::Renderer::cullDynamicGeometry(std::set<ecs::Entity_t> const &entities, game::Frustum const &frustum)
+{
+    m_dynamicVisibility.clear();
+    for(ecs::Entity_t const &entity : entities) {
+        if(!ecs::entityHasComponent<Scene>(entity)) continue;
+        Scene const &scene = ecs::get<Scene>(entity);
+        scene.dynamicTree.queryFrustum(frustum, [&](unsigned proxy) {
+            if(isOccluded(scene.dynamicTree.getFatBounds(proxy))) return;
+            m_dynamicVisibility.insert(scene.dynamicTree.getUserData(proxy));
+        });
+    }
+}
+void game::Renderer::beginSoftwareOcclusion(std::set<ecs::Entity_t> const &entities, glm::mat4 const &viewProjection)
+{
+    if(!m_occlusionRasterizer) {
+        m_occlusionRasterizer = std::make_unique<OcclusionRasterizer>();
+    }
+    // occluders are static, only gather them again when scenes come or go
+    size_t triangleCount = 0;
+    for(ecs::Entity_t const &entity : entities) {
+        if(ecs::entityHasComponent<Scene>(entity)) triangleCount += ecs::get<Scene>(entity).occluderIndices.size() / 3;
+    }
+    if(triangleCount != m_occluderTriangleCount) {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned> indices;
+        for(ecs::Entity_t const &entity : entities) {
+            if(!ecs::entityHasComponent<Scene>(entity)) continue;
+            Scene const &scene = ecs::get<Scene>(entity);
+            unsigned base = static_cast<unsigned>(vertices.size());
+            vertices.insert(vertices.end(), scene.occluderVertices.begin(), scene.occluderVertices.end());
+            for(unsigned index : scene.occluderIndices) indices.push_back(base + index);
+        }
+        m_occlusionRasterizer->setOccluders(std::move(vertices), std::move(indices));
+        m_occluderTriangleCount = triangleCount;
+    }
+    m_occlusionRasterizer->begin(viewProjection);
+}
+void game::Renderer::collectBatches(std::set<ecs::Entity_t> const &entities, bool transparent, game::Frustum const &frustum, std::vector<InstanceBatch> &batches)
+{
+    std::map<BatchKey, std::vector<std::pair<ecs::Entity_t, glm::mat4>>> groups;
+    for(ecs::Entity_t const &entity : entities) {
+        if(!ecs::entityHasComponent<model::Model>(entity)) continue;
+        bool isTransparent = ecs::entityHasComponent<Transparent>(entity);
+        bool isSemiTransparent = ecs::entityHasComponent<SemiTransparent>(entity);
+        if(transparent ? !(isTransparent || isSemiTransparent) : (isTransparent && !isSemiTransparent)) continue;
+
+        glm::mat4 modelMat = getModelMat(entity);
+        if(ecs::entityHasComponent<StaticGeometry>(entity)) {
+            if(m_staticVisibility.find(entity) == m_staticVisibility.end()) continue;
+        } else if(!getBoneMatrices(entity).has_value()) { // skinned vertices may leave the bind pose bounds
+            if(ecs::entityHasComponent<DynamicGeometry>(entity)) {
+                if(m_dynamicVisibility.find(entity) == m_dynamicVisibility.end()) continue;
+            } else {
+                AABB<glm::vec3> bounds = game::transformAABB(ecs::get<model::Model>(entity).getBounds(), modelMat);
+                if(!frustum.intersects(bounds) || isOccluded(bounds)) continue;
+            }
+        }
 
-        game::Drawable const &drawable = mesh.drawable.value();
-        
-        setTextures(mesh, shader, m_defaultTextures);
+        groups[getBatchKey(entity)].emplace_back(entity, modelMat);
+    }
 
-        if(m_lightsUBO.has_value()) {
-            int location = shader.getUniformBlock("u_lights");
-            if(location >= 0) {
-                m_lightsUBO.value()->bind();
-                glUniformBlockBinding(shader.getRenderID(), location, 0);
+    for(auto const &[key, groupEntities] : groups) {
+        batches.push_back(InstanceBatch{
+            .entity = groupEntities.front().first,
+            .firstInstance = static_cast<unsigned>(m_instanceData.size()),
+            .instanceCount = static_cast<unsigned>(groupEntities.size())
+        });
+        for(auto const &[entity, modelMat] : groupEntities) {
+            m_instanceEntities.push_back(entity);
+            m_instanceData.push_back(InstanceData{
+                .modelMat = modelMat,
+                .normalMat = glm::transpose(glm::inverse(modelMat)),
+                .color = ecs::entityHasComponent<Color>(entity) ? ecs::get<Color>(entity).color : glm::vec4{1}
+            });
+        }
+    }
+}
+// draws with equal keys bind the same shader variant, textures and uniforms. the variant comes first, so each is bound once
+using DrawGroupKey = std::tuple<opengl::ShaderVariants::Features, std::vector<unsigned>, GLenum, unsigned, float, std::vector<glm::mat4> const *>;
+DrawGroupKey getDrawGroupKey(ecs::Entity_t const &entity, model::Mesh const &mesh, opengl::ShaderVariants::Features features)
+{
+    std::vector<unsigned> textures;
+    for(auto const &texture : mesh.textures) {
+        textures.push_back(texture.getRenderID());
+    }
+    return DrawGroupKey{
+        features,
+        textures,
+        mesh.drawable.value().mode,
+        ecs::entityHasComponent<game::RepeatTexture>(entity) ? ecs::get<game::RepeatTexture>(entity).num : 1,
+        ecs::entityHasComponent<game::MaterialProperties>(entity) ? ecs::get<game::MaterialProperties>(entity).shininess : 0,
+        getBoneMatrices(entity).value_or(nullptr)
+    };
+}
+opengl::ShaderVariants::Features game::Renderer::getMaterialFeatures(ecs::Entity_t entity, model::Mesh const &mesh) const
+{
+    opengl::ShaderVariants::Features features = 0;
+    if(getBoneMatrices(entity).has_value()) features |= SKINNED;
+    bool diffuseAlphaTested = m_defaultTextures.at("diffuse").alphaTested;
+    for(opengl::Texture const &texture : mesh.textures) {
+        if(texture.type == "normal") features |= HAS_NORMAL_MAP;
+        else if(texture.type == "rough") features |= HAS_ROUGH_MAP;
+        else if(texture.type == "diffuse") diffuseAlphaTested = texture.alphaTested;
+    }
+    if(diffuseAlphaTested || needsAlphaTest(entity)) features |= ALPHA_TEST;
+    return features;
+}
+void game::Renderer::buildDrawGroups(std::vector<InstanceBatch> const &batches, game::Frustum const &frustum, std::vector<DrawGroup> &groups)
+{
+    std::map<DrawGroupKey, std::pair<DrawGroup, std::vector<opengl::DrawElementsIndirectCommand>>> sortedGroups;
+    for(InstanceBatch const &batch : batches) {
+        model::Model const &model = ecs::get<model::Model>(batch.entity);
+        // whole models are culled while batching, single mesh models need no second test
+        bool cullMeshes = model.getMeshes().size() > 1 && !getBoneMatrices(batch.entity).has_value();
+        for(unsigned meshIndex = 0; meshIndex < model.getMeshes().size(); ++meshIndex) {
+            model::Mesh const &mesh = model.getMeshes()[meshIndex];
+            if(!mesh.drawable.has_value()) continue;
+            game::Drawable const &drawable = mesh.drawable.value();
+
+            // one command per run of consecutive visible instances
+            std::vector<opengl::DrawElementsIndirectCommand> meshCommands;
+            unsigned runStart = 0;
+            unsigned runLength = 0;
+            for(unsigned i = 0; i <= batch.instanceCount; ++i) {
+                bool visible = false;
+                if(i < batch.instanceCount) {
+                    auto staticMeshes = m_staticVisibility.find(m_instanceEntities[batch.firstInstance + i]);
+                    visible = staticMeshes != m_staticVisibility.end() ? 
+                        staticMeshes->second[meshIndex] : 
+                        !cullMeshes || isVisible(mesh, m_instanceData[batch.firstInstance + i].modelMat, frustum, m_occluders);
+                }
+                if(visible) {
+                    if(runLength == 0) runStart = i;
+                    ++runLength;
+                } else if(runLength > 0) {
+                    meshCommands.push_back(opengl::DrawElementsIndirectCommand{
+                        .count = drawable.count,
+                        .instanceCount = runLength,
+                        .firstIndex = drawable.geometry->firstIndex,
+                        .baseVertex = static_cast<int>(drawable.geometry->baseVertex),
+                        .baseInstance = batch.firstInstance + runStart
+                    });
+                    runLength = 0;
+                }
             }
+            if(meshCommands.empty()) continue;
+
+            opengl::ShaderVariants::Features features = getMaterialFeatures(batch.entity, mesh);
+            auto &[group, commands] = sortedGroups[getDrawGroupKey(batch.entity, mesh, features)];
+            group.entity = batch.entity;
+            group.mesh = &mesh;
+            group.mode = drawable.mode;
+            group.features = features;
+            commands.insert(commands.end(), meshCommands.begin(), meshCommands.end());
         }
-        
-        ecs::entityHasComponent<game::Color>(entity) ?
-            glUniform4fv(shader.getUniform("u_color"), 1, &ecs::get<game::Color>(entity).color.r) :
-            glUniform4f( shader.getUniform("u_color"), 1, 1, 1, 1);
+    }
+
+    for(auto &[key, value] : sortedGroups) {
+        auto &[group, commands] = value;
+        group.firstCommand = static_cast<unsigned>(m_commands.size());
+        group.commandCount = static_cast<unsigned>(commands.size());
+        m_commands.insert(m_commands.end(), commands.begin(), commands.end());
+        groups.push_back(group);
+    }
+}
+void game::Renderer::drawGroups(std::vector<DrawGroup> const &groups, opengl::ShaderVariants &shaders, std::function<void(opengl::ShaderProgram const &)> const &bindVariant)
+{
+    model::getGeometryArena().getVertexArray().bind();
+    opengl::getStateCache().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandsAllocation.buffer);
+    std::unordered_map<ecs::Entity_t, opengl::StreamBuffer::Allocation> boneAllocations; // one upload per animated entity, shared by its meshes
+    opengl::ShaderProgram const *bound = nullptr;
+    for(DrawGroup const &group : groups) {
+        opengl::ShaderProgram const *variant = shaders.get(group.features);
+        if(!variant) continue; // compiling
+        opengl::ShaderProgram const &shader = *variant;
+        if(variant != bound) {
+            shader.bind();
+            bindVariant(shader);
+            bound = variant;
+        }
+        std::optional<std::vector<glm::mat4> const *> boneMatrices = getBoneMatrices(group.entity);
+
         if(boneMatrices.has_value()) {
-            glUniformMatrix4fv(shader.getUniform("u_boneMatrices"), static_cast<int>(boneMatrices.value()->size()), GL_FALSE, &(*boneMatrices.value()->data())[0][0]);
+            size_t size = boneMatrices.value()->size() * sizeof(glm::mat4);
+            auto allocation = boneAllocations.find(group.entity);
+            if(allocation == boneAllocations.end()) {
+                allocation = boneAllocations.emplace(group.entity, opengl::getStreamBuffer().push(boneMatrices.value()->data(), size, m_storageAlignment)).first;
+            }
+            opengl::getStateCache().bindBufferRange(GL_SHADER_STORAGE_BUFFER, BONES_BINDING, allocation->second.buffer, allocation->second.offset, size);
         }
-        if(ecs::entityHasComponent<game::RepeatTexture>(entity)) {
-            glUniform1ui(shader.getUniform("u_texCoordMult"), ecs::get<game::RepeatTexture>(entity).num);
+        if(ecs::entityHasComponent<game::RepeatTexture>(group.entity)) {
+            glUniform1ui(shader.getUniform("u_texCoordMult"), ecs::get<game::RepeatTexture>(group.entity).num);
         } else {
             glUniform1ui(shader.getUniform("u_texCoordMult"), 1);
         }
-        if(ecs::entityHasComponent<game::MaterialProperties>(entity)) {
-            game::MaterialProperties const &materialProperties = ecs::get<game::MaterialProperties>(entity);
+        if(ecs::entityHasComponent<game::MaterialProperties>(group.entity)) {
+            game::MaterialProperties const &materialProperties = ecs::get<game::MaterialProperties>(group.entity);
             glUniform1f(shader.getUniform("u_material.shininess"), materialProperties.shininess);
         }
-        glUniform1i(       shader.getUniform("u_animated"),       boneMatrices.has_value());
-        glUniformMatrix4fv(shader.getUniform("u_modelMat"),       1, GL_FALSE, &modelMat[0][0]);
-        glUniformMatrix4fv(shader.getUniform("u_normalMat"),      1, GL_FALSE, &glm::transpose(glm::inverse(modelMat))[0][0]);
-        draw(drawable);
+        setTextures(*group.mesh, shader, m_defaultTextures);
+
+        glMultiDrawElementsIndirect(group.mode, GL_UNSIGNED_INT, reinterpret_cast<void const *>(m_commandsAllocation.offset + group.firstCommand * sizeof(opengl::DrawElementsIndirectCommand)), static_cast<int>(group.commandCount), 0);
+    }
+    opengl::getStateCache().bindVertexArray(0);
+}
+bool game::Renderer::canDepthPrepass(DrawGroup const &group) const
+{
+    return !(group.features & (SKINNED | ALPHA_TEST));
+}
+
+void game::Renderer::drawDepthPrepass(std::vector<DrawGroup> const &groups, game::Camera const &camera)
+{
+    opengl::getStateCache().colorMask(false, false, false, false);
+    m_depthShader.bind();
+    glUniformMatrix4fv(m_depthShader.getUniform("u_viewMat"),       1, GL_FALSE, &camera.viewMat[0][0]);
+    glUniformMatrix4fv(m_depthShader.getUniform("u_projectionMat"), 1, GL_FALSE, &camera.projMat[0][0]);
+    model::getGeometryArena().getPositionArray().bind();
+    opengl::getStateCache().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandsAllocation.buffer);
+    // no per group state here, so neighbouring command ranges go out as one multi draw
+    for(size_t i = 0; i < groups.size();) {
+        unsigned commandCount = groups[i].commandCount;
+        size_t next = i + 1;
+        while(next < groups.size() && groups[next].mode == groups[i].mode && groups[next].firstCommand == groups[i].firstCommand + commandCount) {
+            commandCount += groups[next++].commandCount;
+        }
+        glMultiDrawElementsIndirect(groups[i].mode, GL_UNSIGNED_INT, reinterpret_cast<void const *>(m_commandsAllocation.offset + groups[i].firstCommand * sizeof(opengl::DrawElementsIndirectCommand)), static_cast<int>(commandCount), 0);
+        i = next;
     }
+    opengl::getStateCache().bindVertexArray(0);
+    opengl::getStateCache().colorMask(true, true, true, true);
 }
-void game::Renderer::renderMain(std::set<ecs::Entity_t> const &entities, double deltatime, game::Camera &camera, game::RenderTarget &rtarget)
+
+void game::Renderer::shadeGBuffer(game::Camera const &camera, glm::ivec2 const &renderSize, FrameGraph const &graph, FrameTextures const &textures, glm::vec3 const &cameraPosition)
 {
-    glViewport(0, 0, camera.width, camera.height);
+    opengl::ShaderProgram const &shader = *m_deferredLightingShader;
+    glm::mat4 invViewProjection = glm::inverse(camera.projMat * camera.viewMat);
+    shader.bind();
+    glUniformMatrix4fv(shader.getUniform("u_invViewProjectionMat"), 1, GL_FALSE, &invViewProjection[0][0]);
+    glUniformMatrix4fv(shader.getUniform("u_viewMat"),              1, GL_FALSE, &camera.viewMat[0][0]);
+    glUniform3fv(      shader.getUniform("u_camPos"), 1, &cameraPosition.x);
+    glUniform1i(shader.getUniform("u_albedo"), 0);
+    glUniform1i(shader.getUniform("u_normal"), 1);
+    glUniform1i(shader.getUniform("u_shininess"), 2);
+    glUniform1i(shader.getUniform("u_depth"), 3);
+    graph.getTexture(textures.albedo).bind(0);
+    graph.getTexture(textures.normal).bind(1);
+    graph.getTexture(textures.shininess).bind(2);
+    graph.getTexture(textures.depth).bind(3);
+    m_lightClusters.bind(shader, renderSize.x, renderSize.y);
+    glBindImageTexture(0, graph.getTexture(textures.color).getRenderID(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+    glDispatchCompute((renderSize.x + 7) / 8, (renderSize.y + 7) / 8, 1);
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT); // the oit composite blends over it
+    opengl::getStateCache().useProgram(0);
+    opengl::getStateCache().activeTexture(0);
+}
+
+void game::Renderer::renderMain(std::set<ecs::Entity_t> const &entities, double deltatime, ecs::Entity_t cameraEntity, game::Camera &camera, game::RenderTarget &rtarget)
+{
+    // the targets are allocated at the window size, a lower resolution only uses part of them
+    DynamicResolution &dynamicResolution = m_dynamicResolutions[cameraEntity];
+    dynamicResolution.update(rtarget.targetFrameTime, rtarget.minResolutionScale);
+    glm::ivec2 renderSize = dynamicResolution.getRenderSize(camera.width, camera.height);
+    if(rtarget.targetFrameTime > 0) dynamicResolution.getTimer().begin();
+    opengl::getStateCache().viewport(0, 0, renderSize.x, renderSize.y);
     
     glm::mat4 invViewMat = glm::inverse(camera.viewMat);
     glm::vec3 cameraPosition = glm::vec3{invViewMat * glm::vec4{0, 0, 0, 1}};
     // glm::vec3 cameraDirection = glm::vec3{invViewMat * glm::vec4{0, 0, -1,0}};
 
     {
-        auto lightsUBOEntity = std::find_if(entities.begin(), entities.end(), [](ecs::Entity_t const &entity){ return ecs::entityHasComponent<LightUBO>(entity); });
-        m_lightsUBO = lightsUBOEntity != entities.end() ? &ecs::get<LightUBO>(*lightsUBOEntity).ubo : std::optional<opengl::UniformBuffer *>{};
+        auto lightsEntity = std::find_if(entities.begin(), entities.end(), [](ecs::Entity_t const &entity){ return ecs::entityHasComponent<LightBuffers>(entity); });
+        m_lightBuffers = lightsEntity != entities.end() ? &ecs::get<LightBuffers>(*lightsEntity) : std::optional<LightBuffers *>{};
+
+        // assign the point and spot lights to the clusters of this camera
+        bool lightsUploaded = m_lightBuffers.has_value() && !m_lightBuffers.value()->pointLights.empty();
+        std::vector<glm::vec4> pointLights;
+        std::vector<glm::vec4> spotLights;
+        if(lightsUploaded && !m_lightClusters.usesComputeShader() && ecs::entityHasComponent<LightUpdater::LightStorage>(*lightsEntity)) {
+            LightUpdater::LightStorage const &storage = ecs::get<LightUpdater::LightStorage>(*lightsEntity);
+            for(auto const &light : storage.pointLights) pointLights.push_back(glm::vec4{light.position, light.radius});
+            for(auto const &light : storage.spotLights) spotLights.push_back(glm::vec4{light.position, light.radius});
+        }
+        if(lightsUploaded) {
+            m_lightBuffers.value()->pointLights.bind(LightBuffers::POINT_LIGHTS_BINDING);
+            m_lightBuffers.value()->dirLights.bind(LightBuffers::DIR_LIGHTS_BINDING);
+            m_lightBuffers.value()->spotLights.bind(LightBuffers::SPOT_LIGHTS_BINDING);
+        }
+        m_lightClusters.build(camera.viewMat, camera.projMat, camera.znear, camera.zfar, pointLights, spotLights, lightsUploaded);
+    }
+
+    // group entities into instance batches, build the indirect commands and upload the data of both passes at once
+    std::vector<InstanceBatch> opaqueBatches;
+    std::vector<InstanceBatch> transparentBatches;
+    std::vector<DrawGroup> opaqueGroups;
+    std::vector<DrawGroup> transparentGroups;
+    game::Frustum frustum{camera.projMat * camera.viewMat};
+    HiZBuffer &hiZ = m_hiZBuffers[cameraEntity];
+    m_occluders = nullptr;
+    if(rtarget.occlusionCulling == RenderTarget::OcclusionCulling::SOFTWARE) {
+        beginSoftwareOcclusion(entities, camera.projMat * camera.viewMat);
+        m_occluders = &m_occlusionRasterizer->finish();
+    } else if(rtarget.occlusionCulling == RenderTarget::OcclusionCulling::HI_Z) {
+        hiZ.poll();
+        m_occluders = !hiZ.getPyramid().empty() ? &hiZ.getPyramid() : nullptr;
+    }
+    m_instanceData.clear();
+    m_instanceEntities.clear();
+    m_commands.clear();
+    cullStaticGeometry(entities, frustum);
+    cullDynamicGeometry(entities, frustum);
+    collectBatches(entities, false, frustum, opaqueBatches);
+    collectBatches(entities, true, frustum, transparentBatches);
+    buildDrawGroups(opaqueBatches, frustum, opaqueGroups);
+    buildDrawGroups(transparentBatches, frustum, transparentGroups);
+    std::vector<DrawGroup> prepassGroups;
+    if(rtarget.depthPrepass && m_depthShader.isReady()) {
+        auto rest = std::stable_partition(opaqueGroups.begin(), opaqueGroups.end(), [&](DrawGroup const &group){ return canDepthPrepass(group); });
+        prepassGroups.assign(opaqueGroups.begin(), rest);
+        opaqueGroups.erase(opaqueGroups.begin(), rest);
+    }
+    {
+        opengl::StreamBuffer::Allocation instances = opengl::getStreamBuffer().push(m_instanceData.data(), m_instanceData.size() * sizeof(InstanceData));
+        model::getGeometryArena().getVertexArray().setBuffer(m_instanceAttribIndex, instances.buffer, getInstanceLayout(), instances.offset);
+        if(!prepassGroups.empty()) model::getGeometryArena().getPositionArray().setBuffer(m_instanceAttribIndex, instances.buffer, getInstanceLayout(), instances.offset);
+        opengl::getStateCache().bindVertexArray(0);
+        m_commandsAllocation = opengl::getStreamBuffer().push(m_commands.data(), m_commands.size() * sizeof(opengl::DrawElementsIndirectCommand));
+    }
+
+    // ===================
+    // FRAME GRAPH SETUP 
+    // ===================
+
+    // every texture below is transient, taken from the pool shared by all cameras.
+    // deferred -- the opaque objects only fill the g-buffer, they are lit after the hi-z build
+    bool deferred = rtarget.shading == RenderTarget::Shading::DEFERRED && m_deferredLightingShader && m_deferredLightingShader->isReady();
+    FrameGraph graph{m_texturePool};
+    FrameTextures textures{
+        .color = graph.createTexture("main color", camera.width, camera.height, GL_RGBA16F),
+        .depth = graph.createTexture("main depth", camera.width, camera.height, GL_DEPTH24_STENCIL8),
+        .oitAccum = graph.createTexture("oit accumulation", camera.width, camera.height, GL_RGBA16F),
+        .oitRevelage = graph.createTexture("oit revelage", camera.width, camera.height, GL_R8)
+    };
+    if(deferred) {
+        textures.albedo = graph.createTexture("g-buffer albedo", camera.width, camera.height, GL_RGBA8);
+        textures.normal = graph.createTexture("g-buffer normal", camera.width, camera.height, GL_RG16_SNORM);
+        textures.shininess = graph.createTexture("g-buffer shininess", camera.width, camera.height, GL_R8);
     }
+    std::vector<FrameGraph::Resource> opaqueOutputs{textures.color, textures.depth};
+    if(deferred) opaqueOutputs.insert(opaqueOutputs.end(), {textures.albedo, textures.normal, textures.shininess});
 
     // ===================
     // SOLID OBJECTS PASS 
     // ===================
 
-    // set up render states
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_BLEND);
-    glDepthMask(GL_TRUE);
-    glEnable(GL_CULL_FACE);
-    glDepthFunc(GL_LESS);
-
-    rtarget.mainFBO.bind();
-    glClearColor(rtarget.clearColor.r, rtarget.clearColor.g, rtarget.clearColor.b, rtarget.clearColor.a);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // draw opaque objects
-    m_propShader.bind();
-    glUniformMatrix4fv(m_propShader.getUniform("u_viewMat"),        1, GL_FALSE, &camera.viewMat[0][0]);
-    glUniformMatrix4fv(m_propShader.getUniform("u_projectionMat"),  1, GL_FALSE, &camera.projMat[0][0]);
-    glUniform3fv(      m_propShader.getUniform("u_camPos"), 1, &cameraPosition.x);
-    for(ecs::Entity_t const &entity : entities) {
-        if(ecs::entityHasComponent<model::Model>(entity) && (!ecs::entityHasComponent<Transparent>(entity) || ecs::entityHasComponent<SemiTransparent>(entity))) {
-            drawModel(entity, m_propShader);
+    graph.addPass("opaque", {}, opaqueOutputs, [&]() {
+        // set up render states
+        opengl::getStateCache().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        opengl::getStateCache().disable(GL_BLEND);
+        opengl::getStateCache().depthMask(true);
+        opengl::getStateCache().enable(GL_CULL_FACE);
+        opengl::getStateCache().depthFunc(GL_LESS);
+
+        opengl::ShaderVariants &opaqueShaders = deferred ? m_gBufferShaders : m_propShaders;
+        graph.getFramebuffer({{GL_COLOR_ATTACHMENT0, textures.color}, {GL_DEPTH_STENCIL_ATTACHMENT, textures.depth}}).bind();
+        glClearColor(rtarget.clearColor.r, rtarget.clearColor.g, rtarget.clearColor.b, rtarget.clearColor.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if(deferred) {
+            graph.getFramebuffer({
+                {GL_COLOR_ATTACHMENT0, textures.albedo}, {GL_COLOR_ATTACHMENT1, textures.normal}, {GL_COLOR_ATTACHMENT2, textures.shininess},
+                {GL_DEPTH_STENCIL_ATTACHMENT, textures.depth}
+            }).bind();
+            glClear(GL_COLOR_BUFFER_BIT);
         }
-    } // for(auto &entity : entities) 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glUseProgram(0);
 
-    // =====================
-    // OIT TRANSPARENT PASS 
-    // =====================
+        if(!prepassGroups.empty()) drawDepthPrepass(prepassGroups, camera);
+
+        // draw opaque objects
+        auto bindOpaqueVariant = [&](opengl::ShaderProgram const &shader) {
+            glUniformMatrix4fv(shader.getUniform("u_viewMat"),        1, GL_FALSE, &camera.viewMat[0][0]);
+            glUniformMatrix4fv(shader.getUniform("u_projectionMat"),  1, GL_FALSE, &camera.projMat[0][0]);
+            if(!deferred) {
+                glUniform3fv(shader.getUniform("u_camPos"), 1, &cameraPosition.x);
+                m_lightClusters.bind(shader, renderSize.x, renderSize.y);
+            }
+        };
+        if(!prepassGroups.empty()) {
+            // only the nearest surface passes, its depth is already there
+            opengl::getStateCache().depthFunc(GL_EQUAL);
+            opengl::getStateCache().depthMask(false);
+            drawGroups(prepassGroups, opaqueShaders, bindOpaqueVariant);
+            opengl::getStateCache().depthFunc(GL_LESS);
+            opengl::getStateCache().depthMask(true);
+        }
+        drawGroups(opaqueGroups, opaqueShaders, bindOpaqueVariant);
+        // no unbinding between the passes, each one binds what it needs and the state cache skips the rest
+    });
+
+    // ============
+    // HI-Z BUILD 
+    // ============
+
+    // the opaque depth occludes the next frames, transparent objects do not write depth
+    if(rtarget.occlusionCulling == RenderTarget::OcclusionCulling::HI_Z && m_hiZShader.isReady()) {
+        graph.addPass("hi-z build", {textures.depth}, {}, [&]() {
+            hiZ.build(m_hiZShader, graph.getTexture(textures.depth), renderSize.x, renderSize.y, camera.projMat * camera.viewMat);
+        });
+    }
 
-    // configure render states
-    glDisable(GL_CULL_FACE);
-    glDepthMask(GL_FALSE);
-    glEnable(GL_BLEND);
-    glBlendFunci(0, GL_ONE, GL_ONE); // accumulation
-    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR); // revelage
-    glBlendEquation(GL_FUNC_ADD);
+    // ==================
+    // DEFERRED LIGHTING 
+    // ==================
 
-    rtarget.oitFBO.bind();
-    {
-        constexpr glm::vec4 zeroFiller{0};
-        constexpr glm::vec4 oneFiller{1};
-        glClearBufferfv(GL_COLOR, 0, &zeroFiller.r);
-        glClearBufferfv(GL_COLOR, 1, &oneFiller.r);
+    if(deferred) {
+        graph.addPass("deferred lighting", {textures.albedo, textures.normal, textures.shininess, textures.depth}, {textures.color}, [&]() {
+            shadeGBuffer(camera, renderSize, graph, textures, cameraPosition);
+        });
     }
 
-    // draw transparent objects
-    m_oitShader.bind();
-    glUniformMatrix4fv(m_oitShader.getUniform("u_viewMat"),        1, GL_FALSE, &camera.viewMat[0][0]);
-    glUniformMatrix4fv(m_oitShader.getUniform("u_projectionMat"),  1, GL_FALSE, &camera.projMat[0][0]);
-    glUniform3fv(      m_oitShader.getUniform("u_camPos"), 1, &cameraPosition.x);
-    for(ecs::Entity_t const &entity : entities) {
-        if(ecs::entityHasComponent<model::Model>(entity) && (ecs::entityHasComponent<Transparent>(entity) || ecs::entityHasComponent<SemiTransparent>(entity))) {
-            drawModel(entity, m_oitShader);
+    // =====================
+    // OIT TRANSPARENT PASS 
+    // =====================
+
+    graph.addPass("oit transparent", {textures.depth}, {textures.oitAccum, textures.oitRevelage}, [&]() {
+        // configure render states
+        opengl::getStateCache().disable(GL_CULL_FACE);
+        opengl::getStateCache().depthMask(false);
+        opengl::getStateCache().enable(GL_BLEND);
+        opengl::getStateCache().blendFunci(0, GL_ONE, GL_ONE); // accumulation
+        opengl::getStateCache().blendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR); // revelage
+        opengl::getStateCache().blendEquation(GL_FUNC_ADD);
+
+        graph.getFramebuffer({{GL_COLOR_ATTACHMENT0, textures.oitAccum}, {GL_COLOR_ATTACHMENT1, textures.oitRevelage}, {GL_DEPTH_STENCIL_ATTACHMENT, textures.depth}}).bind();
+        {
+            constexpr glm::vec4 zeroFiller{0};
+            constexpr glm::vec4 oneFiller{1};
+            glClearBufferfv(GL_COLOR, 0, &zeroFiller.r);
+            glClearBufferfv(GL_COLOR, 1, &oneFiller.r);
         }
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glUseProgram(0);
+
+        // draw transparent objects
+        drawGroups(transparentGroups, m_oitShaders, [&](opengl::ShaderProgram const &shader) {
+            glUniformMatrix4fv(shader.getUniform("u_viewMat"),        1, GL_FALSE, &camera.viewMat[0][0]);
+            glUniformMatrix4fv(shader.getUniform("u_projectionMat"),  1, GL_FALSE, &camera.projMat[0][0]);
+            glUniform3fv(      shader.getUniform("u_camPos"), 1, &cameraPosition.x);
+            m_lightClusters.bind(shader, renderSize.x, renderSize.y);
+        });
+    });
 
     // ===================
     // OIT COMPOSITE PASS 
     // ===================
 
-    glEnable(GL_CULL_FACE);
-    glDepthFunc(GL_ALWAYS);
-    glDepthMask(GL_FALSE);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    rtarget.mainFBO.bind();
-    m_oitCompositeShader.bind();
-    rtarget.oitAccumTexture.bind(0);
-    rtarget.oitRevelageTexture.bind(1);
-
-    // draw a quad (hard-coded in VSh)
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    graph.addPass("oit composite", {textures.oitAccum, textures.oitRevelage}, {textures.color}, [&]() {
+        opengl::getStateCache().enable(GL_CULL_FACE);
+        opengl::getStateCache().depthFunc(GL_ALWAYS);
+        opengl::getStateCache().depthMask(false);
+        opengl::getStateCache().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        graph.getFramebuffer({{GL_COLOR_ATTACHMENT0, textures.color}}).bind();
+        m_oitCompositeShader.bind();
+        graph.getTexture(textures.oitAccum).bind(0);
+        graph.getTexture(textures.oitRevelage).bind(1);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glUseProgram(0);
+        // draw a quad (hard-coded in VSh)
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    });
 
     // ======================================
     // HDR IMAGE / OTHER POSTPROCESSING PASS 
     // ======================================
 
-    glEnable(GL_CULL_FACE);
-    glDepthFunc(GL_ALWAYS);
-    glDepthMask(GL_FALSE);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glBindFramebuffer(GL_FRAMEBUFFER, rtarget.outputFBOid);
-    m_screenShader.bind();
-    rtarget.mainFBOColor.bind(0);
+    graph.addPass("hdr image", {textures.color}, {}, [&]() {
+        opengl::getStateCache().enable(GL_CULL_FACE);
+        opengl::getStateCache().depthFunc(GL_ALWAYS);
+        opengl::getStateCache().depthMask(false);
+        opengl::getStateCache().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        opengl::getStateCache().bindFramebuffer(GL_FRAMEBUFFER, rtarget.outputFBOid);
+        opengl::getStateCache().viewport(0, 0, camera.width, camera.height);
+        m_screenShader.bind();
+        glUniform2i(m_screenShader.getUniform("u_renderSize"), renderSize.x, renderSize.y);
+        glUniform2i(m_screenShader.getUniform("u_outputSize"), camera.width, camera.height);
+        graph.getTexture(textures.color).bind(0);
+
+        // draw a quad (hard-coded in VSh)
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        opengl::getStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        opengl::getStateCache().useProgram(0);
+    });
+
+    graph.execute();
+    if(rtarget.targetFrameTime > 0) dynamicResolution.getTimer().end();
+}
 
-    // draw a quad (hard-coded in VSh)
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+game::Renderer::Renderer()
+{
+    // the light structs of shaders/include/lightTypes.glsl, after the count of their light buffer
+    auto expectLight = [](char const *variable, size_t offset, size_t stride) {
+        opengl::ShaderProgram::expectBufferLayout({variable, static_cast<int>(LightBuffer::HEADER_SIZE + offset), static_cast<int>(stride)});
+    };
+    opengl::ShaderProgram::expectBufferLayout({"numPointLights", 0});
+    opengl::ShaderProgram::expectBufferLayout({"numDirLights", 0});
+    opengl::ShaderProgram::expectBufferLayout({"numSpotLights", 0});
+    using PointLight = LightUpdater::ShaderPointLight;
+    expectLight("pointLights[0].color",       offsetof(PointLight, color),       sizeof(PointLight));
+    expectLight("pointLights[0].attenuation", offsetof(PointLight, attenuation), sizeof(PointLight));
+    expectLight("pointLights[0].position",    offsetof(PointLight, position),    sizeof(PointLight));
+    expectLight("pointLights[0].radius",      offsetof(PointLight, radius),      sizeof(PointLight));
+    using DirLight = LightUpdater::ShaderDirLight;
+    expectLight("dirLights[0].direction", offsetof(DirLight, direction), sizeof(DirLight));
+    expectLight("dirLights[0].color",     offsetof(DirLight, color),     sizeof(DirLight));
+    using SpotLight = LightUpdater::ShaderSpotLight;
+    expectLight("spotLights[0].position",       offsetof(SpotLight, position),       sizeof(SpotLight));
+    expectLight("spotLights[0].innerConeAngle", offsetof(SpotLight, innerConeAngle), sizeof(SpotLight));
+    expectLight("spotLights[0].direction",      offsetof(SpotLight, direction),      sizeof(SpotLight));
+    expectLight("spotLights[0].outerConeAngle", offsetof(SpotLight, outerConeAngle), sizeof(SpotLight));
+    expectLight("spotLights[0].attenuation",    offsetof(SpotLight, attenuation),    sizeof(SpotLight));
+    expectLight("spotLights[0].color",          offsetof(SpotLight, color),          sizeof(SpotLight));
+    expectLight("spotLights[0].radius",         offsetof(SpotLight, radius),         sizeof(SpotLight));
+
+    if(GLAD_GL_VERSION_4_3) {
+        m_deferredLightingShader = std::make_unique<opengl::ShaderProgram>("shaders/deferredLighting");
+    }
+    // per instance attributes follow the mesh attributes (locations 6 - 14), pointed at the stream every frame
+    m_instanceAttribIndex = model::getGeometryArena().getVertexArray().getAttribCount();
+    model::getGeometryArena().getVertexArray().addBuffer(opengl::getStreamBuffer(), getInstanceLayout());
+    opengl::getStateCache().bindVertexArray(0);
+
+    int storageAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    m_storageAlignment = std::max<size_t>(m_storageAlignment, storageAlignment);
+}
+
+bool game::Renderer::pollShaders()
+{
+    for(opengl::ShaderProgram *shader : {&m_hiZShader, &m_depthShader, m_deferredLightingShader.get()}) {
+        if(shader) shader->poll();
+    }
+    for(opengl::ShaderVariants *variants : {&m_propShaders, &m_oitShaders, &m_gBufferShaders}) {
+        variants->poll(); // the groups drawn with a compiling variant are skipped
+    }
+    m_lightClusters.pollShader();
+    bool ready = true;
+    for(opengl::ShaderProgram *shader : {&m_screenShader, &m_oitCompositeShader}) {
+        ready = shader->poll() && ready;
+    }
+    return ready;
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glUseProgram(0);
+unsigned game::Renderer::reloadShaders(std::filesystem::path const &file)
+{
+    unsigned count = 0;
+    for(opengl::ShaderProgram *shader : {&m_screenShader, &m_oitCompositeShader, &m_hiZShader, &m_depthShader, m_deferredLightingShader.get()}) {
+        if(shader && shader->dependsOn(file) && shader->reload()) ++count;
+    }
+    for(opengl::ShaderVariants *variants : {&m_propShaders, &m_oitShaders, &m_gBufferShaders}) {
+        count += variants->reload(file);
+    }
+    count += m_lightClusters.reloadShader(file);
+    count += m_textRenderer.reloadShader(file);
+    return count;
 }
 
 void game::Renderer::update(std::set<ecs::Entity_t> const &entities, double deltatime)
 {
+    bool shadersReady = pollShaders();
+    pruneCameras(m_hiZBuffers, entities);
+    pruneCameras(m_dynamicResolutions, entities);
     for(ecs::Entity_t const &cameraEntity : entities) {
         if(!ecs::entityHasComponent<Camera>(cameraEntity) || !ecs::entityHasComponent<RenderTarget>(cameraEntity)) continue;
 
         game::Camera &camera = ecs::get<game::Camera>(cameraEntity);
         game::RenderTarget &rtarget = ecs::get<game::RenderTarget>(cameraEntity);
-        if(rtarget.prevWidth != camera.width || rtarget.prevHeight != camera.height) { // resize or initialize buffers / textures
-            rtarget.oitAccumTexture.bind();     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, camera.width, camera.height, 0, GL_RGBA, GL_FLOAT, nullptr);
-            rtarget.oitRevelageTexture.bind();  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, camera.width, camera.height, 0, GL_RED, GL_FLOAT, nullptr);
-
-            rtarget.mainFBOColor.bind();        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, camera.width, camera.height, 0, GL_RGBA, GL_FLOAT, nullptr);
-            rtarget.mainFBORBO.bind();          glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, camera.width, camera.height);
-        }
-        if(rtarget.prevWidth == -1) { // initialize render target
-            rtarget.oitFBO.bind();
-            rtarget.oitFBO.attach(rtarget.oitAccumTexture, GL_COLOR_ATTACHMENT0);
-            rtarget.oitFBO.attach(rtarget.oitRevelageTexture, GL_COLOR_ATTACHMENT1);
-            rtarget.oitFBO.attach(rtarget.mainFBORBO, GL_DEPTH_STENCIL_ATTACHMENT);
-            {
-                GLenum const drawbuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-                glDrawBuffers(sizeof(drawbuffers) / sizeof(*drawbuffers), drawbuffers);
-            }
-            assert(rtarget.oitFBO.isComplete());
-
-            rtarget.mainFBO.bind();
-            rtarget.mainFBO.attach(rtarget.mainFBOColor, GL_COLOR_ATTACHMENT0);
-            rtarget.mainFBO.attach(rtarget.mainFBORBO, GL_DEPTH_STENCIL_ATTACHMENT);
-            assert(rtarget.mainFBO.isComplete());
-        }
-        rtarget.prevWidth = camera.width;
-        rtarget.prevHeight = camera.height;
+        if(camera.width <= 0 || camera.height <= 0) continue; // minimized
         
         camera.projMat = getProjMat(cameraEntity);
         camera.viewMat = getViewMat(cameraEntity);
 
-        renderMain(entities, deltatime, camera, rtarget);
-
-        for(ecs::Entity_t const &entity : entities) {
-            if(ecs::entityHasComponent<game::Text>(entity)) drawText(entity, camera);
-        } // for(auto &entity : entities) 
+        if(!shadersReady) { // only the clear color until the programs are compiled, the window stays responsive meanwhile
+            opengl::getStateCache().bindFramebuffer(GL_FRAMEBUFFER, rtarget.outputFBOid);
+            opengl::getStateCache().viewport(0, 0, camera.width, camera.height);
+            opengl::getStateCache().depthMask(true);
+            glClearColor(rtarget.clearColor.r, rtarget.clearColor.g, rtarget.clearColor.b, rtarget.clearColor.a);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            opengl::getStateCache().bindFramebuffer(GL_FRAMEBUFFER, 0);
+        } else {
+            profiler::GpuScope scope{"render camera"}; // the passes before the frame graph show as the gap to the first pass
+            renderMain(entities, deltatime, cameraEntity, camera, rtarget);
+        }
+        profiler::GpuScope scope{"text"};
+        m_textRenderer.draw(entities, camera);
     } // for(auto &cameraEntity : entities)
+    m_texturePool.endFrame();
 }
 
 void game::LightUpdater::update(std::set<ecs::Entity_t> const &entities, double deltatime)
 {
     for(ecs::Entity_t const &storageEntity : entities) {
-        if(!ecs::entityHasComponent<LightStorage>(storageEntity) || !ecs::entityHasComponent<LightUBO>(storageEntity)) continue;
+        if(!ecs::entityHasComponent<LightStorage>(storageEntity) || !ecs::entityHasComponent<LightBuffers>(storageEntity)) continue;
         LightStorage &storage = ecs::get<LightStorage>(storageEntity);
-        opengl::UniformBuffer &ubo = ecs::get<LightUBO>(storageEntity).ubo;
-        if(ubo.getRenderID() == 0) {
-            ubo = opengl::UniformBuffer{0}; // dummy argument
-            ubo.bindingPoint(0);
-        }
+        LightBuffers &buffers = ecs::get<LightBuffers>(storageEntity);
 
-        storage.numPointLights = 0;
-        storage.numDirLights = 0;
-        storage.numSpotLights = 0;
+        storage.pointLights.clear();
+        storage.dirLights.clear();
+        storage.spotLights.clear();
         for(ecs::Entity_t const &lightEntity : entities) {
             if(!ecs::entityHasComponent<Light>(lightEntity)) continue;
             Light const &light = ecs::get<Light>(lightEntity);
 
             if(ecs::entityHasComponent<PointLight>(lightEntity)) {
-                ShaderPointLight &shaderPointLight = storage.pointLights[storage.numPointLights];
                 PointLight const &pointLight = ecs::get<PointLight>(lightEntity);
 
-                shaderPointLight.attenuation = pointLight.attenuation;
-                shaderPointLight.color = light.color;
-                shaderPointLight.position = ecs::entityHasComponent<Position>(lightEntity) ?
-                    ecs::get<Position>(lightEntity).position :
-                    glm::vec3{0};
-                ++storage.numPointLights;
+                storage.pointLights.push_back({
+                    .color = light.color,
+                    .attenuation = pointLight.attenuation,
+                    .position = ecs::entityHasComponent<Position>(lightEntity) ?
+                        ecs::get<Position>(lightEntity).position :
+                        glm::vec3{0},
+                    .radius = getLightRadius(light.color, pointLight.attenuation)
+                });
             } else if(ecs::entityHasComponent<DirectionalLight>(lightEntity)) {
-                ShaderDirLight &shaderDirLight = storage.dirLights[storage.numDirLights];
-
-                shaderDirLight.direction = ecs::entityHasComponent<Direction>(lightEntity) ?
-                    ecs::get<Direction>(lightEntity).dir :
-                    glm::vec3{0, 0, -1};
-                shaderDirLight.color = light.color;
-                ++storage.numDirLights;
+                storage.dirLights.push_back({
+                    .direction = ecs::entityHasComponent<Direction>(lightEntity) ?
+                        ecs::get<Direction>(lightEntity).dir :
+                        glm::vec3{0, 0, -1},
+                    .color = light.color
+                });
             } else if(ecs::entityHasComponent<SpotLight>(lightEntity)) {
-                ShaderSpotLight &shaderSpotLight = storage.spotLights[storage.numSpotLights];
                 SpotLight const &spotLight = ecs::get<SpotLight>(lightEntity);
 
-                shaderSpotLight = {
+                storage.spotLights.push_back({
                     .position = ecs::entityHasComponent<Position>(lightEntity) ?
                         ecs::get<Position>(lightEntity).position :
                         glm::vec3{0, 0, -1},
@@ -379,13 +836,14 @@ void game::LightUpdater::update(std::set<ecs::Entity_t> const &entities, double
                     .outerConeAngle = glm::cos(glm::radians(spotLight.outerConeAngle)),
                     .attenuation = spotLight.attenuation,
                     .color = light.color,
-                };
-                shaderSpotLight.color = light.color;
-                ++storage.numSpotLights;
+                    .radius = getLightRadius(light.color, spotLight.attenuation)
+                });
             }
         }
-        
-        ubo.bind();
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(storage), &storage, GL_DYNAMIC_DRAW);
+
+        // only the lights that changed since the last frame are uploaded
+        buffers.pointLights.update(storage.pointLights);
+        buffers.dirLights.update(storage.dirLights);
+        buffers.spotLights.update(storage.spotLights);
     }
 }
@@ -3,25 +3,49 @@
 #include "opengl/VertexBuffer.hpp"
 #include "opengl/Framebuffer.hpp"
 #include "opengl/Shader.hpp"
+#include "opengl/ShaderVariants.hpp"
 #include "glm/glm.hpp"
 #include "opengl/IndexBuffer.hpp"
 #include "utils/Text.hpp"
 #include "opengl/ShaderStorage.hpp"
+#include "opengl/GeometryArena.hpp"
+#include "opengl/StreamBuffer.hpp"
+#include "game/Frustum.hpp"
+#include "game/HiZBuffer.hpp"
+#include "game/OcclusionRasterizer.hpp"
+#include "game/LightClusters.hpp"
+#include "game/LightBuffer.hpp"
+#include "game/TextRenderer.hpp"
+#include "game/FrameGraph.hpp"
+#include "game/DynamicResolution.hpp"
 
 #include <optional>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace model
+{
+    struct Mesh;
+} // namespace model
 
 namespace game
 {
-    constexpr size_t MAX_LIGHTS = 100;
+    constexpr float LIGHT_CUTOFF = 1.0f / 256; // point and spot lights end where their intensity falls below this
 
     struct Drawable
     {
-        opengl::VertexBuffer vb;
-        opengl::VertexArray va;
-        std::optional<opengl::IndexBuffer> ib;
+        std::shared_ptr<opengl::GeometryArena::Allocation const> geometry; // range of the model geometry arena, shared by the copies of the mesh
         unsigned count;
         GLenum mode = GL_TRIANGLES;
     };
+    struct InstanceData // per instance vertex attributes of the prop / oit shaders
+    {
+        glm::mat4 modelMat;
+        glm::mat4 normalMat;
+        glm::vec4 color;
+    };
     struct Text
     {
         text::Font *font;
@@ -47,6 +71,11 @@ namespace game
     struct PerspectiveProjection {}; // marker component
     struct Transparent {}; // also a marker component
     struct SemiTransparent {};
+    struct StaticGeometry {}; // culled through the bvh of its scene instead of one by one
+    struct DynamicGeometry // culled through the dynamic tree of its scene, kept up to date by MovementSystem
+    {
+        unsigned proxy;
+    };
     struct Color
     {
         glm::vec4 color;
@@ -57,19 +86,27 @@ namespace game
     };
     struct RenderTarget
     {
-        opengl::Framebuffer oitFBO{0}; // 0 -- dummy argument, constructor generates ogl object. TODO: find a better way avoiding dummy arguments
-        opengl::Texture oitAccumTexture{GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_BORDER};
-        opengl::Texture oitRevelageTexture{GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_BORDER};
-
-        opengl::Framebuffer mainFBO{0};
-        opengl::Texture mainFBOColor{GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_BORDER};
-        opengl::Renderbuffer mainFBORBO{0};
+        enum class OcclusionCulling
+        {
+            NONE, HI_Z, SOFTWARE
+        };
+        enum class Shading
+        {
+            FORWARD, DEFERRED
+        };
+        static constexpr float MAX_SHININESS = 256; // the g-buffer stores the shininess normalized to this
+        // the intermediate textures (main color / depth, oit accumulation, g-buffer) are transient, see Renderer::renderMain
 
         // opengl::ShaderProgram *propShader; // TODO: move the shader handle from model entity to render target
 
         glm::vec4 clearColor{0, 0, 0, 1};
         unsigned outputFBOid = 0;
-        int prevWidth = -1, prevHeight = -1;
+        OcclusionCulling occlusionCulling = OcclusionCulling::HI_Z; // hi-z of previous frames, or the occluder props rasterized on the cpu
+        bool depthPrepass = false; // lay down the opaque depth first, so the opaque pass shades every pixel once
+        Shading shading = Shading::FORWARD; // deferred falls back to forward without compute shaders
+        // dynamic resolution: the scene is rendered into a sub-rect of the targets and upscaled by the hdr image pass
+        float targetFrameTime = 0; // milliseconds of gpu time, 0 -- always full resolution
+        float minResolutionScale = 0.5f; // per axis
     };
     struct RepeatTexture
     {
@@ -79,9 +116,15 @@ namespace game
     {
         float shininess;
     };
-    struct LightUBO
+    struct LightBuffers // filled by LightUpdater
     {
-        opengl::UniformBuffer ubo;
+        static constexpr unsigned POINT_LIGHTS_BINDING = 2; // shader storage binding points
+        static constexpr unsigned DIR_LIGHTS_BINDING = 3;
+        static constexpr unsigned SPOT_LIGHTS_BINDING = 4;
+
+        LightBuffer pointLights;
+        LightBuffer dirLights;
+        LightBuffer spotLights;
     };
     struct Light {
         glm::vec3 color;
@@ -101,26 +144,114 @@ namespace game
         glm::vec2 size;
     };
 
+    glm::mat4 getModelMat(ecs::Entity_t const &entity);
+
     class Renderer : public ecs::ISystem
     {
     private:
+        // bits of the prop, oit and g-buffer shader variants, defined under the same names
+        enum MaterialFeature : opengl::ShaderVariants::Features
+        {
+            SKINNED = 1 << 0,
+            HAS_NORMAL_MAP = 1 << 1,
+            HAS_ROUGH_MAP = 1 << 2,
+            ALPHA_TEST = 1 << 3 // fragments below the opaque alpha are discarded, the oit shader always discards the opaque ones
+        };
+        // entities sharing a model and material state, drawn with a single instanced call per mesh
+        struct InstanceBatch
+        {
+            ecs::Entity_t entity; // representative entity, supplies meshes and material state
+            unsigned firstInstance;
+            unsigned instanceCount;
+        };
+        // transient textures of one camera frame
+        struct FrameTextures
+        {
+            FrameGraph::Resource color; // rgba16f hdr
+            FrameGraph::Resource depth; // depth stencil, sampled by the hi-z build
+            FrameGraph::Resource oitAccum;
+            FrameGraph::Resource oitRevelage;
+            // deferred shading only
+            FrameGraph::Resource albedo = 0; // rgba8, specular strength in alpha
+            FrameGraph::Resource normal = 0; // rg16 snorm, octahedral
+            FrameGraph::Resource shininess = 0; // r8
+        };
+        // meshes sharing textures and uniforms, submitted with a single multi draw
+        struct DrawGroup
+        {
+            ecs::Entity_t entity; // supplies uniforms
+            model::Mesh const *mesh; // supplies textures
+            GLenum mode;
+            opengl::ShaderVariants::Features features;
+            unsigned firstCommand;
+            unsigned commandCount;
+        };
         std::map<std::string, opengl::Texture> m_defaultTextures{
             {"", opengl::Texture{"res/textures/white.png", false, false}},
             {"diffuse", opengl::Texture{"res/textures/notfound.png", false, true}},
             {"normal", opengl::Texture{"res/textures/blue.png", false, false}}
         };
         opengl::ShaderProgram m_screenShader{"shaders/hdrImage"};
-        opengl::ShaderProgram m_propShader{"shaders/prop"};
-        opengl::ShaderProgram m_oitShader{"shaders/oitTransparent"};
+        opengl::ShaderVariants m_propShaders{"shaders/prop", {"SKINNED", "HAS_NORMAL_MAP", "HAS_ROUGH_MAP", "ALPHA_TEST"}};
+        opengl::ShaderVariants m_oitShaders{"shaders/oitTransparent", {"SKINNED", "HAS_NORMAL_MAP", "HAS_ROUGH_MAP", ""}};
         opengl::ShaderProgram m_oitCompositeShader{"shaders/oitComposite"};
+        opengl::ShaderProgram m_hiZShader{"shaders/hiZ"};
+        opengl::ShaderProgram m_depthShader{"shaders/depthOnly"};
+        opengl::ShaderVariants m_gBufferShaders{"shaders/gBuffer", {"SKINNED", "HAS_NORMAL_MAP", "HAS_ROUGH_MAP", "ALPHA_TEST"}};
+        std::unique_ptr<opengl::ShaderProgram> m_deferredLightingShader; // null without compute shader support
+        TexturePool m_texturePool; // render targets of every camera
+
+        std::optional<LightBuffers *> m_lightBuffers;
+        LightClusters m_lightClusters; // rebuilt for every camera
+        TextRenderer m_textRenderer;
+
+        // per frame data goes through the stream buffer
+        static constexpr unsigned BONES_BINDING = 5; // shader storage binding point of the bone matrices
+        unsigned m_instanceAttribIndex = 0; // first per instance attribute of the geometry arena vertex array
+        size_t m_storageAlignment = 16;
+        std::vector<InstanceData> m_instanceData;
+        std::vector<opengl::DrawElementsIndirectCommand> m_commands;
+        opengl::StreamBuffer::Allocation m_commandsAllocation;
+        std::vector<ecs::Entity_t> m_instanceEntities; // parallel to m_instanceData
+        std::unordered_map<ecs::Entity_t, std::vector<bool>> m_staticVisibility; // per mesh visibility of the StaticGeometry entities, filled by the scene bvhs
+
+        std::unordered_set<ecs::Entity_t> m_dynamicVisibility; // DynamicGeometry entities whose fat bounds intersect the frustum
+        std::unordered_map<ecs::Entity_t, HiZBuffer> m_hiZBuffers; // per camera
+        std::unordered_map<ecs::Entity_t, DynamicResolution> m_dynamicResolutions; // per camera
+        std::unique_ptr<OcclusionRasterizer> m_occlusionRasterizer; // created once a camera asks for software occlusion culling
+        size_t m_occluderTriangleCount = 0; // of the occluders given to the rasterizer
+        DepthPyramid const *m_occluders = nullptr; // of the camera being rendered, null if occlusion culling is off or no depth is available yet
+
+        void beginSoftwareOcclusion(std::set<ecs::Entity_t> const &entities, glm::mat4 const &viewProjection);
+
+        inline bool isOccluded(AABB<glm::vec3> const &box) const { return m_occluders && m_occluders->isOccluded(box); }
 
-        std::optional<opengl::UniformBuffer *> m_lightsUBO;
+        void cullStaticGeometry(std::set<ecs::Entity_t> const &entities, game::Frustum const &frustum);
+        void cullDynamicGeometry(std::set<ecs::Entity_t> const &entities, game::Frustum const &frustum);
 
-        void renderMain(std::set<ecs::Entity_t> const &entities, double deltatime, game::Camera &camera, game::RenderTarget &rtarget);
-        void drawModel(ecs::Entity_t const &entity, opengl::ShaderProgram const &shader) const;
+        // finishes the programs the driver is done with. false while one the frame can not go without is compiling,
+        // the optional passes (depth prepass, hi-z, deferred shading) and the groups of compiling variants are skipped meanwhile
+        bool pollShaders();
+        void renderMain(std::set<ecs::Entity_t> const &entities, double deltatime, ecs::Entity_t cameraEntity, game::Camera &camera, game::RenderTarget &rtarget);
+        void collectBatches(std::set<ecs::Entity_t> const &entities, bool transparent, game::Frustum const &frustum, std::vector<InstanceBatch> &batches);
+        void buildDrawGroups(std::vector<InstanceBatch> const &batches, game::Frustum const &frustum, std::vector<DrawGroup> &groups);
+        opengl::ShaderVariants::Features getMaterialFeatures(ecs::Entity_t entity, model::Mesh const &mesh) const;
+        /*
+         * draws every group with the variant of its features, the groups are sorted by them so each variant is bound once.
+         * bindVariant sets the uniforms of the pass after a variant is bound. groups whose variant still compiles are skipped
+         */
+        void drawGroups(std::vector<DrawGroup> const &groups, opengl::ShaderVariants &shaders, std::function<void(opengl::ShaderProgram const &)> const &bindVariant);
+        // the position only stream can not skin or alpha test, such groups are left to the opaque pass
+        bool canDepthPrepass(DrawGroup const &group) const;
+        void drawDepthPrepass(std::vector<DrawGroup> const &groups, game::Camera const &camera);
+        // lights the g-buffer into the main color texture
+        void shadeGBuffer(game::Camera const &camera, glm::ivec2 const &renderSize, FrameGraph const &graph, FrameTextures const &textures, glm::vec3 const &cameraPosition);
     public:
-        Renderer() = default;
+        Renderer();
         void update(std::set<ecs::Entity_t> const &entities, double deltatime) override;
+        // reloads the programs and variants that depend on the changed file, the old ones draw until the new ones are done.
+        // the number of reloaded programs
+        unsigned reloadShaders(std::filesystem::path const &file);
     };
     class LightUpdater : public ecs::ISystem
     {
@@ -132,14 +263,14 @@ namespace game
             glm::vec3 color;
             float attenuation;
             glm::vec3 position;
-            float _pad0;
+            float radius; // where the light falls below LIGHT_CUTOFF
         };
         struct ShaderDirLight
         {
             glm::vec3 direction;
-            float _pad0;
+            float _pad0 = 0;
             glm::vec3 color;
-            float _pad1;
+            float _pad1 = 0;
         };
         struct ShaderSpotLight
         {
@@ -147,22 +278,16 @@ namespace game
             float innerConeAngle;
             glm::vec3 direction;
             float outerConeAngle;
-            glm::vec3 _pad1;
+            glm::vec3 _pad1{0};
             float attenuation;
             glm::vec3 color;
-            float _pad0;
+            float radius;
         };
-        struct LightStorage
+        struct LightStorage // cpu copy of the LightBuffers
         {
-            unsigned numPointLights;
-            glm::vec3 _pad0;
-            std::array<ShaderPointLight, MAX_LIGHTS> pointLights;
-            unsigned numDirLights;
-            glm::vec3 _pad1;
-            std::array<ShaderDirLight, MAX_LIGHTS> dirLights;
-            unsigned numSpotLights;
-            glm::vec3 _pad2;
-            std::array<ShaderSpotLight, MAX_LIGHTS> spotLights;
+            std::vector<ShaderPointLight> pointLights;
+            std::vector<ShaderDirLight> dirLights;
+            std::vector<ShaderSpotLight> spotLights;
         };
     public:
         LightUpdater() = default;
@@ -0,0 +1,120 @@
+#include "TextRenderer.hpp"
+#include "Renderer.hpp"
+#include "opengl/StreamBuffer.hpp"
+#include "opengl/StateCache.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+
+namespace
+{
+    opengl::InterleavedInstancingVertexBufferLayout const &getGlyphLayout()
+    {
+        static opengl::InterleavedInstancingVertexBufferLayout const layout{
+            {2, GL_FLOAT, 1}, // offset
+            {2, GL_FLOAT, 1}, // size
+            {2, GL_FLOAT, 1}, // glyph offset
+            {2, GL_FLOAT, 1}, // glyph size
+            {1, GL_UNSIGNED_INT, 1} // text index
+        };
+        return layout;
+    }
+} // namespace
+
+game::TextRenderer::TextRenderer()
+{
+    int storageAlignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    m_storageAlignment = std::max<size_t>(m_storageAlignment, storageAlignment);
+}
+
+void game::TextRenderer::rebuild(text::Font const &font, FontBatch &batch)
+{
+    m_glyphs.clear();
+    for(unsigned i = 0; i < batch.texts.size(); ++i) {
+        CachedText const &cached = m_cache.at(batch.texts[i]);
+        font.layoutText(cached.text, cached.size, i, m_glyphs);
+    }
+    batch.glyphCount = static_cast<unsigned>(m_glyphs.size());
+    batch.dirty = false;
+    if(m_glyphs.empty()) return;
+
+    if(batch.glyphBuffer.getRenderID() == 0 || m_glyphs.size() > batch.capacity) {
+        batch.capacity = std::max(m_glyphs.size(), batch.capacity * 2);
+        if(batch.glyphBuffer.getRenderID() == 0) {
+            batch.glyphBuffer = opengl::VertexBuffer{batch.capacity * sizeof(text::Font::GlyphInstance), GL_STATIC_DRAW};
+            batch.vertexArray = opengl::VertexArray{batch.glyphBuffer, getGlyphLayout()};
+            opengl::getStateCache().bindVertexArray(0);
+        } else {
+            batch.glyphBuffer.bind();
+            glBufferData(GL_ARRAY_BUFFER, batch.capacity * sizeof(text::Font::GlyphInstance), nullptr, GL_STATIC_DRAW);
+        }
+        opengl::getStateCache().bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    opengl::getStreamBuffer().upload(batch.glyphBuffer.getRenderID(), 0, m_glyphs.data(), m_glyphs.size() * sizeof(text::Font::GlyphInstance));
+}
+
+void game::TextRenderer::draw(std::set<ecs::Entity_t> const &entities, Camera const &camera)
+{
+    // refresh the layouts whose string, size or font changed
+    std::map<text::Font const *, std::vector<ecs::Entity_t>> texts;
+    for(ecs::Entity_t const &entity : entities) {
+        if(!ecs::entityHasComponent<Text>(entity)) continue;
+        Text const &text = ecs::get<Text>(entity);
+        if(!text.font) continue;
+        CachedText &cached = m_cache[entity];
+        if(cached.font != text.font || cached.text != text.text || cached.size != text.size) {
+            if(cached.font && cached.font != text.font) m_batches[cached.font].dirty = true;
+            cached = CachedText{text.font, text.text, text.size};
+            m_batches[text.font].dirty = true;
+        }
+        texts[text.font].push_back(entity);
+    }
+    for(auto iter = m_cache.begin(); iter != m_cache.end();) {
+        if(entities.count(iter->first) && ecs::entityHasComponent<Text>(iter->first)) {
+            ++iter;
+            continue;
+        }
+        m_batches[iter->second.font].dirty = true;
+        iter = m_cache.erase(iter);
+    }
+
+    if(!m_shader.poll()) return; // still compiling, the dirty layouts wait for it
+    m_shader.bind();
+    opengl::getStateCache().disable(GL_DEPTH_TEST);
+    opengl::getStateCache().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    opengl::getStateCache().enable(GL_BLEND);
+    glUniform1i(m_shader.getUniform("u_atlas"), 0);
+    glm::mat4 const screenMatrix = glm::ortho<float>(0, static_cast<float>(camera.width), 0, static_cast<float>(camera.height), -1, 1);
+    for(auto &[font, batch] : m_batches) {
+        std::vector<ecs::Entity_t> const &fontTexts = texts[font];
+        if(batch.dirty || batch.texts != fontTexts) {
+            batch.texts = fontTexts;
+            rebuild(*font, batch);
+        }
+        if(batch.glyphCount == 0) continue;
+
+        m_textData.clear();
+        for(ecs::Entity_t const &entity : batch.texts) {
+            Text const &text = ecs::get<Text>(entity);
+            m_textData.push_back(TextData{
+                .matrix = text.matrix.value_or(screenMatrix),
+                .fgColor = text.fgColor,
+                .bgColor = text.bgColor,
+                .position = text.position * glm::vec2{camera.width, camera.height},
+                .size = static_cast<float>(camera.height)
+            });
+        }
+        opengl::StreamBuffer::Allocation textData = opengl::getStreamBuffer().push(m_textData.data(), m_textData.size() * sizeof(TextData), m_storageAlignment);
+        opengl::getStateCache().bindBufferRange(GL_SHADER_STORAGE_BUFFER, TEXTS_BINDING, textData.buffer, textData.offset, m_textData.size() * sizeof(TextData));
+
+        glUniform1f(m_shader.getUniform("u_screenPxRange"), font->getPixelRange());
+        font->getAtlas().texture.bind(0);
+        batch.vertexArray.bind();
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, static_cast<int>(batch.glyphCount));
+    }
+
+    opengl::getStateCache().bindTexture(0, GL_TEXTURE_2D, 0);
+    opengl::getStateCache().bindVertexArray(0);
+    opengl::getStateCache().useProgram(0);
+    opengl::getStateCache().enable(GL_DEPTH_TEST);
+}
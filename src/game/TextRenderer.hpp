@@ -0,0 +1,67 @@
+#pragma once
+#include "utils/ECS.hpp"
+#include "utils/Text.hpp"
+#include "opengl/VertexBuffer.hpp"
+#include "opengl/Shader.hpp"
+#include "glm/glm.hpp"
+#include <set>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace game
+{
+    struct Camera;
+
+    /**
+     * draws every Text entity, one instanced call per font.
+     * glyph quads are laid out once per text and kept in a vertex buffer per font, which is only rewritten when a string,
+     * a size or the set of texts of the font changes. position, colors and matrix go through a small storage buffer every frame
+     */
+    class TextRenderer
+    {
+    public:
+        static constexpr unsigned TEXTS_BINDING = 6; // shader storage binding point of the per text data
+    private:
+        struct TextData // std430
+        {
+            glm::mat4 matrix;
+            glm::vec4 fgColor;
+            glm::vec4 bgColor;
+            glm::vec2 position; // in pixels
+            float size; // in pixels
+            float _pad0 = 0;
+        };
+        struct CachedText
+        {
+            text::Font const *font = nullptr;
+            std::string text;
+            float size = 0;
+        };
+        struct FontBatch
+        {
+            opengl::VertexBuffer glyphBuffer;
+            opengl::VertexArray vertexArray;
+            size_t capacity = 0; // in glyphs
+            unsigned glyphCount = 0;
+            std::vector<ecs::Entity_t> texts; // in the order of their text indices
+            bool dirty = true;
+        };
+        opengl::ShaderProgram m_shader{"shaders/drawText"};
+        std::unordered_map<ecs::Entity_t, CachedText> m_cache;
+        std::map<text::Font const *, FontBatch> m_batches;
+        std::vector<text::Font::GlyphInstance> m_glyphs; // scratch
+        std::vector<TextData> m_textData; // scratch
+        size_t m_storageAlignment = 16;
+
+        void rebuild(text::Font const &font, FontBatch &batch);
+    public:
+        TextRenderer();
+        TextRenderer(TextRenderer const &) = delete;
+        TextRenderer &operator=(TextRenderer const &) = delete;
+
+        void draw(std::set<ecs::Entity_t> const &entities, Camera const &camera);
+        // false if the text shader does not depend on the file or failed to collect
+        inline bool reloadShader(std::filesystem::path const &file) { return m_shader.dependsOn(file) && m_shader.reload(); }
+    };
+} // namespace game
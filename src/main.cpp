@@ -4,6 +4,16 @@
 #include "GLFW/glfw3.h"
 #include "utils/ECS.hpp"
 #include "game/LevelParser.hpp"
+#include "utils/Model.hpp"
+#include "opengl/StreamBuffer.hpp"
+#include "opengl/StateCache.hpp"
+#include "opengl/Shader.hpp"
+#include "game/Benchmark.hpp"
+#include "game/CameraPath.hpp"
+#include "utils/Profiler.hpp"
+#include <cstdlib>
+#include <algorithm>
+#include <filesystem>
 
 #ifdef NDEBUG
 extern constexpr bool DEBUG = false;
@@ -118,6 +128,10 @@ public:
         delete &ecs::getComponentManager();
         delete &ecs::getSystemManager();
         delete &game::getLevelParser();
+        model::deleteGeometryArena(); // only exist if something used them, which needed a context
+        opengl::deleteStreamBuffer();
+        delete &profiler::getProfiler(); // writes the trace
+        delete &opengl::getStateCache(); // last, the gl objects above tell it about their deletion
         glfwTerminate();
     }
 };
@@ -127,7 +141,8 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
 {
 }
-bool init(GLFWwindow** window) {
+// a hidden window renders offscreen at a fixed size, the default framebuffer still exists
+bool init(GLFWwindow** window, int width = 640, int height = 480, bool visible = true) {
     assert(window);
     if (!glfwInit())
         return false;
@@ -139,8 +154,10 @@ bool init(GLFWwindow** window) {
     glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
     glfwWindowHint(GLFW_SAMPLES, 4);
     glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
-    *window = glfwCreateWindow(640, 480, "breakout", NULL, NULL);
+    *window = glfwCreateWindow(width, height, "breakout", NULL, NULL);
     if (!*window) {
         std::cout << "ERROR: failed to init the window!\n";
         return false;
@@ -157,23 +174,67 @@ bool init(GLFWwindow** window) {
         return false;
     }
     glDebugMessageCallback(debugCallback, nullptr);
-    glEnable(GL_MULTISAMPLE);
+    opengl::getStateCache().enable(GL_MULTISAMPLE);
 
     return true;
 }
 
 namespace game
 {
-    void gameMain(GLFWwindow *mainWindow);
+    void gameMain(GLFWwindow *mainWindow, std::filesystem::path const &recordPath);
+    int benchmarkLights(GLFWwindow *mainWindow, unsigned maxLightCount);
+    int benchmarkScene(GLFWwindow *mainWindow, std::filesystem::path const &scenePath, CameraPath const &cameraPath, std::filesystem::path const &outputPath, PrepassOverride prepass);
 } // namespace game
 
 int main(int argc, char **argv) {
+    // --trace <file.json> may follow the other arguments, BREAKOUT_TRACE=<file.json> does the same
+    for(int i = 1; i + 1 < argc; ++i) {
+        if(std::string{argv[i]} == "--trace") profiler::getProfiler().enable(argv[i + 1]);
+    }
+    if(char const *tracePath = std::getenv("BREAKOUT_TRACE"); tracePath && !profiler::getProfiler().isEnabled()) {
+        profiler::getProfiler().enable(tracePath);
+    }
+    if(argc >= 2 && std::string{argv[1]} == "--bench-culling") {
+        return game::benchmarkCulling(argc >= 3 ? std::stoul(argv[2]) : 100000);
+    }
+    if(argc >= 2 && std::string{argv[1]} == "--bench-occlusion") {
+        return game::benchmarkOcclusion(argc >= 3 ? std::stoul(argv[2]) : 100000);
+    }
     std::unique_ptr<Deallocator> cleanup{new Deallocator};
     GLFWwindow* window;
+    if(argc >= 4 && std::string{argv[1]} == "--bench") { // --bench <scene.json> <camera path.json> [results.json | results.csv] [--cold] [--prepass off | on | both]
+        game::CameraPath cameraPath;
+        if(!cameraPath.load(argv[3])) return 1;
+        if(std::find_if(argv, argv + argc, [](char const *arg){ return std::string{arg} == "--cold"; }) != argv + argc) {
+            std::error_code error;
+            std::filesystem::remove_all(opengl::ShaderProgram::BINARY_CACHE_DIRECTORY, error); // startup compiles every program
+        }
+        if(!init(&window, cameraPath.resolution.x, cameraPath.resolution.y, false)) {
+            std::cout << "failed to init!\n";
+            return -1;
+        }
+        game::PrepassOverride prepass = game::PrepassOverride::SCENE;
+        for(int i = 4; i + 1 < argc; ++i) {
+            if(std::string{argv[i]} != "--prepass") continue;
+            std::string mode = argv[i + 1];
+            if(mode == "off") prepass = game::PrepassOverride::OFF;
+            else if(mode == "on") prepass = game::PrepassOverride::ON;
+            else if(mode == "both") prepass = game::PrepassOverride::BOTH;
+            else std::cout << "unknown --prepass mode \"" << mode << "\", the scene decides\n";
+        }
+        return game::benchmarkScene(window, argv[2], cameraPath, argc >= 5 && argv[4][0] != '-' ? argv[4] : "bench.json", prepass);
+    }
     if(!init(&window)) {
         std::cout << "failed to init!\n";
         return -1;
     };
 
-    game::gameMain(window);
+    if(argc >= 2 && std::string{argv[1]} == "--bench-lights") { // needs the window, unlike the headless benchmarks
+        return game::benchmarkLights(window, argc >= 3 ? std::stoul(argv[2]) : 1024);
+    }
+    std::filesystem::path recordPath; // --record-path <camera path.json> saves the camera flight for --bench
+    for(int i = 1; i + 1 < argc; ++i) {
+        if(std::string{argv[i]} == "--record-path") recordPath = argv[i + 1];
+    }
+    game::gameMain(window, recordPath);
 }
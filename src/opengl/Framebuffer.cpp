@@ -1,4 +1,5 @@
 #include "Framebuffer.hpp"
+#include "StateCache.hpp"
 
 opengl::Framebuffer::Framebuffer(unsigned)
 {
@@ -7,13 +8,14 @@ opengl::Framebuffer::Framebuffer(unsigned)
 opengl::Framebuffer::~Framebuffer()
 {
     if(canDeallocate()) {
+        opengl::getStateCache().forgetFramebuffer(m_renderID);
         glDeleteFramebuffers(1, &m_renderID);
     }
 }
 
 void opengl::Framebuffer::bind(unsigned slot) const noexcept
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_renderID);
+    opengl::getStateCache().bindFramebuffer(GL_FRAMEBUFFER, m_renderID);
 }
 bool opengl::Framebuffer::isComplete()
 {
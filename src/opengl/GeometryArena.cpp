@@ -0,0 +1,164 @@
+#include "GeometryArena.hpp"
+#include "StateCache.hpp"
+#include <cassert>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+
+opengl::IndirectBuffer::IndirectBuffer(int) noexcept
+{
+    glGenBuffers(1, &m_renderID);
+}
+opengl::IndirectBuffer::~IndirectBuffer()
+{
+    if(canDeallocate()) {
+        opengl::getStateCache().forgetBuffer(m_renderID);
+        glDeleteBuffers(1, &m_renderID);
+    }
+}
+void opengl::IndirectBuffer::bind(unsigned slot) const noexcept { opengl::getStateCache().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_renderID); }
+
+opengl::GeometryArena::RangeAllocator::RangeAllocator(unsigned capacity)
+{
+    grow(capacity);
+}
+std::optional<unsigned> opengl::GeometryArena::RangeAllocator::allocate(unsigned size)
+{
+    if(size == 0) return 0;
+    for(auto iter = m_freeRanges.begin(); iter != m_freeRanges.end(); ++iter) {
+        auto [offset, rangeSize] = *iter;
+        if(rangeSize < size) continue;
+        m_freeRanges.erase(iter);
+        if(rangeSize > size) {
+            m_freeRanges.insert({offset + size, rangeSize - size});
+        }
+        return offset;
+    }
+    return {};
+}
+void opengl::GeometryArena::RangeAllocator::free(unsigned offset, unsigned size)
+{
+    if(size == 0) return;
+    auto iter = m_freeRanges.insert({offset, size}).first;
+    // merge with the following range
+    auto next = std::next(iter);
+    if(next != m_freeRanges.end() && iter->first + iter->second == next->first) {
+        iter->second += next->second;
+        m_freeRanges.erase(next);
+    }
+    // merge with the preceding range
+    if(iter != m_freeRanges.begin()) {
+        auto prev = std::prev(iter);
+        if(prev->first + prev->second == iter->first) {
+            prev->second += iter->second;
+            m_freeRanges.erase(iter);
+        }
+    }
+}
+void opengl::GeometryArena::RangeAllocator::grow(unsigned capacity)
+{
+    assert(capacity >= m_capacity);
+    unsigned oldCapacity = m_capacity;
+    m_capacity = capacity;
+    free(oldCapacity, capacity - oldCapacity);
+}
+
+// grows the buffer storage in place, so vertex arrays referencing the buffer stay valid
+void growBuffer(unsigned renderID, size_t oldSize, size_t newSize)
+{
+    unsigned staging = 0;
+    glGenBuffers(1, &staging);
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, staging);
+    glBufferData(GL_COPY_WRITE_BUFFER, oldSize, nullptr, GL_STREAM_COPY);
+    opengl::getStateCache().bindBuffer(GL_COPY_READ_BUFFER, renderID);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+
+    glBufferData(GL_COPY_READ_BUFFER, newSize, nullptr, GL_STATIC_DRAW);
+    glCopyBufferSubData(GL_COPY_WRITE_BUFFER, GL_COPY_READ_BUFFER, 0, 0, oldSize);
+    opengl::getStateCache().forgetBuffer(staging);
+    glDeleteBuffers(1, &staging);
+}
+
+opengl::GeometryArena::GeometryArena(InterleavedVertexBufferLayout const &layout, unsigned vertexCapacity, unsigned indexCapacity) :
+    m_layout(layout), m_vertexRanges(vertexCapacity), m_indexRanges(indexCapacity)
+{
+    opengl::getStateCache().bindVertexArray(0); // do not touch the element buffer binding of whatever vertex array is bound
+    m_vertexBuffer = VertexBuffer{static_cast<size_t>(vertexCapacity) * m_layout.getStride(), GL_STATIC_DRAW};
+    m_indexBuffer = IndexBuffer{static_cast<size_t>(indexCapacity) * sizeof(unsigned), GL_STATIC_DRAW};
+    m_positionBuffer = VertexBuffer{static_cast<size_t>(vertexCapacity) * getPositionSize(), GL_STATIC_DRAW};
+    m_vertexArray = VertexArray{m_vertexBuffer, m_layout};
+    m_vertexArray.bind();
+    m_indexBuffer.bind();
+    m_positionArray = VertexArray{m_positionBuffer, InterleavedVertexBufferLayout{m_layout.getElements().front()}};
+    m_positionArray.bind();
+    m_indexBuffer.bind();
+    opengl::getStateCache().bindVertexArray(0);
+}
+
+void opengl::GeometryArena::growVertexBuffer(unsigned vertexCount)
+{
+    unsigned oldCapacity = m_vertexRanges.getCapacity();
+    unsigned newCapacity = std::max(oldCapacity * 2, oldCapacity + vertexCount);
+    growBuffer(m_vertexBuffer.getRenderID(), static_cast<size_t>(oldCapacity) * m_layout.getStride(), static_cast<size_t>(newCapacity) * m_layout.getStride());
+    growBuffer(m_positionBuffer.getRenderID(), static_cast<size_t>(oldCapacity) * getPositionSize(), static_cast<size_t>(newCapacity) * getPositionSize());
+    m_vertexRanges.grow(newCapacity);
+}
+void opengl::GeometryArena::growIndexBuffer(unsigned indexCount)
+{
+    unsigned oldCapacity = m_indexRanges.getCapacity();
+    unsigned newCapacity = std::max(oldCapacity * 2, oldCapacity + indexCount);
+    growBuffer(m_indexBuffer.getRenderID(), static_cast<size_t>(oldCapacity) * sizeof(unsigned), static_cast<size_t>(newCapacity) * sizeof(unsigned));
+    m_indexRanges.grow(newCapacity);
+}
+
+opengl::GeometryArena::Allocation opengl::GeometryArena::allocate(void const *vertices, unsigned vertexCount, unsigned const *indices, unsigned indexCount)
+{
+    std::optional<unsigned> baseVertex = m_vertexRanges.allocate(vertexCount);
+    if(!baseVertex.has_value()) {
+        growVertexBuffer(vertexCount);
+        baseVertex = m_vertexRanges.allocate(vertexCount);
+    }
+    std::optional<unsigned> firstIndex = m_indexRanges.allocate(indexCount);
+    if(!firstIndex.has_value()) {
+        growIndexBuffer(indexCount);
+        firstIndex = m_indexRanges.allocate(indexCount);
+    }
+    assert(baseVertex.has_value() && firstIndex.has_value());
+
+    // upload through the copy target, binding GL_ELEMENT_ARRAY_BUFFER would modify the bound vertex array
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer.getRenderID());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<size_t>(baseVertex.value()) * m_layout.getStride(), static_cast<size_t>(vertexCount) * m_layout.getStride(), vertices);
+    {
+        unsigned positionSize = getPositionSize();
+        std::vector<unsigned char> positions(static_cast<size_t>(vertexCount) * positionSize);
+        for(unsigned i = 0; i < vertexCount; ++i) {
+            std::memcpy(positions.data() + static_cast<size_t>(i) * positionSize, static_cast<unsigned char const *>(vertices) + static_cast<size_t>(i) * m_layout.getStride(), positionSize);
+        }
+        opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, m_positionBuffer.getRenderID());
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<size_t>(baseVertex.value()) * positionSize, positions.size(), positions.data());
+    }
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer.getRenderID());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<size_t>(firstIndex.value()) * sizeof(unsigned), static_cast<size_t>(indexCount) * sizeof(unsigned), indices);
+
+    return Allocation{
+        .baseVertex = baseVertex.value(),
+        .vertexCount = vertexCount,
+        .firstIndex = firstIndex.value(),
+        .indexCount = indexCount
+    };
+}
+void opengl::GeometryArena::free(Allocation const &allocation)
+{
+    m_vertexRanges.free(allocation.baseVertex, allocation.vertexCount);
+    m_indexRanges.free(allocation.firstIndex, allocation.indexCount);
+}
+std::shared_ptr<opengl::GeometryArena::Allocation const> opengl::GeometryArena::allocateShared(void const *vertices, unsigned vertexCount, unsigned const *indices, unsigned indexCount)
+{
+    return std::shared_ptr<Allocation const>{
+        new Allocation{allocate(vertices, vertexCount, indices, indexCount)},
+        [this](Allocation const *allocation) {
+            free(*allocation);
+            delete allocation;
+        }
+    };
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "Object.hpp"
+#include "VertexBuffer.hpp"
+#include "IndexBuffer.hpp"
+#include "glad/gl.h"
+#include <map>
+#include <optional>
+#include <memory>
+
+namespace opengl
+{
+    // matches the layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+    struct DrawElementsIndirectCommand
+    {
+        unsigned count;
+        unsigned instanceCount;
+        unsigned firstIndex;
+        int baseVertex;
+        unsigned baseInstance;
+    };
+
+    class IndirectBuffer : public Object
+    {
+    public:
+        IndirectBuffer() = default;
+        IndirectBuffer(int) noexcept; // dummy argument, constructor generates object
+        ~IndirectBuffer();
+
+        void bind(unsigned slot = 0) const noexcept;
+    };
+
+    /**
+     * one vertex buffer and one index buffer shared by every mesh of the same vertex format.
+     * meshes are sub-allocated from them, so a single vertex array and a single multi draw can cover any number of meshes.
+     * the first layout element (the position) is also kept in a tightly packed buffer of its own for depth only passes
+     */
+    class GeometryArena
+    {
+    public:
+        struct Allocation
+        {
+            unsigned baseVertex = 0;
+            unsigned vertexCount = 0;
+            unsigned firstIndex = 0;
+            unsigned indexCount = 0;
+        };
+    private:
+        // first fit free list over ranges of elements
+        class RangeAllocator
+        {
+        private:
+            std::map<unsigned, unsigned> m_freeRanges; // offset -> size
+            unsigned m_capacity = 0;
+        public:
+            RangeAllocator() = default;
+            RangeAllocator(unsigned capacity);
+            std::optional<unsigned> allocate(unsigned size);
+            void free(unsigned offset, unsigned size);
+            void grow(unsigned capacity);
+            inline unsigned getCapacity() const { return m_capacity; }
+        };
+
+        InterleavedVertexBufferLayout m_layout;
+        RangeAllocator m_vertexRanges;
+        RangeAllocator m_indexRanges;
+        VertexBuffer m_vertexBuffer;
+        VertexBuffer m_positionBuffer;
+        IndexBuffer m_indexBuffer;
+        VertexArray m_vertexArray;
+        VertexArray m_positionArray; // position only, same vertex and index numbering as m_vertexArray
+
+        void growVertexBuffer(unsigned vertexCount);
+        void growIndexBuffer(unsigned indexCount);
+    public:
+        GeometryArena(InterleavedVertexBufferLayout const &layout, unsigned vertexCapacity, unsigned indexCapacity);
+        ~GeometryArena() = default;
+
+        Allocation allocate(void const *vertices, unsigned vertexCount, unsigned const *indices, unsigned indexCount);
+        void free(Allocation const &allocation);
+        // the range goes back to the arena with the last copy of the pointer, so copies of a mesh can share it
+        std::shared_ptr<Allocation const> allocateShared(void const *vertices, unsigned vertexCount, unsigned const *indices, unsigned indexCount);
+
+        inline VertexArray const &getVertexArray() const { return m_vertexArray; }
+        inline VertexArray &getVertexArray() { return m_vertexArray; }
+        inline VertexArray &getPositionArray() { return m_positionArray; }
+        inline unsigned getVertexSize() const { return m_layout.getStride(); }
+        inline unsigned getPositionSize() const { return m_layout.getElements().front().count * static_cast<unsigned>(getSizeOfGLType(m_layout.getElements().front().type)); }
+    };
+} // namespace opengl
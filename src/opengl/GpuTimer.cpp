@@ -0,0 +1,41 @@
+#include "GpuTimer.hpp"
+
+opengl::GpuTimer::~GpuTimer()
+{
+    if(m_queries[0]) glDeleteQueries(QUERY_COUNT, m_queries.data());
+}
+
+void opengl::GpuTimer::begin()
+{
+    if(!m_queries[0]) glGenQueries(QUERY_COUNT, m_queries.data());
+    if(m_pending[m_next]) return; // every query still in flight, skip this span
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    m_running = true;
+}
+
+void opengl::GpuTimer::end()
+{
+    if(!m_running) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % QUERY_COUNT;
+    m_running = false;
+}
+
+std::optional<double> opengl::GpuTimer::poll()
+{
+    // queries finish in submission order, the newest finished one wins
+    std::optional<double> result;
+    for(unsigned i = 0; i < QUERY_COUNT; ++i) {
+        unsigned index = (m_next + i) % QUERY_COUNT;
+        if(!m_pending[index]) continue;
+        int available = 0;
+        glGetQueryObjectiv(m_queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) break;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(m_queries[index], GL_QUERY_RESULT, &nanoseconds);
+        m_pending[index] = false;
+        result = nanoseconds * 1.0E-6;
+    }
+    return result;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "glad/gl.h"
+#include <array>
+#include <optional>
+
+namespace opengl
+{
+    /**
+     * gpu time of a span of commands, measured with GL_TIME_ELAPSED queries.
+     * a few queries are in flight at once and read back without stalling, so results arrive a couple of frames late
+     */
+    class GpuTimer
+    {
+    public:
+        static constexpr unsigned QUERY_COUNT = 4;
+    private:
+        std::array<unsigned, QUERY_COUNT> m_queries{};
+        std::array<bool, QUERY_COUNT> m_pending{};
+        unsigned m_next = 0; // oldest query, the next one to reuse
+        bool m_running = false;
+    public:
+        GpuTimer() = default;
+        GpuTimer(GpuTimer const &) = delete;
+        GpuTimer &operator=(GpuTimer const &) = delete;
+        ~GpuTimer();
+
+        // time elapsed queries do not nest, only one timer may be running
+        void begin();
+        void end();
+        // milliseconds of the newest finished span, empty if none finished since the last call
+        std::optional<double> poll();
+    };
+} // namespace opengl
@@ -1,4 +1,5 @@
 #include "IndexBuffer.hpp"
+#include "StateCache.hpp"
 
 opengl::IndexBuffer::IndexBuffer(size_t size, GLenum usage) noexcept
 {
@@ -16,8 +17,10 @@ opengl::IndexBuffer::IndexBuffer(size_t size, void const *data, GLenum usage) no
 
 opengl::IndexBuffer::~IndexBuffer()
 {
-    if(canDeallocate())
+    if(canDeallocate()) {
+        opengl::getStateCache().forgetBuffer(m_renderID);
         glDeleteBuffers(1, &m_renderID);
+    }
 }
 
-void opengl::IndexBuffer::bind(unsigned slot) const noexcept { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderID); }
\ No newline at end of file
+void opengl::IndexBuffer::bind(unsigned slot) const noexcept { opengl::getStateCache().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderID); }
\ No newline at end of file
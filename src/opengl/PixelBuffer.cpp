@@ -0,0 +1,16 @@
+#include "PixelBuffer.hpp"
+#include "StateCache.hpp"
+#include "glad/gl.h"
+
+opengl::PixelBuffer::PixelBuffer(int) noexcept
+{
+    glGenBuffers(1, &m_renderID);
+}
+opengl::PixelBuffer::~PixelBuffer()
+{
+    if(canDeallocate()) {
+        opengl::getStateCache().forgetBuffer(m_renderID);
+        glDeleteBuffers(1, &m_renderID);
+    }
+}
+void opengl::PixelBuffer::bind(unsigned slot) const noexcept { opengl::getStateCache().bindBuffer(GL_PIXEL_PACK_BUFFER, m_renderID); }
@@ -0,0 +1,16 @@
+#pragma once
+#include "Object.hpp"
+
+namespace opengl
+{
+    // pixel pack buffer, target of asynchronous texture / framebuffer readbacks
+    class PixelBuffer : public Object
+    {
+    public:
+        PixelBuffer() = default;
+        PixelBuffer(int) noexcept; // dummy argument, constructor generates object
+        ~PixelBuffer();
+
+        void bind(unsigned slot = 0) const noexcept;
+    };
+} // namespace opengl
@@ -1,14 +1,89 @@
 #include "Shader.hpp"
+#include "StateCache.hpp"
+#include "utils/Profiler.hpp"
+#include "utils/MappedFile.hpp"
 #include <fstream>
 #include <cassert>
 #include <filesystem>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <sstream>
 
-bool compileShader(opengl::ShaderProgram::Shader &shader, std::string &log) noexcept {
+constexpr uint32_t BINARY_MAGIC = 0x4E494250; // "PBIN"
+constexpr uint32_t BINARY_VERSION = 1;
+
+struct BinaryHeader // followed by size bytes of the program binary
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+};
+
+uint64_t hashBytes(uint64_t hash, void const *data, size_t size) noexcept {
+    // fnv-1a
+    unsigned char const *bytes = static_cast<unsigned char const *>(data);
+    for(size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+uint64_t hashString(uint64_t hash, char const *string) noexcept {
+    return string ? hashBytes(hash, string, std::strlen(string) + 1) : hash;
+}
+bool supportsProgramBinaries() noexcept {
+    static bool const supported = []() {
+        int formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        return formatCount > 0;
+    }();
+    return supported;
+}
+std::filesystem::path getBinaryPath(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return std::filesystem::path{opengl::ShaderProgram::BINARY_CACHE_DIRECTORY} / name;
+}
+
+// GL_KHR_parallel_shader_compile, the glad headers were generated without it
+constexpr GLenum COMPLETION_STATUS = 0x91B1;
+
+bool supportsParallelCompile() noexcept {
+    static bool const supported = []() {
+        int extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for(int i = 0; i < extensionCount; ++i) {
+            std::string extension = reinterpret_cast<char const *>(glGetStringi(GL_EXTENSIONS, i));
+            if(extension == "GL_KHR_parallel_shader_compile" || extension == "GL_ARB_parallel_shader_compile") return true;
+        }
+        return false;
+    }();
+    return supported;
+}
+
+// status and log are only queried once the program is done, querying them earlier waits for the compiler
+void submitShader(opengl::ShaderProgram::Shader &shader) noexcept {
     shader.renderID = glCreateShader(shader.type);
     char *source = &*shader.source.begin();
     glShaderSource(shader.renderID, 1, &source, nullptr);
     glCompileShader(shader.renderID);
+}
+unsigned submitProgram(std::vector<opengl::ShaderProgram::Shader> const &shaders) noexcept {
+    unsigned program = glCreateProgram();
+    for(auto const &shader : shaders) {
+        glAttachShader(program, shader.renderID);
+    }
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(program);
+    return program;
+}
+
+bool checkShader(opengl::ShaderProgram::Shader const &shader, std::string &log) noexcept {
     int success;
     glGetShaderiv(shader.renderID, GL_COMPILE_STATUS, &success);
     if(!success) {
@@ -23,13 +98,7 @@ bool compileShader(opengl::ShaderProgram::Shader &shader, std::string &log) noex
     return true;
 }
 
-bool linkProgram(unsigned &program, std::vector<opengl::ShaderProgram::Shader> shaders, std::string &log) noexcept {
-    program = glCreateProgram();
-    for(auto const &shader : shaders) {
-        glAttachShader(program, shader.renderID);
-    }
-    glLinkProgram(program);
-
+bool checkProgram(unsigned program, std::string &log) noexcept {
     int success;
     glGetProgramiv(program, GL_LINK_STATUS, &success);
     if(!success) {
@@ -44,31 +113,164 @@ bool linkProgram(unsigned &program, std::vector<opengl::ShaderProgram::Shader> s
     return true;
 }
 
+unsigned compilingCount = 0;
+
+// by variable, see ShaderProgram::expectBufferLayout
+std::map<std::string, opengl::ShaderProgram::BufferLayout> &getBufferLayouts() {
+    static std::map<std::string, opengl::ShaderProgram::BufferLayout> layouts;
+    return layouts;
+}
+
+struct IncludeFile
+{
+    std::filesystem::file_time_type writeTime;
+    std::string source;
+};
+// parsed once and shared by every program including them, read again when they change on disk
+std::map<std::filesystem::path, IncludeFile> includeCache;
+
+// the quoted path of an #include line, empty if the line is something else
+std::string getIncludePath(std::string const &line) {
+    size_t hash = line.find_first_not_of(" \t");
+    if(hash == std::string::npos || line[hash] != '#') return "";
+    size_t directive = line.find_first_not_of(" \t", hash + 1);
+    if(directive == std::string::npos || line.compare(directive, 7, "include") != 0) return "";
+    size_t open = line.find('"', directive + 7);
+    size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+    return close == std::string::npos ? "" : line.substr(open + 1, close - open - 1);
+}
+
+IncludeFile const *readInclude(std::filesystem::path const &path) {
+    std::error_code error;
+    std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+    if(error) return nullptr;
+    auto cached = includeCache.find(path);
+    if(cached != includeCache.end() && cached->second.writeTime == writeTime) return &cached->second;
+    std::ifstream file{path};
+    if(!file) return nullptr;
+    IncludeFile &include = includeCache[path];
+    include.writeTime = writeTime;
+    include.source = std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    return &include;
+}
+
+/*
+ * replaces the #include "file" lines of the source with the files, searched next to the including file and then in
+ * INCLUDE_DIRECTORY. a file is only included once per shader, whatever the #ifdefs around it say. #line directives keep
+ * the compiler log at the right line, their source string number is the index in files, which starts with the stage file
+ */
+bool resolveIncludes(std::string const &source, std::vector<std::filesystem::path> &files, std::string &result, std::string &log) {
+    unsigned fileIndex = static_cast<unsigned>(files.size() - 1);
+    std::filesystem::path directory = files.back().parent_path();
+    std::istringstream lines{source};
+    std::string line;
+    for(unsigned lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+        std::string includePath = getIncludePath(line);
+        if(includePath.empty()) {
+            result += line + '\n';
+            continue;
+        }
+        std::filesystem::path path = directory / includePath;
+        if(!std::filesystem::exists(path)) path = std::filesystem::path{opengl::ShaderProgram::INCLUDE_DIRECTORY} / includePath;
+        path = std::filesystem::weakly_canonical(path);
+        if(std::find(files.begin(), files.end(), path) == files.end()) {
+            IncludeFile const *include = readInclude(path);
+            if(!include) {
+                log.append(files[fileIndex].string() + ":" + std::to_string(lineNumber) + ": failed to include \"" + includePath + "\"\n");
+                return false;
+            }
+            files.push_back(path);
+            result += "#line 1 " + std::to_string(files.size() - 1) + "\n";
+            if(!resolveIncludes(include->source, files, result, log)) return false;
+        }
+        result += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+    }
+    return true;
+}
+
+// right after #version, which has to come first. the binary cache key covers them, being part of the source
+void injectDefines(std::string &source, std::vector<std::string> const &defines) {
+    if(defines.empty()) return;
+    size_t version = source.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if(lineEnd == std::string::npos) return; // the compiler reports the missing version
+    std::string injected;
+    for(std::string const &define : defines) {
+        injected += "#define " + define + "\n";
+    }
+    size_t versionLine = std::count(source.begin(), source.begin() + lineEnd, '\n') + 1;
+    injected += "#line " + std::to_string(versionLine + 1) + " 0\n"; // the compiler log keeps the line numbers of the file
+    source.insert(lineEnd + 1, injected);
+}
+
+void opengl::ShaderProgram::discardPending() noexcept
+{
+    if(!m_pendingProgram) return;
+    glDeleteProgram(m_pendingProgram);
+    m_pendingProgram = 0;
+    --compilingCount;
+    for(Shader &shader : m_shaders) {
+        if(shader.renderID) glDeleteShader(shader.renderID);
+        shader.renderID = 0;
+    }
+}
+
 void opengl::ShaderProgram::deallocate() noexcept
 {
+    discardPending();
     if(m_renderID) glDeleteProgram(m_renderID);
-    for(Shader const &shader : m_shaders) {
-        if(shader.renderID) glDeleteShader(shader.renderID);
-    }   
+    m_renderID = 0;
+}
+
+void opengl::ShaderProgram::install(unsigned program) noexcept
+{
+    if(m_renderID) glDeleteProgram(m_renderID); // stays in use until the next program is bound
+    m_renderID = program;
+    m_layoutsChecked = false;
+    m_uniformLocationCache.erase(m_uniformLocationCache.begin(), m_uniformLocationCache.end());
+}
+
+void opengl::ShaderProgram::checkBufferLayouts() noexcept
+{
+    m_layoutsChecked = true;
+    if(!GLAD_GL_VERSION_4_3) return; // no program interface query
+    for(auto const &[variable, layout] : getBufferLayouts()) {
+        unsigned index = glGetProgramResourceIndex(m_renderID, GL_BUFFER_VARIABLE, variable.c_str());
+        if(index == GL_INVALID_INDEX) continue; // not declared, or optimized out
+        GLenum const properties[2] = {GL_OFFSET, GL_TOP_LEVEL_ARRAY_STRIDE};
+        int values[2] = {0, 0};
+        glGetProgramResourceiv(m_renderID, GL_BUFFER_VARIABLE, index, 2, properties, 2, nullptr, values);
+        if(values[0] == layout.offset && (layout.arrayStride == 0 || values[1] == layout.arrayStride)) continue;
+        std::cout << "buffer layout mismatch in \"" << m_dirPath << "\": " << variable << " at offset " << values[0] << " with array stride " << values[1]
+            << ", the cpu expects offset " << layout.offset << " with array stride " << layout.arrayStride << "\n";
+    }
+}
+
+void opengl::ShaderProgram::expectBufferLayout(BufferLayout const &layout)
+{
+    getBufferLayouts()[layout.variable] = layout;
+}
+
+opengl::ShaderProgram::ShaderProgram(std::string const &directory, bool showLog) :
+    ShaderProgram(directory, {}, showLog)
+{
 }
 
-opengl::ShaderProgram::ShaderProgram(std::string const &directory, bool showLog)
+opengl::ShaderProgram::ShaderProgram(std::string const &directory, std::vector<std::string> const &defines, bool showLog) :
+    m_defines(defines),
+    m_showLog(showLog)
 {
     if(!collectShaders(directory)) {
         m_log.insert(0, "failed to collect shaders in directory \"" + directory + "\"\n");
         if(showLog) std::cout << getLog();
         throw std::runtime_error{"failed to init shader program"};
     }
-    if(!compileShaders()) {
-        m_log.insert(0, "failed to compile shaders in directory \"" + directory + "\"\n");
-        if(showLog) std::cout << getLog();
-        throw std::runtime_error{"failed to init shader program"};
-    }
+    beginCompile(); // compile errors show up once it is polled, the program is not ready then
 }
 
 opengl::ShaderProgram::~ShaderProgram()
 {
-    if(canDeallocate()) {
+    if(Resource::canDeallocate()) { // not Object's, a program whose first compile is pending has no render id yet
         deallocate();
     }
 }
@@ -76,9 +278,11 @@ opengl::ShaderProgram::~ShaderProgram()
 bool opengl::ShaderProgram::collectShaders(std::string const &directory) noexcept
 {
     assert(std::filesystem::exists(directory));
+    discardPending(); // its shader objects are about to go
     m_dirPath = directory;
     m_log = "";
     m_shaders.erase(m_shaders.begin(), m_shaders.end());
+    m_dependencies.clear();
     m_uniformLocationCache.erase(m_uniformLocationCache.begin(), m_uniformLocationCache.end());
     for(auto const &directoryEntry : std::filesystem::recursive_directory_iterator{directory}) {
         if(!std::filesystem::is_regular_file(directoryEntry.path())) continue; 
@@ -96,12 +300,42 @@ bool opengl::ShaderProgram::collectShaders(std::string const &directory) noexcep
         }
 
         std::ifstream filestream{directoryEntry.path()};
-        shader.source = std::string{std::istreambuf_iterator<char>{filestream}, std::istreambuf_iterator<char>{}};
+        std::string source{std::istreambuf_iterator<char>{filestream}, std::istreambuf_iterator<char>{}};
+        shader.files = {directoryEntry.path()};
+        if(!resolveIncludes(source, shader.files, shader.source, m_log)) return false;
+        injectDefines(shader.source, m_defines);
+        m_dependencies.insert(shader.files.begin() + 1, shader.files.end());
         m_shaders.push_back(shader);
     }
     return true;
 }
 
+bool opengl::ShaderProgram::reload() noexcept
+{
+    bool compiling = isCompiling();
+    discardPending(); // the copy must not keep the shader objects
+    std::vector<Shader> shaders = m_shaders;
+    std::set<std::filesystem::path> dependencies = m_dependencies;
+    if(!collectShaders(m_dirPath)) {
+        if(m_showLog) std::cout << "failed to collect shaders from directory \"" << m_dirPath << "\":\n" << m_log;
+        m_shaders = shaders;
+        m_dependencies = dependencies;
+        if(compiling) beginCompile();
+        return false;
+    }
+    beginCompile(); // the old program keeps drawing until the new one is done
+    return true;
+}
+
+bool opengl::ShaderProgram::dependsOn(std::filesystem::path const &file) const noexcept
+{
+    std::filesystem::path path = std::filesystem::weakly_canonical(file);
+    if(m_dependencies.count(path)) return true;
+    // a stage added to the directory counts too
+    std::filesystem::path relative = path.lexically_relative(std::filesystem::weakly_canonical(m_dirPath));
+    return !relative.empty() && *relative.begin() != "..";
+}
+
 std::string shaderTypeToString(unsigned type) noexcept {
     switch (type)
     {
@@ -112,31 +346,179 @@ std::string shaderTypeToString(unsigned type) noexcept {
     default:                 return "unknown type";
     }
 }
-bool opengl::ShaderProgram::compileShaders() noexcept
+uint64_t opengl::ShaderProgram::getBinaryKey() const noexcept
 {
-    if(canDeallocate()) 
-        deallocate();
+    uint64_t key = 0xCBF29CE484222325ull;
+    // a binary only loads into the driver that made it
+    for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+        key = hashString(key, reinterpret_cast<char const *>(glGetString(name)));
+    }
+    // the directory order is not stable, the stages are
+    std::vector<Shader const *> shaders;
+    for(Shader const &shader : m_shaders) shaders.push_back(&shader);
+    std::stable_sort(shaders.begin(), shaders.end(), [](Shader const *a, Shader const *b){ return a->type < b->type; });
+    for(Shader const *shader : shaders) {
+        key = hashBytes(key, &shader->type, sizeof(shader->type));
+        key = hashBytes(key, shader->source.data(), shader->source.size());
+    }
+    return key;
+}
 
-    m_uniformLocationCache.erase(m_uniformLocationCache.begin(), m_uniformLocationCache.end());
+unsigned opengl::ShaderProgram::loadBinary(uint64_t key) const noexcept
+{
+    MappedFile file{getBinaryPath(key)};
+    if(!file.isOpen() || file.size() < sizeof(BinaryHeader)) return 0;
+    BinaryHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(header.magic != BINARY_MAGIC || header.version != BINARY_VERSION || header.key != key || file.size() != sizeof(BinaryHeader) + header.size) return 0;
+
+    unsigned program = glCreateProgram();
+    glProgramBinary(program, header.format, file.data() + sizeof(BinaryHeader), static_cast<int>(header.size));
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success) { // the driver changed without changing its version strings
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void opengl::ShaderProgram::saveBinary(unsigned program, uint64_t key) const noexcept
+{
+    int size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0) return;
+    std::vector<char> binary(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &size, &format, binary.data());
+    BinaryHeader header{
+        .magic = BINARY_MAGIC,
+        .version = BINARY_VERSION,
+        .key = key,
+        .format = format,
+        .size = static_cast<uint32_t>(size)
+    };
+
+    std::error_code error;
+    std::filesystem::create_directories(BINARY_CACHE_DIRECTORY, error);
+    std::filesystem::path path = getBinaryPath(key);
+    // renamed into place, a crash never leaves half a binary behind
+    std::filesystem::path temporary = std::filesystem::path{path} += ".tmp";
+    {
+        std::ofstream stream{temporary, std::ios::binary | std::ios::trunc};
+        if(!stream) return;
+        stream.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        stream.write(binary.data(), size);
+        if(!stream) return;
+    }
+    std::filesystem::rename(temporary, path, error);
+    if(error) std::filesystem::remove(temporary, error);
+}
+
+opengl::ShaderProgram::CompileStats &opengl::ShaderProgram::getCompileStats() noexcept
+{
+    static CompileStats stats;
+    return stats;
+}
+
+void opengl::ShaderProgram::beginCompile() noexcept
+{
+    std::string traceName = "submit " + m_dirPath;
+    profiler::CpuScope scope{traceName, "load"};
+    auto start = std::chrono::steady_clock::now();
+    CompileStats &stats = getCompileStats();
+    discardPending();
     m_log = "";
-    
+
+    m_pendingKey = supportsProgramBinaries() ? getBinaryKey() : 0;
+    if(unsigned program = m_pendingKey ? loadBinary(m_pendingKey) : 0) {
+        install(program);
+        m_fromBinaryCache = true;
+        ++stats.loadedFromCache;
+        stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return;
+    }
     for(Shader &shader : m_shaders) {
-        if(!compileShader(shader, m_log)) {
+        submitShader(shader);
+    }
+    m_pendingProgram = submitProgram(m_shaders);
+    ++compilingCount;
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool opengl::ShaderProgram::finishCompile() noexcept
+{
+    if(!m_pendingProgram) return isReady();
+    std::string traceName = "compile " + m_dirPath;
+    profiler::CpuScope scope{traceName, "load"};
+    auto start = std::chrono::steady_clock::now();
+    CompileStats &stats = getCompileStats();
+
+    bool success = true;
+    for(Shader const &shader : m_shaders) {
+        if(!checkShader(shader, m_log)) {
+            if(shader.files.size() > 1) { // the source string numbers of the log
+                for(size_t i = 0; i < shader.files.size(); ++i) {
+                    m_log.append(std::to_string(i) + ": " + shader.files[i].string() + "\n");
+                }
+            }
             m_log.insert(0, "failed to compile " + shaderTypeToString(shader.type) + " shader\n");
-            return false;
+            success = false;
+            break;
         }
     }
-
-    if(!linkProgram(m_renderID, m_shaders, m_log)) {
+    if(success && !checkProgram(m_pendingProgram, m_log)) {
         m_log.insert(0, "failed to link shader program\n");
+        success = false;
+    }
+    if(!success) {
+        m_log.insert(0, "failed to compile shaders in directory \"" + m_dirPath + "\"" + (m_renderID ? ", keeping the previous program" : "") + "\n");
+        if(m_showLog) std::cout << m_log;
+        discardPending();
         return false;
     }
 
+    unsigned program = m_pendingProgram;
+    m_pendingProgram = 0;
+    --compilingCount;
+    for(Shader &shader : m_shaders) { // the program keeps what it needs
+        glDetachShader(program, shader.renderID);
+        glDeleteShader(shader.renderID);
+        shader.renderID = 0;
+    }
+    install(program);
+    m_fromBinaryCache = false;
+    if(m_pendingKey) saveBinary(program, m_pendingKey);
+    ++stats.compiled;
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     return true;
 }
 
+bool opengl::ShaderProgram::poll() noexcept
+{
+    if(m_pendingProgram) {
+        int done = GL_TRUE;
+        if(supportsParallelCompile()) glGetProgramiv(m_pendingProgram, COMPLETION_STATUS, &done);
+        if(done) finishCompile();
+    }
+    if(isReady() && !m_layoutsChecked) checkBufferLayouts();
+    return isReady();
+}
+
+bool opengl::ShaderProgram::compileShaders() noexcept
+{
+    beginCompile();
+    return finishCompile();
+}
+
+unsigned opengl::ShaderProgram::getCompilingCount() noexcept
+{
+    return compilingCount;
+}
+
 int opengl::ShaderProgram::getUniform(std::string const &name) const noexcept
 {
+    if(!m_renderID) return -1;
     if(m_uniformLocationCache.find(name) != m_uniformLocationCache.end()) return m_uniformLocationCache[name];
     int location = glGetUniformLocation(m_renderID, name.c_str());
     m_uniformLocationCache[name] = location;
@@ -158,4 +540,4 @@ int opengl::ShaderProgram::getStorageBlock(std::string const &name) const noexce
     return location;
 }
 
-void opengl::ShaderProgram::bind(unsigned slot) const noexcept { glUseProgram(m_renderID); }
+void opengl::ShaderProgram::bind(unsigned slot) const noexcept { opengl::getStateCache().useProgram(m_renderID); }
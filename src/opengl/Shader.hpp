@@ -4,28 +4,82 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <filesystem>
+#include <cstdint>
 
 namespace opengl
 {
+    /**
+     * program linked from the shaders of a directory, one file per stage. compilation is submitted and finished later, with
+     * GL_KHR_parallel_shader_compile the driver compiles every program submitted at once on its own threads meanwhile.
+     * linked programs are kept as driver binaries in BINARY_CACHE_DIRECTORY, keyed by a hash of the sources and the driver,
+     * and loaded from there instead of compiling when the key matches and the driver still accepts the binary
+     */
     class ShaderProgram : public Object {
     public:
+        static constexpr char const *BINARY_CACHE_DIRECTORY = ".shadercache";
+        static constexpr char const *INCLUDE_DIRECTORY = "shaders/include"; // searched after the directory of the including file
+
         struct Shader {
             unsigned renderID = 0;
             GLenum type;
-            std::string source;
+            std::string source; // includes resolved
+            std::vector<std::filesystem::path> files; // the stage file, then the included ones in the order of their #line numbers
+        };
+        // a member of a shader storage block as the cpu lays it out, see expectBufferLayout
+        struct BufferLayout {
+            std::string variable; // as introspection names it, e.g. "pointLights[0].position"
+            int offset; // from the start of the block
+            int arrayStride = 0; // of the top level array the variable is in, 0 -- not an array
+        };
+        // of every program since startup
+        struct CompileStats {
+            unsigned compiled = 0;
+            unsigned loadedFromCache = 0;
+            double milliseconds = 0;
         };
     private:
         mutable std::map<std::string, int> m_uniformLocationCache;
         std::vector<Shader> m_shaders;
         std::string m_log;
         std::string m_dirPath;
+        std::vector<std::string> m_defines;
+        std::set<std::filesystem::path> m_dependencies; // included files of every stage, canonical
+        bool m_fromBinaryCache = false;
+        bool m_showLog = true;
+        unsigned m_pendingProgram = 0; // submitted, the shaders hold their compiling objects meanwhile
+        uint64_t m_pendingKey = 0;
+        bool m_layoutsChecked = false;
         void deallocate() noexcept;
+        void discardPending() noexcept;
+        void install(unsigned program) noexcept;
+        void checkBufferLayouts() noexcept;
+        uint64_t getBinaryKey() const noexcept;
+        unsigned loadBinary(uint64_t key) const noexcept;
+        void saveBinary(unsigned program, uint64_t key) const noexcept;
         
         public:
         ShaderProgram() noexcept = default;
+        // only submits the compilation, see poll
         ShaderProgram(std::string const &directory, bool showLog = true);
+        // defines -- "NAME" or "NAME VALUE", defined in every stage right after #version
+        ShaderProgram(std::string const &directory, std::vector<std::string> const &defines, bool showLog = true);
         ~ShaderProgram();
+        // reads the stage files of the directory and resolves their #include "file" lines, see INCLUDE_DIRECTORY
         bool collectShaders(std::string const &directory) noexcept;
+        // collects the directory again and begins compiling. false if collecting failed, the previous sources stay then
+        bool reload() noexcept;
+        /*
+         * submits the collected shaders without waiting for the compiler. a program loaded from the binary cache is ready right away.
+         * the previous program stays in use until the new one is done, and after that if it failed
+         */
+        void beginCompile() noexcept;
+        // waits for the submitted program, false if it failed
+        bool finishCompile() noexcept;
+        // finishes the submitted program if the driver is done with it, only waits without parallel shader compilation. true if ready
+        bool poll() noexcept;
+        // beginCompile and finishCompile
         bool compileShaders() noexcept;
         int getUniform(std::string const &name) const noexcept;
         int getUniformBlock(std::string const &name) const noexcept;
@@ -37,5 +91,21 @@ namespace opengl
         inline std::string const &getPath() const noexcept { return m_dirPath; }
         inline std::string &getPath() noexcept { return m_dirPath; }
         inline std::string const &getLog() const noexcept { return m_log; }
+        inline std::vector<std::string> const &getDefines() const noexcept { return m_defines; }
+        inline std::set<std::filesystem::path> const &getDependencies() const noexcept { return m_dependencies; }
+        // true if the file is in the directory of the stages or included by one, so changing it needs a recompile
+        bool dependsOn(std::filesystem::path const &file) const noexcept;
+        inline bool isFromBinaryCache() const noexcept { return m_fromBinaryCache; }
+        inline bool isReady() const noexcept { return m_renderID != 0; }
+        inline bool isCompiling() const noexcept { return m_pendingProgram != 0; }
+
+        static CompileStats &getCompileStats() noexcept;
+        // programs submitted and not finished yet
+        static unsigned getCompilingCount() noexcept;
+        /*
+         * checked against every program that declares the variable the first time it is polled ready, a mismatch is logged.
+         * the c++ mirrors of the structs in INCLUDE_DIRECTORY register theirs, so the two can not drift apart silently
+         */
+        static void expectBufferLayout(BufferLayout const &layout);
     };
 } // namespace opengl
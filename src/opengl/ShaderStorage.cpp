@@ -1,4 +1,5 @@
 #include "ShaderStorage.hpp"
+#include "StateCache.hpp"
 #include "glad/gl.h"
 
 opengl::UniformBuffer::UniformBuffer(int) noexcept
@@ -9,12 +10,13 @@ opengl::UniformBuffer::UniformBuffer(int) noexcept
 opengl::UniformBuffer::~UniformBuffer()
 {
     if(canDeallocate()) {
+        opengl::getStateCache().forgetBuffer(m_renderID);
         glDeleteBuffers(1, &m_renderID);
     }
 }
 
-void opengl::UniformBuffer::bind(unsigned slot) const noexcept { glBindBuffer(GL_UNIFORM_BUFFER, m_renderID); }
-void opengl::UniformBuffer::bindingPoint(unsigned index) const noexcept { glBindBufferBase(GL_UNIFORM_BUFFER, index, m_renderID); }
+void opengl::UniformBuffer::bind(unsigned slot) const noexcept { opengl::getStateCache().bindBuffer(GL_UNIFORM_BUFFER, m_renderID); }
+void opengl::UniformBuffer::bindingPoint(unsigned index) const noexcept { opengl::getStateCache().bindBufferBase(GL_UNIFORM_BUFFER, index, m_renderID); }
 
 opengl::SSBO::SSBO(int) noexcept
 {
@@ -24,9 +26,10 @@ opengl::SSBO::SSBO(int) noexcept
 opengl::SSBO::~SSBO()
 {
     if(canDeallocate()) {
+        opengl::getStateCache().forgetBuffer(m_renderID);
         glDeleteBuffers(1, &m_renderID);
     }
 }
 
-void opengl::SSBO::bind(unsigned slot) const noexcept { glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_renderID); }
-void opengl::SSBO::bindingPoint(unsigned index) const noexcept { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, m_renderID); }
+void opengl::SSBO::bind(unsigned slot) const noexcept { opengl::getStateCache().bindBuffer(GL_SHADER_STORAGE_BUFFER, m_renderID); }
+void opengl::SSBO::bindingPoint(unsigned index) const noexcept { opengl::getStateCache().bindBufferBase(GL_SHADER_STORAGE_BUFFER, index, m_renderID); }
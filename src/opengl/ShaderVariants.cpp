@@ -0,0 +1,53 @@
+#include "ShaderVariants.hpp"
+#include <cassert>
+#include <stdexcept>
+
+opengl::ShaderVariants::ShaderVariants(std::string const &directory, std::vector<std::string> const &featureNames) :
+    m_directory(directory), m_featureNames(featureNames)
+{
+    assert(featureNames.size() <= sizeof(Features) * 8);
+    for(size_t bit = 0; bit < featureNames.size(); ++bit) {
+        if(!featureNames[bit].empty()) m_usedFeatures |= Features{1} << bit;
+    }
+}
+
+opengl::ShaderProgram const *opengl::ShaderVariants::get(Features features)
+{
+    features = mask(features);
+    auto variant = m_variants.find(features);
+    if(variant == m_variants.end()) {
+        std::vector<std::string> defines;
+        for(size_t bit = 0; bit < m_featureNames.size(); ++bit) {
+            if(features & (Features{1} << bit)) defines.push_back(m_featureNames[bit]);
+        }
+        std::unique_ptr<ShaderProgram> program;
+        try {
+            program = std::make_unique<ShaderProgram>(m_directory, defines);
+        } catch(std::runtime_error const &) {
+            // the program printed its log. kept as null, so it is not collected again every frame until a reload
+        }
+        variant = m_variants.emplace(features, std::move(program)).first;
+    }
+    return variant->second && variant->second->poll() ? variant->second.get() : nullptr;
+}
+
+void opengl::ShaderVariants::poll()
+{
+    for(auto &[features, variant] : m_variants) {
+        if(variant) variant->poll();
+    }
+}
+
+unsigned opengl::ShaderVariants::reload(std::filesystem::path const &file)
+{
+    unsigned count = 0;
+    for(auto variant = m_variants.begin(); variant != m_variants.end();) {
+        if(!variant->second) { // failed to collect, it has no dependencies to check. get tries it again
+            variant = m_variants.erase(variant);
+            continue;
+        }
+        if(variant->second->dependsOn(file) && variant->second->reload()) ++count;
+        ++variant;
+    }
+    return count;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Shader.hpp"
+#include <map>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace opengl
+{
+    /**
+     * compile time permutations of one shader directory. every bit of the feature mask stands for a define, the
+     * variant of a mask is compiled the first time it is asked for and kept. the shaders test the features with #ifdef
+     */
+    class ShaderVariants
+    {
+    public:
+        using Features = uint32_t;
+    private:
+        std::string m_directory;
+        std::vector<std::string> m_featureNames; // define of every bit, empty if the shaders ignore the bit
+        Features m_usedFeatures = 0;
+        std::map<Features, std::unique_ptr<ShaderProgram>> m_variants;
+    public:
+        ShaderVariants(std::string const &directory, std::vector<std::string> const &featureNames);
+        ShaderVariants(ShaderVariants const &) = delete;
+        ShaderVariants &operator=(ShaderVariants const &) = delete;
+
+        // the bits the shaders ignore are dropped, so they share a variant
+        inline Features mask(Features features) const { return features & m_usedFeatures; }
+        // submits the variant if it is new. null while it compiles, and after that if collecting or compiling it failed
+        ShaderProgram const *get(Features features);
+        // polls every compiling variant
+        void poll();
+        // reloads the variants that depend on the file, see ShaderProgram::dependsOn. the number of reloaded ones.
+        // the variants that failed to collect are dropped, so the next get collects them again
+        unsigned reload(std::filesystem::path const &file);
+
+        inline std::string const &getDirectory() const { return m_directory; }
+        inline std::map<Features, std::unique_ptr<ShaderProgram>> const &getVariants() const { return m_variants; }
+    };
+} // namespace opengl
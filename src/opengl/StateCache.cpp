@@ -0,0 +1,194 @@
+#include "StateCache.hpp"
+#include <cassert>
+
+template <typename T>
+bool opengl::StateCache::change(T &cached, T const &value)
+{
+    if(cached == value) {
+        ++m_counters.skipped;
+        return false;
+    }
+    cached = value;
+    ++m_counters.issued;
+    return true;
+}
+
+void opengl::StateCache::useProgram(unsigned program)
+{
+    if(change(m_program, program)) glUseProgram(program);
+}
+
+void opengl::StateCache::bindVertexArray(unsigned vertexArray)
+{
+    if(change(m_vertexArray, vertexArray)) glBindVertexArray(vertexArray);
+}
+
+void opengl::StateCache::bindBuffer(GLenum target, unsigned buffer)
+{
+    if(target == GL_ELEMENT_ARRAY_BUFFER) { // vertex array state
+        ++m_counters.issued;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    auto [cached, inserted] = m_buffers.try_emplace(target, UNKNOWN);
+    if(change(cached->second, buffer)) glBindBuffer(target, buffer);
+}
+
+void opengl::StateCache::bindBufferBase(GLenum target, unsigned index, unsigned buffer)
+{
+    auto [cached, inserted] = m_indexedBuffers.try_emplace({target, index}, UNKNOWN);
+    if(change(cached->second, buffer)) {
+        glBindBufferBase(target, index, buffer);
+        m_buffers[target] = buffer; // binds the generic binding point as well, a skipped call does not
+    }
+}
+
+void opengl::StateCache::bindBufferRange(GLenum target, unsigned index, unsigned buffer, GLintptr offset, GLsizeiptr size)
+{
+    ++m_counters.issued;
+    glBindBufferRange(target, index, buffer, offset, size);
+    m_indexedBuffers[{target, index}] = UNKNOWN; // not the whole buffer
+    m_buffers[target] = buffer;
+}
+
+void opengl::StateCache::bindFramebuffer(GLenum target, unsigned framebuffer)
+{
+    switch(target) {
+    case GL_DRAW_FRAMEBUFFER:
+        if(change(m_drawFramebuffer, framebuffer)) glBindFramebuffer(target, framebuffer);
+        break;
+    case GL_READ_FRAMEBUFFER:
+        if(change(m_readFramebuffer, framebuffer)) glBindFramebuffer(target, framebuffer);
+        break;
+    default:
+        assert(target == GL_FRAMEBUFFER);
+        if(m_drawFramebuffer == framebuffer && m_readFramebuffer == framebuffer) {
+            ++m_counters.skipped;
+            break;
+        }
+        ++m_counters.issued;
+        m_drawFramebuffer = m_readFramebuffer = framebuffer;
+        glBindFramebuffer(target, framebuffer);
+        break;
+    }
+}
+
+void opengl::StateCache::activeTexture(unsigned unit)
+{
+    assert(unit < MAX_TEXTURE_UNITS);
+    if(change(m_activeTexture, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void opengl::StateCache::bindTexture(unsigned unit, GLenum target, unsigned texture)
+{
+    activeTexture(unit);
+    auto [units, inserted] = m_textures.try_emplace(target);
+    if(inserted) units->second.fill(UNKNOWN);
+    if(change(units->second[unit], texture)) glBindTexture(target, texture);
+}
+
+void opengl::StateCache::enable(GLenum capability)
+{
+    auto [cached, inserted] = m_capabilities.try_emplace(capability, false);
+    if(inserted) { // unknown
+        ++m_counters.issued;
+        cached->second = true;
+        glEnable(capability);
+    } else if(change(cached->second, true)) {
+        glEnable(capability);
+    }
+}
+
+void opengl::StateCache::disable(GLenum capability)
+{
+    auto [cached, inserted] = m_capabilities.try_emplace(capability, true);
+    if(inserted) {
+        ++m_counters.issued;
+        cached->second = false;
+        glDisable(capability);
+    } else if(change(cached->second, false)) {
+        glDisable(capability);
+    }
+}
+
+void opengl::StateCache::blendFunc(GLenum source, GLenum destination)
+{
+    if(change(m_blendFunc, std::optional<BlendFunc>{BlendFunc{source, destination}})) glBlendFunc(source, destination);
+}
+
+void opengl::StateCache::blendFunci(unsigned buffer, GLenum source, GLenum destination)
+{
+    ++m_counters.issued;
+    m_blendFunc.reset();
+    glBlendFunci(buffer, source, destination);
+}
+
+void opengl::StateCache::blendEquation(GLenum mode)
+{
+    if(change(m_blendEquation, std::optional<GLenum>{mode})) glBlendEquation(mode);
+}
+
+void opengl::StateCache::depthFunc(GLenum func)
+{
+    if(change(m_depthFunc, std::optional<GLenum>{func})) glDepthFunc(func);
+}
+
+void opengl::StateCache::depthMask(bool mask)
+{
+    if(change(m_depthMask, std::optional<bool>{mask})) glDepthMask(mask ? GL_TRUE : GL_FALSE);
+}
+
+void opengl::StateCache::colorMask(bool red, bool green, bool blue, bool alpha)
+{
+    if(change(m_colorMask, std::optional<std::array<bool, 4>>{{red, green, blue, alpha}})) glColorMask(red, green, blue, alpha);
+}
+
+void opengl::StateCache::viewport(int x, int y, int width, int height)
+{
+    if(change(m_viewport, std::optional<std::array<int, 4>>{{x, y, width, height}})) glViewport(x, y, width, height);
+}
+
+void opengl::StateCache::forgetBuffer(unsigned buffer)
+{
+    for(auto &[target, bound] : m_buffers) {
+        if(bound == buffer) bound = 0;
+    }
+    for(auto &[binding, bound] : m_indexedBuffers) {
+        if(bound == buffer) bound = 0;
+    }
+}
+
+void opengl::StateCache::forgetTexture(unsigned texture)
+{
+    for(auto &[target, units] : m_textures) {
+        for(unsigned &bound : units) {
+            if(bound == texture) bound = 0;
+        }
+    }
+}
+
+void opengl::StateCache::forgetFramebuffer(unsigned framebuffer)
+{
+    if(m_drawFramebuffer == framebuffer) m_drawFramebuffer = 0;
+    if(m_readFramebuffer == framebuffer) m_readFramebuffer = 0;
+}
+
+void opengl::StateCache::forgetVertexArray(unsigned vertexArray)
+{
+    if(m_vertexArray == vertexArray) m_vertexArray = 0;
+}
+
+void opengl::StateCache::invalidate()
+{
+    m_program = m_vertexArray = m_drawFramebuffer = m_readFramebuffer = m_activeTexture = UNKNOWN;
+    m_buffers.clear();
+    m_indexedBuffers.clear();
+    m_textures.clear();
+    m_capabilities.clear();
+    m_blendFunc.reset();
+    m_blendEquation.reset();
+    m_depthFunc.reset();
+    m_depthMask.reset();
+    m_colorMask.reset();
+    m_viewport.reset();
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "glad/gl.h"
+#include <array>
+#include <map>
+#include <optional>
+#include <cstddef>
+
+namespace opengl
+{
+    /**
+     * shadow of the bindings and fixed function state of the context, calls that would not change anything are skipped.
+     * only works if every change of the tracked state goes through it: objects bind themselves through it and tell it
+     * when they are deleted, since deleting a bound object resets the binding. the element buffer binding belongs to the
+     * vertex array and is always issued. state starts out unknown, so the first call of every kind is issued
+     */
+    class StateCache
+    {
+    public:
+        static constexpr unsigned MAX_TEXTURE_UNITS = 32;
+        static constexpr unsigned UNKNOWN = ~0u;
+
+        struct Counters
+        {
+            size_t issued = 0;
+            size_t skipped = 0;
+        };
+    private:
+        struct BlendFunc
+        {
+            GLenum source;
+            GLenum destination;
+            inline bool operator==(BlendFunc const &other) const { return source == other.source && destination == other.destination; }
+        };
+        unsigned m_program = UNKNOWN;
+        unsigned m_vertexArray = UNKNOWN;
+        unsigned m_drawFramebuffer = UNKNOWN;
+        unsigned m_readFramebuffer = UNKNOWN;
+        unsigned m_activeTexture = UNKNOWN; // unit index
+        std::map<GLenum, unsigned> m_buffers; // by target
+        std::map<std::pair<GLenum, unsigned>, unsigned> m_indexedBuffers; // by target and index, whole buffer bindings only
+        std::map<GLenum, std::array<unsigned, MAX_TEXTURE_UNITS>> m_textures; // by target, then unit
+        std::map<GLenum, bool> m_capabilities;
+        std::optional<BlendFunc> m_blendFunc;
+        std::optional<GLenum> m_blendEquation;
+        std::optional<GLenum> m_depthFunc;
+        std::optional<bool> m_depthMask;
+        std::optional<std::array<bool, 4>> m_colorMask;
+        std::optional<std::array<int, 4>> m_viewport;
+        Counters m_counters;
+
+        // true if the call has to be issued, counts it either way
+        template <typename T> bool change(T &cached, T const &value);
+    public:
+        StateCache() = default;
+        StateCache(StateCache const &) = delete;
+        StateCache &operator=(StateCache const &) = delete;
+
+        void useProgram(unsigned program);
+        void bindVertexArray(unsigned vertexArray);
+        void bindBuffer(GLenum target, unsigned buffer);
+        void bindBufferBase(GLenum target, unsigned index, unsigned buffer);
+        // never skipped, the offset usually differs. the generic binding changes too
+        void bindBufferRange(GLenum target, unsigned index, unsigned buffer, GLintptr offset, GLsizeiptr size);
+        void bindFramebuffer(GLenum target, unsigned framebuffer);
+        void activeTexture(unsigned unit);
+        // leaves the unit active, so texture calls that follow act on this texture
+        void bindTexture(unsigned unit, GLenum target, unsigned texture);
+
+        void enable(GLenum capability);
+        void disable(GLenum capability);
+        void blendFunc(GLenum source, GLenum destination);
+        // never skipped, makes the blend function of every buffer unknown
+        void blendFunci(unsigned buffer, GLenum source, GLenum destination);
+        void blendEquation(GLenum mode);
+        void depthFunc(GLenum func);
+        void depthMask(bool mask);
+        void colorMask(bool red, bool green, bool blue, bool alpha);
+        void viewport(int x, int y, int width, int height);
+
+        // call right before deleting, the bindings of the deleted object fall back to 0
+        void forgetBuffer(unsigned buffer);
+        void forgetTexture(unsigned texture);
+        void forgetFramebuffer(unsigned framebuffer);
+        void forgetVertexArray(unsigned vertexArray);
+        // after state was changed behind the back of the cache
+        void invalidate();
+
+        inline Counters const &getCounters() const { return m_counters; }
+        inline void resetCounters() { m_counters = {}; }
+    };
+
+    inline StateCache &getStateCache() {
+        static StateCache *cache = new StateCache{};
+        return *cache;
+    }
+} // namespace opengl
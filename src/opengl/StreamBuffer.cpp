@@ -0,0 +1,115 @@
+#include "StreamBuffer.hpp"
+#include "StateCache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+namespace
+{
+    constexpr GLbitfield STORAGE_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+    void waitFor(GLsync fence)
+    {
+        while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fence);
+    }
+} // namespace
+
+opengl::StreamBuffer::StreamBuffer(size_t frameSize)
+{
+    create(frameSize);
+}
+
+opengl::StreamBuffer::~StreamBuffer()
+{
+    if(!canDeallocate()) return;
+    for(GLsync fence : m_fences) {
+        if(fence) glDeleteSync(fence);
+    }
+    for(Retired const &retired : m_retired) {
+        glDeleteSync(retired.fence);
+        opengl::getStateCache().forgetBuffer(retired.buffer);
+        glDeleteBuffers(1, &retired.buffer);
+    }
+    opengl::getStateCache().forgetBuffer(m_renderID);
+    glDeleteBuffers(1, &m_renderID); // unmaps
+}
+
+void opengl::StreamBuffer::create(size_t frameSize)
+{
+    m_frameSize = alignUp(frameSize, MAX_ALIGNMENT);
+    glGenBuffers(1, &m_renderID);
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, m_renderID);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, m_frameSize * FRAME_COUNT, nullptr, STORAGE_FLAGS);
+    m_data = static_cast<std::byte *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_frameSize * FRAME_COUNT, STORAGE_FLAGS));
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    m_frame = 0;
+    m_head = 0;
+}
+
+opengl::StreamBuffer::Allocation opengl::StreamBuffer::allocate(size_t size, size_t alignment)
+{
+    assert(alignment <= MAX_ALIGNMENT && (alignment & (alignment - 1)) == 0);
+    size_t offset = alignUp(m_head, alignment);
+    if(offset + size > m_frameSize) {
+        // the frame outgrew the buffer. the old one keeps the earlier allocations until the gpu is done with them
+        m_retired.push_back(Retired{m_renderID, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        for(GLsync &fence : m_fences) {
+            if(fence) glDeleteSync(fence); // covered by the fence of the retired buffer
+            fence = nullptr;
+        }
+        create(std::max(m_frameSize * 2, size));
+        offset = 0;
+    }
+    m_head = offset + size;
+    size_t bufferOffset = m_frame * m_frameSize + offset;
+    return Allocation{
+        .buffer = m_renderID,
+        .offset = bufferOffset,
+        .data = m_data + bufferOffset
+    };
+}
+
+opengl::StreamBuffer::Allocation opengl::StreamBuffer::push(void const *data, size_t size, size_t alignment)
+{
+    Allocation allocation = allocate(size, alignment);
+    if(size > 0) std::memcpy(allocation.data, data, size);
+    return allocation;
+}
+
+void opengl::StreamBuffer::upload(unsigned buffer, size_t offset, void const *data, size_t size)
+{
+    if(size == 0) return;
+    Allocation allocation = push(data, size, 4);
+    opengl::getStateCache().bindBuffer(GL_COPY_READ_BUFFER, allocation.buffer);
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, offset, size);
+    opengl::getStateCache().bindBuffer(GL_COPY_READ_BUFFER, 0);
+    opengl::getStateCache().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void opengl::StreamBuffer::endFrame()
+{
+    m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_frame = (m_frame + 1) % FRAME_COUNT;
+    m_head = 0;
+    if(m_fences[m_frame]) {
+        waitFor(m_fences[m_frame]); // usually signaled long ago, the region was used FRAME_COUNT - 1 frames back
+        m_fences[m_frame] = nullptr;
+    }
+
+    m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), [](Retired const &retired){
+        GLenum status = glClientWaitSync(retired.fence, 0, 0);
+        if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+        glDeleteSync(retired.fence);
+        opengl::getStateCache().forgetBuffer(retired.buffer);
+        glDeleteBuffers(1, &retired.buffer);
+        return true;
+    }), m_retired.end());
+}
+
+void opengl::StreamBuffer::bind(unsigned slot) const noexcept { opengl::getStateCache().bindBuffer(GL_ARRAY_BUFFER, m_renderID); }
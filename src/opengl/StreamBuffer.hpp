@@ -0,0 +1,82 @@
+#pragma once
+#include "Object.hpp"
+#include "glad/gl.h"
+#include <array>
+#include <vector>
+#include <cstddef>
+
+namespace opengl
+{
+    /**
+     * persistently mapped ring of FRAME_COUNT regions for data written once per frame (instances, indirect commands, bones, glyphs).
+     * allocations bump through the region of the current frame; endFrame fences it and waits until the gpu released the region
+     * that comes next, so nothing is ever re-specified or orphaned. a frame that does not fit moves everything into a bigger buffer,
+     * the old one is deleted once the gpu is done with it
+     */
+    class StreamBuffer : public Object
+    {
+    public:
+        static constexpr unsigned FRAME_COUNT = 3;
+        static constexpr size_t DEFAULT_FRAME_SIZE = 4 << 20;
+        static constexpr size_t MAX_ALIGNMENT = 256; // frame sizes are multiples of it
+
+        struct Allocation
+        {
+            unsigned buffer = 0; // bind this, not the current buffer: it may have been replaced since
+            size_t offset = 0;
+            void *data = nullptr;
+        };
+    private:
+        struct Retired
+        {
+            unsigned buffer;
+            GLsync fence;
+        };
+        std::byte *m_data = nullptr;
+        size_t m_frameSize = 0;
+        std::array<GLsync, FRAME_COUNT> m_fences{};
+        unsigned m_frame = 0;
+        size_t m_head = 0; // in the region of the current frame
+        std::vector<Retired> m_retired;
+
+        void create(size_t frameSize);
+    public:
+        StreamBuffer() = default;
+        StreamBuffer(size_t frameSize);
+        StreamBuffer(StreamBuffer const &) = delete;
+        StreamBuffer &operator=(StreamBuffer const &) = delete;
+        ~StreamBuffer();
+
+        // alignment -- power of two up to MAX_ALIGNMENT
+        Allocation allocate(size_t size, size_t alignment = 16);
+        // copies data into the stream and returns where it went
+        Allocation push(void const *data, size_t size, size_t alignment = 16);
+        // stages data in the stream and copies it into a range of another buffer on the gpu, without waiting for that buffer
+        void upload(unsigned buffer, size_t offset, void const *data, size_t size);
+        // fences the allocations of this frame, may wait for the gpu to release the next region
+        void endFrame();
+
+        void bind(unsigned slot = 0) const noexcept; // as GL_ARRAY_BUFFER
+        inline size_t getFrameSize() const { return m_frameSize; }
+        inline size_t getFrameUsage() const { return m_head; }
+    };
+
+    /*
+     * the stream of per frame data, shared by everything that draws.
+     * deleted explicitly before context termination, like the geometry arena, see deleteStreamBuffer
+     */
+    inline StreamBuffer *&streamBufferInstance() {
+        static StreamBuffer *stream = nullptr; // until the first use, creating it needs a context
+        return stream;
+    }
+    inline StreamBuffer &getStreamBuffer() {
+        StreamBuffer *&stream = streamBufferInstance();
+        if(!stream) stream = new StreamBuffer{StreamBuffer::DEFAULT_FRAME_SIZE};
+        return *stream;
+    }
+    // does nothing if nothing used the stream
+    inline void deleteStreamBuffer() {
+        delete streamBufferInstance();
+        streamBufferInstance() = nullptr;
+    }
+} // namespace opengl
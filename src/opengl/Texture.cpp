@@ -1,7 +1,31 @@
 #include "Texture.hpp"
+#include "StateCache.hpp"
 #include "stb_image.h"
 #include <stdexcept>
 
+namespace
+{
+    bool hasAlphaBelow(void const *pixels, int width, int height, unsigned char alpha)
+    {
+        unsigned char const *texels = static_cast<unsigned char const *>(pixels);
+        size_t count = static_cast<size_t>(width) * height;
+        for(size_t i = 0; i < count; ++i) {
+            if(texels[i * 4 + 3] < alpha) return true;
+        }
+        return false;
+    }
+    void uploadRGBA(void const *pixels, int width, int height, bool srgb)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        
+        glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB_ALPHA : GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+} // namespace
+
 opengl::Texture::Texture(GLenum filtermin, GLenum filtermag, GLenum wrap) noexcept
 {
     glGenTextures(1, &m_renderID);
@@ -13,7 +37,8 @@ opengl::Texture::Texture(GLenum filtermin, GLenum filtermag, GLenum wrap) noexce
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
 }
 
-opengl::Texture::Texture(std::filesystem::path const &filepath, bool flip, bool srgb, std::string const &type) : type(type)
+opengl::Texture::Texture(std::filesystem::path const &filepath, bool flip, bool srgb, std::string const &type) :
+    m_filepath(filepath), m_flip(flip), m_srgb(srgb), type(type)
 {
     stbi_set_flip_vertically_on_load(flip);
     int width = 0, height = 0;
@@ -23,28 +48,47 @@ opengl::Texture::Texture(std::filesystem::path const &filepath, bool flip, bool
 
     glGenTextures(1, &m_renderID);
     bind();
-    
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB_ALPHA : GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
+    uploadRGBA(buffer, width, height, srgb);
+    alphaTested = hasAlphaBelow(buffer, width, height, OPAQUE_ALPHA);
     stbi_image_free(buffer);
 }
 
+opengl::Texture opengl::Texture::fromPixels(void const *pixels, int width, int height, bool srgb, std::string const &type)
+{
+    Texture texture;
+    texture.type = type;
+    glGenTextures(1, &texture.m_renderID);
+    texture.bind();
+    uploadRGBA(pixels, width, height, srgb);
+    texture.alphaTested = hasAlphaBelow(pixels, width, height, OPAQUE_ALPHA);
+    return texture;
+}
+
 opengl::Texture::~Texture()
 {
     if(canDeallocate()) {
+        opengl::getStateCache().forgetTexture(m_renderID);
         glDeleteTextures(1, &m_renderID);
     }
 }
 
 void opengl::Texture::bind(unsigned slot) const noexcept {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, m_renderID);
+    opengl::getStateCache().bindTexture(slot, GL_TEXTURE_2D, m_renderID);
+}
+
+bool opengl::Texture::reload()
+{
+    if(m_filepath.empty() || !m_renderID) return false;
+    stbi_set_flip_vertically_on_load(m_flip);
+    int width = 0, height = 0;
+    unsigned char *buffer = stbi_load(m_filepath.string().c_str(), &width, &height, nullptr, 4);
+    if(!buffer) return false;
+
+    bind();
+    uploadRGBA(buffer, width, height, m_srgb);
+    alphaTested = hasAlphaBelow(buffer, width, height, OPAQUE_ALPHA);
+    stbi_image_free(buffer);
+    return true;
 }
 
 opengl::TextureMS::TextureMS(GLenum filter, GLenum wrap) noexcept
@@ -61,8 +105,9 @@ opengl::TextureMS::TextureMS(GLenum filter, GLenum wrap) noexcept
 opengl::TextureMS::~TextureMS()
 {
     if(canDeallocate()) {
+        opengl::getStateCache().forgetTexture(m_renderID);
         glDeleteTextures(1, &m_renderID);
     }
 }
 
-void opengl::TextureMS::bind(unsigned slot) const noexcept { glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, m_renderID); }
+void opengl::TextureMS::bind(unsigned slot) const noexcept { opengl::getStateCache().bindTexture(slot, GL_TEXTURE_2D_MULTISAMPLE, m_renderID); }
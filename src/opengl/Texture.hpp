@@ -8,14 +8,28 @@ namespace opengl
 {
     class Texture : public Object
     {
+    private:
+        std::filesystem::path m_filepath; // empty unless made from an image file
+        bool m_flip = false;
+        bool m_srgb = false;
     public:
+        static constexpr unsigned char OPAQUE_ALPHA = 230; // the prop shader discards fragments below 0.9 alpha
         std::string type = "";
+        bool alphaTested = false; // some texel is below OPAQUE_ALPHA, only known for textures made from images
         Texture() = default;
         explicit Texture(GLenum filtermin, GLenum filtermag, GLenum wrap = GL_CLAMP_TO_EDGE) noexcept;
         explicit Texture(std::filesystem::path const &filepath, bool flip = false, bool srgb = false, std::string const &type = "");
         ~Texture();
+        // rgba8 texels, rows bottom to top, e.g. straight from a memory mapped cache. not a constructor, a string literal would pick it over the path one
+        static Texture fromPixels(void const *pixels, int width, int height, bool srgb = false, std::string const &type = "");
 
         void bind(unsigned slot = 0) const noexcept;
+        /*
+         * reads the image file again into the same texture object, so every copy shows the new image (their alphaTested stays).
+         * false if the texture is not made from a file or the file fails to load, the old image stays then
+         */
+        bool reload();
+        inline std::filesystem::path const &getFilepath() const { return m_filepath; }
     };
     class TextureMS : public Object
     {
@@ -1,5 +1,6 @@
 #include <cassert>
 #include "VertexBuffer.hpp"
+#include "StateCache.hpp"
 
 opengl::VertexBuffer::VertexBuffer(size_t size, GLenum usage)
 {
@@ -15,11 +16,13 @@ opengl::VertexBuffer::VertexBuffer(size_t size, void const *data, GLenum usage)
 }
 opengl::VertexBuffer::~VertexBuffer()
 {
-    if(canDeallocate()) 
+    if(canDeallocate()) {
+        opengl::getStateCache().forgetBuffer(m_renderID);
         glDeleteBuffers(1, &m_renderID);
+    }
 }
 
-void opengl::VertexBuffer::bind(unsigned) const noexcept { glBindBuffer(GL_ARRAY_BUFFER, m_renderID); }
+void opengl::VertexBuffer::bind(unsigned) const noexcept { opengl::getStateCache().bindBuffer(GL_ARRAY_BUFFER, m_renderID); }
 
 size_t opengl::getSizeOfGLType(GLenum type)
 {
@@ -38,13 +41,23 @@ size_t opengl::getSizeOfGLType(GLenum type)
     }
 }
 
+// integer attributes (e.g. bone ids) have to stay integers, glVertexAttribPointer would convert them to floats
+void vertexAttribPointer(unsigned index, unsigned count, GLenum type, unsigned stride, size_t offset)
+{
+    if(type == GL_FLOAT || type == GL_DOUBLE) {
+        glVertexAttribPointer(index, count, type, false, stride, reinterpret_cast<void const *>(offset));
+    } else {
+        glVertexAttribIPointer(index, count, type, stride, reinterpret_cast<void const *>(offset));
+    }
+}
+
 void opengl::VertexArray::addBuffer(VertexBuffer const &buffer, InterleavedVertexBufferLayout const &layout)
 {
     bind();
     buffer.bind();
     unsigned offset = 0;
     for(InterleavedVertexBufferLayout::Element const &element : layout.getElements()) {
-        glVertexAttribPointer(m_vertexAttribIndex, element.count, element.type, false, layout.getStride(), reinterpret_cast<void const *>(offset));
+        vertexAttribPointer(m_vertexAttribIndex, element.count, element.type, layout.getStride(), offset);
         glEnableVertexAttribArray(m_vertexAttribIndex);
         offset += element.count * getSizeOfGLType(element.type);
         ++m_vertexAttribIndex;
@@ -54,39 +67,45 @@ void opengl::VertexArray::addBuffer(VertexBuffer const &buffer, VertexBufferLayo
 {
     bind(); buffer.bind();
     for(VertexBufferLayout::Element const &element : layout.getElements()) {
-        glVertexAttribPointer(m_vertexAttribIndex, element.count, element.type, false, element.count * getSizeOfGLType(element.type), reinterpret_cast<void const *>(element.offset));
+        vertexAttribPointer(m_vertexAttribIndex, element.count, element.type, element.count * getSizeOfGLType(element.type), element.offset);
         glEnableVertexAttribArray(m_vertexAttribIndex);
         ++m_vertexAttribIndex;
     }
 }
-void opengl::VertexArray::addBuffer(VertexBuffer const &buffer, InterleavedInstancingVertexBufferLayout const &layout)
+void opengl::VertexArray::addBuffer(Object const &buffer, InterleavedInstancingVertexBufferLayout const &layout)
 {
-    bind(); buffer.bind();
-    unsigned offset = 0;
+    setBuffer(m_vertexAttribIndex, buffer.getRenderID(), layout);
+    m_vertexAttribIndex += static_cast<unsigned>(layout.getElements().size());
+}
+void opengl::VertexArray::setBuffer(unsigned firstAttribIndex, unsigned buffer, InterleavedInstancingVertexBufferLayout const &layout, size_t offset)
+{
+    bind(); opengl::getStateCache().bindBuffer(GL_ARRAY_BUFFER, buffer);
+    unsigned attribIndex = firstAttribIndex;
     for(auto const &element : layout.getElements()) {
-        glVertexAttribPointer(m_vertexAttribIndex, element.count, element.type, false, layout.getStride(), reinterpret_cast<void const *>(offset));
-        glVertexAttribDivisor(m_vertexAttribIndex, element.divisor);
-        glEnableVertexAttribArray(m_vertexAttribIndex);
+        vertexAttribPointer(attribIndex, element.count, element.type, layout.getStride(), offset);
+        glVertexAttribDivisor(attribIndex, element.divisor);
+        glEnableVertexAttribArray(attribIndex);
         offset += element.count * getSizeOfGLType(element.type);
-        ++m_vertexAttribIndex;
+        ++attribIndex;
     }
 }
 void opengl::VertexArray::addBuffer(VertexBuffer const &buffer, InstancingVertexBufferLayout const &layout)
 {
     bind(); buffer.bind();
     for(InstancingVertexBufferLayout::Element const &element : layout.getElements()) {
-        glVertexAttribPointer(m_vertexAttribIndex, element.count, element.type, false, element.count * getSizeOfGLType(element.type), reinterpret_cast<void const *>(element.offset));
+        vertexAttribPointer(m_vertexAttribIndex, element.count, element.type, element.count * getSizeOfGLType(element.type), element.offset);
         glEnableVertexAttribArray(m_vertexAttribIndex);
         glVertexAttribDivisor(m_vertexAttribIndex, element.divisor);
         ++m_vertexAttribIndex;
     }
 }
 
-void opengl::VertexArray::bind(unsigned) const noexcept { glBindVertexArray(m_renderID); }
+void opengl::VertexArray::bind(unsigned) const noexcept { opengl::getStateCache().bindVertexArray(m_renderID); }
 
 opengl::VertexArray::~VertexArray()
 {
     if(canDeallocate()) {
+        opengl::getStateCache().forgetVertexArray(m_renderID);
         glDeleteVertexArrays(1, &m_renderID);
     }
 }
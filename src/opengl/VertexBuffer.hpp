@@ -103,15 +103,18 @@ namespace opengl
     public:
         VertexArray() = default;
         ~VertexArray();
-        template <typename Layout_t> VertexArray(VertexBuffer const &buffer, Layout_t const &layout);
+        template <typename Buffer_t, typename Layout_t> VertexArray(Buffer_t const &buffer, Layout_t const &layout);
         void addBuffer(VertexBuffer const &buffer, InterleavedVertexBufferLayout const &layout);
         void addBuffer(VertexBuffer const &buffer, VertexBufferLayout const &layout);
-        void addBuffer(VertexBuffer const &buffer, InterleavedInstancingVertexBufferLayout const &layout);
+        void addBuffer(Object const &buffer, InterleavedInstancingVertexBufferLayout const &layout);
         void addBuffer(VertexBuffer const &buffer, InstancingVertexBufferLayout const &layout);
+        // points attributes added earlier, starting at firstAttribIndex, at another buffer / offset. for data streamed per frame
+        void setBuffer(unsigned firstAttribIndex, unsigned buffer, InterleavedInstancingVertexBufferLayout const &layout, size_t offset = 0);
 
         void bind(unsigned slot = 0) const noexcept;
+        inline unsigned getAttribCount() const noexcept { return m_vertexAttribIndex; }
     };
-    template <typename Layout_t> inline VertexArray::VertexArray(VertexBuffer const &buffer, Layout_t const &layout) { 
+    template <typename Buffer_t, typename Layout_t> inline VertexArray::VertexArray(Buffer_t const &buffer, Layout_t const &layout) { 
         glGenVertexArrays(1, &m_renderID);
         if(layout.getElements().size() != 0)
             addBuffer(buffer, layout); 
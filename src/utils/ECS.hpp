@@ -26,6 +26,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 */
 
 #pragma once
+#include "Profiler.hpp"
 #include <cstdint>
 #include <bitset>
 #include <queue>
@@ -49,7 +50,7 @@ namespace ecs
     /**
      * \brief Controls the maximum number of entities allowed to exist simultaneously.
      */
-    const Entity_t MAX_ENTITIES = 5000;
+    const Entity_t MAX_ENTITIES = 20000;
     /**
      * \brief Controls the maximum number of registered components allowed to exist simultaneously.
      */
@@ -184,6 +185,10 @@ namespace ecs
          */
         template <typename System_t> std::shared_ptr<System_t> registerSystem();
         template <typename System_t> void removeSystem();
+        /**
+         * @return The registered system, null if System_t was never registered.
+         */
+        template <typename System_t> std::shared_ptr<System_t> getSystem() const;
         void update(double deltatime) const;
         /**
          * get the lists of entities
@@ -210,6 +215,8 @@ namespace ecs
     template <typename Component_t> void removeComponent(Entity_t const &entity);
     template <typename Component_t> void addComponent(Entity_t const &entity, Component_t const &component = {});
     template <typename... Components_t> ecs::Entity_t makeEntity();
+    // removes the components of the entity and takes it out of the system entities, its id gets reused
+    void destroyEntity(Entity_t const &entity);
 } // namespace ecs
 
 
@@ -278,6 +285,8 @@ inline void ecs::ComponentArray<Component_t>::remove(Entity_t const &entity)
     Entity_t lastEntity = m_indexToEntity.at(lastEntityIndex);
     m_entityToIndex.at(lastEntity) = removedEntityIndex;
     m_indexToEntity.at(removedEntityIndex) = lastEntity;
+    m_entityToIndex.erase(entity); // after the moves, the removed entity may be the last one
+    m_indexToEntity.erase(lastEntityIndex);
     m_components.pop_back();
 }
 template <typename Component_t>
@@ -371,9 +380,16 @@ inline void ecs::SystemManager::removeSystem()
     assert(m_systems.find(name) != m_systems.end() && "system not registered before use");
     m_systems.erase(name);
 }
+template <typename System_t>
+inline std::shared_ptr<System_t> ecs::SystemManager::getSystem() const
+{
+    auto system = m_systems.find(typeid(System_t).name());
+    return system != m_systems.end() ? std::static_pointer_cast<System_t>(system->second) : nullptr;
+}
 inline void ecs::SystemManager::update(double deltatime) const
 {
     for(auto const &[name, system] : m_systems) {
+        profiler::CpuScope scope{name, "system"};
         system->update(m_entities, deltatime);
     }
 }
@@ -411,3 +427,9 @@ void ecs::addComponent(Entity_t const &entity, Component_t const &component)
     getComponentManager().addComponent<Component_t>(entity, component);
     getEntityManager().getSignature(entity).set(getComponentManager().getComponentID<Component_t>(), true);
 }
+inline void ecs::destroyEntity(Entity_t const &entity)
+{
+    getComponentManager().entityDestroyed(entity);
+    getEntityManager().destroyEntity(entity);
+    getSystemManager().getEntities().erase(entity);
+}
@@ -0,0 +1,104 @@
+#include "FileWatcher.hpp"
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+#ifdef __linux__
+    constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE; // created directories get watches of their own
+#endif
+} // namespace
+
+FileWatcher::FileWatcher(std::vector<std::filesystem::path> const &directories)
+{
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_inotify < 0) return;
+    if(pipe2(m_wakeup, O_CLOEXEC) != 0) {
+        close(m_inotify);
+        m_inotify = -1;
+        return;
+    }
+    for(std::filesystem::path const &directory : directories) {
+        addWatches(directory);
+    }
+    m_thread = std::thread{&FileWatcher::run, this};
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if(m_thread.joinable()) {
+        char stop = 0;
+        while(write(m_wakeup[1], &stop, 1) < 0 && errno == EINTR);
+        m_thread.join();
+    }
+    for(int file : {m_inotify, m_wakeup[0], m_wakeup[1]}) {
+        if(file >= 0) close(file);
+    }
+#endif
+}
+
+void FileWatcher::addWatches(std::filesystem::path const &directory)
+{
+#ifdef __linux__
+    std::error_code error;
+    if(!std::filesystem::is_directory(directory, error)) return;
+    std::vector<std::filesystem::path> directories{directory};
+    for(std::filesystem::recursive_directory_iterator iter{directory, error}, end; !error && iter != end; iter.increment(error)) {
+        if(iter->is_directory(error)) directories.push_back(iter->path());
+    }
+    for(std::filesystem::path const &path : directories) {
+        int watch = inotify_add_watch(m_inotify, path.c_str(), WATCH_MASK);
+        if(watch >= 0) m_watches[watch] = path;
+    }
+#endif
+}
+
+void FileWatcher::run()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    pollfd files[2] = {{m_inotify, POLLIN, 0}, {m_wakeup[0], POLLIN, 0}};
+    while(true) {
+        if(poll(files, 2, -1) < 0) {
+            if(errno == EINTR) continue;
+            return;
+        }
+        if(files[1].revents) return;
+        ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+        if(length <= 0) continue; // nothing yet or interrupted
+        for(char const *pointer = buffer; pointer < buffer + length;) {
+            inotify_event const *event = reinterpret_cast<inotify_event const *>(pointer);
+            pointer += sizeof(inotify_event) + event->len;
+            auto watch = m_watches.find(event->wd);
+            if(event->mask & IN_IGNORED) { // the directory is gone
+                if(watch != m_watches.end()) m_watches.erase(watch);
+                continue;
+            }
+            if(watch == m_watches.end() || event->len == 0) continue;
+            std::filesystem::path path = watch->second / event->name;
+            if(event->mask & IN_ISDIR) {
+                addWatches(path);
+            } else if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) { // a created file is reported once it is written
+                std::lock_guard lock{m_mutex};
+                m_changes.insert(path);
+            }
+        }
+    }
+#endif
+}
+
+std::vector<std::filesystem::path> FileWatcher::takeChanges()
+{
+    std::lock_guard lock{m_mutex};
+    std::vector<std::filesystem::path> changes{m_changes.begin(), m_changes.end()};
+    m_changes.clear();
+    return changes;
+}
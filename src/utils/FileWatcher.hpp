@@ -0,0 +1,37 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/**
+ * collects the files written in a few directory trees, from a thread that sleeps on inotify until something changes.
+ * the main thread takes the changes once per frame, so the reloading stays on the thread that owns the context.
+ * a file is reported once it is closed after writing or renamed into place, and once per take however often it was written.
+ * watches nothing where inotify is not available
+ */
+class FileWatcher
+{
+private:
+    std::mutex m_mutex;
+    std::set<std::filesystem::path> m_changes; // guarded by m_mutex
+    std::map<int, std::filesystem::path> m_watches; // watch descriptor -> directory, only the thread touches it once started
+    int m_inotify = -1;
+    int m_wakeup[2] = {-1, -1}; // pipe, the destructor writes to it to stop the thread
+    std::thread m_thread;
+
+    // the directory and the ones below it
+    void addWatches(std::filesystem::path const &directory);
+    void run();
+public:
+    explicit FileWatcher(std::vector<std::filesystem::path> const &directories);
+    FileWatcher(FileWatcher const &) = delete;
+    FileWatcher &operator=(FileWatcher const &) = delete;
+    ~FileWatcher();
+
+    // the files written since the last call, the paths start with the watched directory they are in
+    std::vector<std::filesystem::path> takeChanges();
+    inline bool isWatching() const { return m_thread.joinable(); }
+};
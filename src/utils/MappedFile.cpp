@@ -0,0 +1,42 @@
+#include "MappedFile.hpp"
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+MappedFile::MappedFile(std::filesystem::path const &path)
+{
+#ifndef _WIN32
+    int file = open(path.c_str(), O_RDONLY);
+    if(file < 0) return;
+    struct stat status{};
+    if(fstat(file, &status) == 0 && status.st_size > 0) {
+        void *data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if(data != MAP_FAILED) {
+            m_data = static_cast<std::byte const *>(data);
+            m_size = static_cast<size_t>(status.st_size);
+            m_mapped = true;
+        }
+    }
+    close(file); // the mapping stays valid
+#else
+    std::ifstream stream{path, std::ios::binary | std::ios::ate};
+    if(!stream) return;
+    m_fallback.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    if(m_fallback.empty() || !stream.read(reinterpret_cast<char *>(m_fallback.data()), static_cast<std::streamsize>(m_fallback.size()))) return;
+    m_data = m_fallback.data();
+    m_size = m_fallback.size();
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if(m_mapped) munmap(const_cast<std::byte *>(m_data), m_size);
+#endif
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+#include <cstddef>
+
+/**
+ * read only view of a whole file, memory mapped where the platform allows it and read into memory otherwise
+ */
+class MappedFile
+{
+private:
+    std::byte const *m_data = nullptr;
+    size_t m_size = 0;
+    std::vector<std::byte> m_fallback;
+    bool m_mapped = false;
+public:
+    MappedFile() = default;
+    explicit MappedFile(std::filesystem::path const &path);
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+    ~MappedFile();
+
+    inline bool isOpen() const { return m_data != nullptr; }
+    inline std::byte const *data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+};
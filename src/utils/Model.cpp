@@ -1,6 +1,7 @@
 #include "Model.hpp"
 #include "Model.hpp"
 #include "assimp/postprocess.h"
+#include "Profiler.hpp"
 #include <iostream>
 
 constexpr glm::mat4 toMat4(aiMatrix4x4 const &from)
@@ -202,50 +203,27 @@ void model::Model::processNode(aiNode const *node, int flags, aiScene const *sce
 
 void makeDrawable(game::Drawable &drawable, model::MeshData &data) 
 {
-    drawable.vb = opengl::VertexBuffer{
-        data.positions.size()     * sizeof(data.positions[0]) + 
-        data.normals.size()       * sizeof(data.normals[0]) + 
-        data.textureCoords.size() * sizeof(data.textureCoords[0]) + 
-        data.tangents.size()      * sizeof(data.tangents[0]) + 
-        data.boneIDs.size() * sizeof(data.boneIDs[0]) +
-        data.weights.size() * sizeof(data.weights[0])
-    };
-    glBufferSubData(GL_ARRAY_BUFFER, 
-        0, 
-        data.positions.size() * sizeof(data.positions[0]), 
-        data.positions.data());
-    glBufferSubData(GL_ARRAY_BUFFER, 
-        data.positions.size() * sizeof(data.positions[0]), 
-        data.normals.size() * sizeof(data.normals[0]), 
-        data.normals.data());
-    glBufferSubData(GL_ARRAY_BUFFER, 
-        data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]), 
-        data.textureCoords.size() * sizeof(data.textureCoords[0]), 
-        data.textureCoords.data());
-    glBufferSubData(GL_ARRAY_BUFFER, 
-        data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]) + data.textureCoords.size() * sizeof(data.textureCoords[0]), 
-        data.tangents.size() * sizeof(data.tangents[0]), 
-        data.tangents.data());
-    if(!data.boneIDs.empty()) {
-        glBufferSubData(GL_ARRAY_BUFFER, 
-            data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]) + data.textureCoords.size() * sizeof(data.textureCoords[0]) + data.tangents.size() * sizeof(data.tangents[0]), 
-            data.boneIDs.size() * sizeof(data.boneIDs[0]), 
-            data.boneIDs.data());
-        glBufferSubData(GL_ARRAY_BUFFER, 
-            data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]) + data.textureCoords.size() * sizeof(data.textureCoords[0]) + data.tangents.size() * sizeof(data.tangents[0]) + data.boneIDs.size() * sizeof(data.boneIDs[0]), 
-            data.weights.size() * sizeof(data.weights[0]), 
-            data.weights.data());
+    std::vector<model::Vertex> vertices(data.positions.size());
+    for(size_t i = 0; i < vertices.size(); ++i) {
+        model::Vertex &vertex = vertices[i];
+        vertex.position = data.positions[i];
+        vertex.normal = data.normals[i];
+        vertex.textureCoord = data.textureCoords[i];
+        vertex.tangent = data.tangents[i];
+        if(data.boneIDs.empty()) {
+            vertex.boneIDs.fill(-1);
+            vertex.weights.fill(0);
+        } else {
+            vertex.boneIDs = data.boneIDs[i];
+            vertex.weights = data.weights[i];
+        }
     }
+    assert(model::getGeometryArena().getVertexSize() == sizeof(model::Vertex));
 
-    drawable.ib = opengl::IndexBuffer{data.indices.size() * sizeof(data.indices[0]), data.indices.data()};
-    drawable.va = opengl::VertexArray{drawable.vb, opengl::VertexBufferLayout{
-        {4, GL_FLOAT, 0},
-        {4, GL_FLOAT, data.positions.size() * sizeof(data.positions[0])},
-        {2, GL_FLOAT, data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0])},
-        {4, GL_FLOAT, data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]) + data.textureCoords.size() * sizeof(data.textureCoords[0])},
-        {4, GL_FLOAT, data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]) + data.textureCoords.size() * sizeof(data.textureCoords[0]) + data.tangents.size() * sizeof(data.tangents[0])},
-        {4, GL_FLOAT, data.positions.size() * sizeof(data.positions[0]) + data.normals.size() * sizeof(data.normals[0]) + data.textureCoords.size() * sizeof(data.textureCoords[0]) + data.tangents.size() * sizeof(data.tangents[0]) + data.boneIDs.size() * sizeof(data.boneIDs[0])},
-    }};
+    drawable.geometry = model::getGeometryArena().allocateShared(
+        vertices.data(), static_cast<unsigned>(vertices.size()), 
+        data.indices.data(), static_cast<unsigned>(data.indices.size())
+    );
     drawable.count = static_cast<unsigned>(data.indices.size());
 }
 void extractBones(model::MeshData &data, std::map<std::string, unsigned> &boneMap, std::vector<glm::mat4> &boneTransformations, aiMesh const *aimesh, aiScene const *scene) 
@@ -299,6 +277,20 @@ void extractVertexData(model::MeshData &data, aiMesh const *aimesh)
     }
 }
 
+void computeBounds(model::Mesh &mesh, model::MeshData const &data)
+{
+    if(data.positions.empty()) return;
+    mesh.bounds = AABB<glm::vec3>{glm::vec3{data.positions[0]}, glm::vec3{data.positions[0]}};
+    for(glm::vec4 const &position : data.positions) {
+        mesh.bounds.growToInclude(glm::vec3{position});
+    }
+    mesh.boundingSphere.center = mesh.bounds.getCenter();
+    mesh.boundingSphere.radius = 0;
+    for(glm::vec4 const &position : data.positions) {
+        mesh.boundingSphere.radius = glm::max(mesh.boundingSphere.radius, glm::length(glm::vec3{position} - mesh.boundingSphere.center));
+    }
+}
+
 void loadMaterialTextures(std::vector<opengl::Texture> &textures, aiMaterial const *material, aiTextureType const type, std::string const &typeName, int flags, std::vector<std::pair<std::string, opengl::Texture>> &loadedTextureCache, std::filesystem::path const &textureDirectory)
 {
     aiString str;
@@ -331,6 +323,7 @@ model::Mesh model::Model::processMesh(aiMesh const *aimesh, int flags, aiScene c
     Mesh mesh{};
     mesh.data.emplace();
     extractVertexData(mesh.data.value(), aimesh);
+    computeBounds(mesh, mesh.data.value());
     if(aimesh->HasBones()) {
         extractBones(mesh.data.value(), m_boneMap, m_tposeTransform, aimesh, scene);
         m_boneTransformations.resize(m_tposeTransform.size());
@@ -341,11 +334,13 @@ model::Mesh model::Model::processMesh(aiMesh const *aimesh, int flags, aiScene c
         makeDrawable(mesh.drawable.value(), mesh.data.value());
     }
 
-    aiMaterial const *material = scene->mMaterials[aimesh->mMaterialIndex];
-    loadMaterialTextures(mesh.textures, material, aiTextureType_DIFFUSE,  "diffuse",  flags, m_loadedTextures, m_directory);
-    loadMaterialTextures(mesh.textures, material, aiTextureType_SPECULAR, "specular", flags, m_loadedTextures, m_directory);
-    loadMaterialTextures(mesh.textures, material, aiTextureType_HEIGHT,   "normal",   flags, m_loadedTextures, m_directory);
-    loadMaterialTextures(mesh.textures, material, aiTextureType_NORMALS,  "normal",   flags, m_loadedTextures, m_directory);
+    if(flags & LOAD_DRAWABLE) { // textures are only needed to draw, data only models (occluders) stay off the gpu
+        aiMaterial const *material = scene->mMaterials[aimesh->mMaterialIndex];
+        loadMaterialTextures(mesh.textures, material, aiTextureType_DIFFUSE,  "diffuse",  flags, m_loadedTextures, m_directory);
+        loadMaterialTextures(mesh.textures, material, aiTextureType_SPECULAR, "specular", flags, m_loadedTextures, m_directory);
+        loadMaterialTextures(mesh.textures, material, aiTextureType_HEIGHT,   "normal",   flags, m_loadedTextures, m_directory);
+        loadMaterialTextures(mesh.textures, material, aiTextureType_NORMALS,  "normal",   flags, m_loadedTextures, m_directory);
+    }
 
     if(!(flags & LOAD_DATA)) { // deallocate data
         mesh.data = {};
@@ -356,6 +351,8 @@ model::Mesh model::Model::processMesh(aiMesh const *aimesh, int flags, aiScene c
 
 model::Model::Model(std::filesystem::path const &filePath, int flags)
 {
+    std::string traceName = "import " + filePath.filename().string();
+    profiler::CpuScope scope{traceName, "load"};
     m_importer = std::make_shared<Assimp::Importer>();
     m_scene = m_importer->ReadFile( filePath.string().c_str(),
         aiProcess_GenNormals            |
@@ -375,6 +372,13 @@ model::Model::Model(std::filesystem::path const &filePath, int flags)
     m_directory = filePath.parent_path();
     m_globalInverseTransorm = toMat4(m_scene->mRootNode->mTransformation.Inverse());
     processNode(m_scene->mRootNode, flags, m_scene);
+
+    if(!m_meshes.empty()) {
+        m_bounds = m_meshes.front().bounds;
+        for(Mesh const &mesh : m_meshes) {
+            m_bounds.growToInclude(mesh.bounds);
+        }
+    }
 }
 
 std::vector<glm::mat4> const &model::Model::getBoneTransformations(float animationTimeSeconds, aiAnimation const *animation)
@@ -405,3 +409,12 @@ std::vector<glm::mat4> const &model::Model::getBoneTransformations(aiAnimation c
     processAnimationNode(getScene()->mRootNode, first, firstTimeTicks, second, secondTimeTicks, factor, glm::mat4{1.0f}, m_globalInverseTransorm, m_boneMap, m_boneTransformations, m_tposeTransform);
     return m_boneTransformations;
 }
+
+unsigned model::Model::reloadTexture(std::filesystem::path const &path)
+{
+    unsigned count = 0;
+    for(auto &[filepath, texture] : m_loadedTextures) {
+        if(std::filesystem::weakly_canonical(filepath) == std::filesystem::weakly_canonical(path) && texture.reload()) ++count;
+    }
+    return count;
+}
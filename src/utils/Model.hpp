@@ -1,5 +1,6 @@
 #pragma once
 #include "game/Renderer.hpp" // for Drawable struct
+#include "game/Frustum.hpp"
 #include "utils/ECS.hpp" // for entity from model construction
 #include <vector>
 #include "assimp/scene.h"
@@ -24,11 +25,24 @@ namespace model
         std::vector<std::array<int, MAX_BONES_PER_VERTEX>> boneIDs;
         std::vector<std::array<float, MAX_BONES_PER_VERTEX>> weights;
     };
+    // interleaved vertex of the shared geometry arena, attribute locations 0 - 5 of the prop / oit shaders
+    struct Vertex
+    {
+        glm::vec4 position;
+        glm::vec4 normal;
+        glm::vec2 textureCoord;
+        glm::vec4 tangent;
+        std::array<int, MAX_BONES_PER_VERTEX> boneIDs;
+        std::array<float, MAX_BONES_PER_VERTEX> weights;
+    };
     struct Mesh 
     {
         std::optional<MeshData> data;
         std::optional<game::Drawable> drawable;
         std::vector<opengl::Texture> textures;
+        // local space bounding volumes, computed at import
+        AABB<glm::vec3> bounds;
+        game::BoundingSphere boundingSphere;
     };
     enum LoadFlags 
     {
@@ -39,6 +53,32 @@ namespace model
         FLIP_WINDING_ORDER = 1 << 3 
     };
 
+    /**
+     * every drawable mesh lives in this arena, so all of them can be drawn through one vertex array.
+     * deleted explicitly before context termination, like the ecs managers, see deleteGeometryArena
+     */
+    inline opengl::GeometryArena *&geometryArenaInstance() {
+        static opengl::GeometryArena *arena = nullptr; // until the first use, creating it needs a context
+        return arena;
+    }
+    inline opengl::GeometryArena &getGeometryArena() {
+        opengl::GeometryArena *&arena = geometryArenaInstance();
+        if(!arena) arena = new opengl::GeometryArena{opengl::InterleavedVertexBufferLayout{
+            {4, GL_FLOAT}, // position
+            {4, GL_FLOAT}, // normal
+            {2, GL_FLOAT}, // texture coordinates
+            {4, GL_FLOAT}, // tangent
+            {MAX_BONES_PER_VERTEX, GL_INT},  // bone ids
+            {MAX_BONES_PER_VERTEX, GL_FLOAT} // weights
+        }, 1 << 16, 1 << 18};
+        return *arena;
+    }
+    // does nothing if nothing used the arena
+    inline void deleteGeometryArena() {
+        delete geometryArenaInstance();
+        geometryArenaInstance() = nullptr;
+    }
+
     class Model 
     {
     private:
@@ -50,6 +90,7 @@ namespace model
         std::filesystem::path m_directory;
         std::vector<std::pair<std::string, opengl::Texture>> m_loadedTextures;
         glm::mat4 m_globalInverseTransorm;
+        AABB<glm::vec3> m_bounds; // union of mesh bounds
         std::shared_ptr<Assimp::Importer> m_importer;
         aiScene const *m_scene;
         
@@ -66,8 +107,12 @@ namespace model
         std::vector<glm::mat4> const &getBoneTransformations(aiAnimation const *first, aiAnimation const *second, float factor, float firstTimeTicks, float secondTimeTicks);
         std::vector<glm::mat4> const &getBoneTransformations(float firstTimeSeconds, float secondTimeSeconds, aiAnimation const *first, aiAnimation const *second, float factor);
 
+        // reloads the material textures made from the file, the copies of the model share them. the number of reloaded textures
+        unsigned reloadTexture(std::filesystem::path const &path);
+
         inline std::vector<Mesh> const &getMeshes() const { return m_meshes; }
         inline std::vector<Mesh> &getMeshes() { return m_meshes; }
         inline aiScene const *getScene() const { return m_scene; }
+        inline AABB<glm::vec3> const &getBounds() const { return m_bounds; }
     };
 } // namespace model
@@ -0,0 +1,157 @@
+#include "Profiler.hpp"
+#include "glad/gl.h"
+#include "json.hpp"
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <cstdlib>
+#include <cassert>
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+
+namespace
+{
+    constexpr unsigned SKIPPED = ~0u; // open scope that got no queries
+
+    std::string demangle(std::string const &name)
+    {
+#ifdef __GNUC__
+        int status = 0;
+        std::unique_ptr<char, void (*)(void *)> demangled{abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status), std::free};
+        if(status == 0 && demangled) return demangled.get();
+#endif
+        return name;
+    }
+} // namespace
+
+profiler::Profiler::~Profiler()
+{
+    if(!m_enabled) return;
+    write();
+    for(QueryPool &pool : m_pools) {
+        if(pool.queries[0]) glDeleteQueries(static_cast<int>(pool.queries.size()), pool.queries.data());
+    }
+}
+
+void profiler::Profiler::enable(std::filesystem::path const &path)
+{
+    m_path = path;
+    m_enabled = true;
+    m_epoch = std::chrono::steady_clock::now();
+}
+
+int64_t profiler::Profiler::now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_epoch).count();
+}
+
+unsigned profiler::Profiler::getThread()
+{
+    // small ids in order of appearance, GPU_THREAD is taken
+    auto [thread, inserted] = m_threads.try_emplace(std::this_thread::get_id(), static_cast<unsigned>(m_threads.size() + 1));
+    return thread->second;
+}
+
+void profiler::Profiler::addEvent(std::string_view name, char const *category, int64_t start, int64_t end)
+{
+    std::lock_guard lock{m_mutex};
+    m_events.push_back(Event{std::string{name}, category, start, end - start, getThread()});
+}
+
+void profiler::Profiler::beginGpuScope(std::string_view name)
+{
+    QueryPool &pool = m_pools[m_frame % FRAME_COUNT];
+    if(pool.pending || pool.used + 2 > pool.queries.size()) { // still in flight or full, never wait for it
+        m_openScopes.push_back(SKIPPED);
+        return;
+    }
+    if(!pool.queries[0]) glGenQueries(static_cast<int>(pool.queries.size()), pool.queries.data());
+    if(!m_calibrated) {
+        GLint64 gpuTime = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+        m_gpuOffset = now() * 1000 - gpuTime;
+        m_calibrated = true;
+    }
+    unsigned beginQuery = pool.used++;
+    unsigned endQuery = pool.used++;
+    glQueryCounter(pool.queries[beginQuery], GL_TIMESTAMP);
+    pool.lastIssued = beginQuery;
+    m_openScopes.push_back(static_cast<unsigned>(pool.scopes.size()));
+    pool.scopes.push_back(GpuScope{std::string{name}, beginQuery, endQuery});
+}
+
+void profiler::Profiler::endGpuScope()
+{
+    if(m_openScopes.empty()) return; // enabled inside the scope
+    unsigned scope = m_openScopes.back();
+    m_openScopes.pop_back();
+    if(scope == SKIPPED) return;
+    QueryPool &pool = m_pools[m_frame % FRAME_COUNT];
+    glQueryCounter(pool.queries[pool.scopes[scope].endQuery], GL_TIMESTAMP);
+    pool.lastIssued = pool.scopes[scope].endQuery;
+}
+
+void profiler::Profiler::readBack(QueryPool &pool)
+{
+    // the queries finish in the order they were issued, the last issued one being available means all of them are
+    int available = 0;
+    glGetQueryObjectiv(pool.queries[pool.lastIssued], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available) return;
+
+    std::lock_guard lock{m_mutex};
+    for(GpuScope const &scope : pool.scopes) {
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(pool.queries[scope.beginQuery], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(pool.queries[scope.endQuery], GL_QUERY_RESULT, &end);
+        int64_t start = (static_cast<int64_t>(begin) + m_gpuOffset) / 1000;
+        m_events.push_back(Event{scope.name, "gpu", start, static_cast<int64_t>(end - begin) / 1000, GPU_THREAD});
+    }
+    pool.scopes.clear();
+    pool.used = 0;
+    pool.pending = false;
+}
+
+void profiler::Profiler::endFrame()
+{
+    if(!m_enabled) return;
+    assert(m_openScopes.empty() && "gpu scopes have to end within the frame");
+    QueryPool &current = m_pools[m_frame % FRAME_COUNT];
+    if(!current.pending && current.used > 0) current.pending = true;
+    for(QueryPool &pool : m_pools) {
+        if(pool.pending) readBack(pool);
+    }
+    ++m_frame;
+}
+
+bool profiler::Profiler::write() const
+{
+    using json = nlohmann::json;
+    std::ofstream file{m_path};
+    if(!file) {
+        std::cout << "failed to write the trace " << m_path << "\n";
+        return false;
+    }
+    // one event per line, the file gets big
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << json{{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", GPU_THREAD}, {"args", {{"name", "gpu"}}}}.dump();
+    for(auto const &[id, thread] : m_threads) {
+        std::string name = thread == 1 ? "main" : "worker " + std::to_string(thread);
+        file << ",\n" << json{{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", thread}, {"args", {{"name", name}}}}.dump();
+    }
+    for(Event const &event : m_events) {
+        file << ",\n" << json{
+            {"name", std::string_view{event.category} == "system" ? demangle(event.name) : event.name},
+            {"cat", event.category},
+            {"ph", "X"},
+            {"ts", event.start},
+            {"dur", event.duration},
+            {"pid", 1},
+            {"tid", event.thread}
+        }.dump();
+    }
+    file << "\n]}\n";
+    std::cout << "wrote " << m_events.size() << " trace events to " << m_path << "\n";
+    return true;
+}
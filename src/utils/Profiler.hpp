@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <mutex>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+namespace profiler
+{
+    /**
+     * collects cpu scopes and gpu timestamps and writes them as a chrome trace_event json file (chrome://tracing, perfetto).
+     * does nothing until enabled. gpu scopes are GL_TIMESTAMP query pairs recorded into one pool per frame; FRAME_COUNT pools
+     * rotate and a pool is only read back once its last query is available, a frame whose pool is still in flight records no gpu scopes.
+     * gpu times are moved onto the cpu timeline with an offset taken when the first gpu scope is recorded
+     */
+    class Profiler
+    {
+    public:
+        static constexpr unsigned FRAME_COUNT = 3;
+        static constexpr unsigned MAX_GPU_SCOPES = 64; // per frame
+        static constexpr unsigned GPU_THREAD = 0; // trace thread id of the gpu timeline
+
+        struct Event
+        {
+            std::string name;
+            char const *category;
+            int64_t start;    // microseconds since the profiler was enabled
+            int64_t duration; // microseconds
+            unsigned thread;
+        };
+    private:
+        struct GpuScope
+        {
+            std::string name;
+            unsigned beginQuery;
+            unsigned endQuery;
+        };
+        struct QueryPool
+        {
+            std::array<unsigned, MAX_GPU_SCOPES * 2> queries{};
+            std::vector<GpuScope> scopes;
+            unsigned used = 0;
+            unsigned lastIssued = 0; // index of the query written last, nested scopes end out of array order
+            bool pending = false; // recorded, not read back yet
+        };
+        std::filesystem::path m_path;
+        bool m_enabled = false;
+        std::chrono::steady_clock::time_point m_epoch;
+        std::mutex m_mutex;
+        std::vector<Event> m_events;
+        std::map<std::thread::id, unsigned> m_threads;
+
+        std::array<QueryPool, FRAME_COUNT> m_pools;
+        unsigned m_frame = 0;
+        std::vector<unsigned> m_openScopes; // indices into the scopes of the current pool
+        int64_t m_gpuOffset = 0; // nanoseconds, cpu minus gpu
+        bool m_calibrated = false;
+
+        unsigned getThread();
+        void readBack(QueryPool &pool);
+    public:
+        Profiler() = default;
+        Profiler(Profiler const &) = delete;
+        Profiler &operator=(Profiler const &) = delete;
+        ~Profiler(); // writes the trace, needs the context the queries were made in
+
+        // the trace is written to path on destruction
+        void enable(std::filesystem::path const &path);
+        inline bool isEnabled() const { return m_enabled; }
+        int64_t now() const;
+
+        void addEvent(std::string_view name, char const *category, int64_t start, int64_t end);
+        // gpu scopes nest, they have to be recorded on the thread of the context
+        void beginGpuScope(std::string_view name);
+        void endGpuScope();
+        // reads back finished pools and starts recording into the next one
+        void endFrame();
+        bool write() const;
+    };
+
+    inline Profiler &getProfiler() {
+        static Profiler *profiler = new Profiler{};
+        return *profiler;
+    }
+
+    // times the enclosing block on the calling thread
+    class CpuScope
+    {
+    private:
+        std::string_view m_name;
+        char const *m_category;
+        int64_t m_start = 0;
+    public:
+        // the name has to outlive the scope. category "system" marks type names, they are demangled
+        inline explicit CpuScope(std::string_view name, char const *category = "cpu") :
+            m_name(name), m_category(category)
+        {
+            if(getProfiler().isEnabled()) m_start = getProfiler().now();
+        }
+        inline ~CpuScope()
+        {
+            if(getProfiler().isEnabled()) getProfiler().addEvent(m_name, m_category, m_start, getProfiler().now());
+        }
+        CpuScope(CpuScope const &) = delete;
+        CpuScope &operator=(CpuScope const &) = delete;
+    };
+
+    // times the enclosing block on the cpu and the commands it submits on the gpu
+    class GpuScope
+    {
+    private:
+        CpuScope m_cpuScope;
+    public:
+        inline explicit GpuScope(std::string_view name) :
+            m_cpuScope(name, "render")
+        {
+            if(getProfiler().isEnabled()) getProfiler().beginGpuScope(name);
+        }
+        inline ~GpuScope()
+        {
+            if(getProfiler().isEnabled()) getProfiler().endGpuScope();
+        }
+        GpuScope(GpuScope const &) = delete;
+        GpuScope &operator=(GpuScope const &) = delete;
+    };
+} // namespace profiler
@@ -1,19 +1,71 @@
 #include <iostream>
 #include <fstream>
+#include <cstring>
 #include "json.hpp"
+#include "stb_image.h"
 #include "Text.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
 
 constexpr float magicValue = 6; // ??
 
+namespace
+{
+    constexpr uint32_t CACHE_MAGIC = 0x43544E46; // "FNTC"
+
+    struct CacheHeader // followed by the glyph records, the kerning pairs and width * height rgba texels, bottom row first
+    {
+        uint32_t magic;
+        uint32_t version;
+        std::array<uint64_t, 4> stamp;
+        float newLineSize;
+        float spacing;
+        float spaceSize;
+        float pixelRange;
+        glm::vec2 dimensions;
+        int32_t width;
+        int32_t height;
+        uint32_t glyphCount;
+        uint32_t kerningCount;
+    };
+
+    void stampFile(std::filesystem::path const &path, uint64_t &size, uint64_t &time)
+    {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        if(error) size = 0;
+        auto writeTime = std::filesystem::last_write_time(path, error);
+        time = error ? 0 : static_cast<uint64_t>(writeTime.time_since_epoch().count());
+    }
+} // namespace
+
 text::Font::Font(std::filesystem::path const &atlas, std::filesystem::path const &metadata)
 {
-    // TODO: better atlas storage?
-    // TODO: kerning
-    m_textShader = opengl::ShaderProgram{"shaders/drawText", true};
-    // ========
-    
-    m_atlas.texture = opengl::Texture{atlas, true, false, "msdf-atlas"};
-    
+    std::filesystem::path cache = std::filesystem::path{metadata}.replace_extension(".fontcache");
+    SourceStamp stamp;
+    stampFile(metadata, stamp[0], stamp[1]);
+    stampFile(atlas, stamp[2], stamp[3]);
+    if(loadCache(cache, stamp)) return;
+
+    stbi_set_flip_vertically_on_load(true);
+    int width = 0, height = 0;
+    unsigned char *texels = stbi_load(atlas.string().c_str(), &width, &height, nullptr, 4);
+    if(!texels) throw std::runtime_error{"failed to load a texture"};
+    m_atlas.texture = opengl::Texture::fromPixels(texels, width, height, false, "msdf-atlas");
+
+    std::vector<GlyphRecord> glyphs;
+    try {
+        glyphs = parseMetadata(metadata);
+    } catch(...) {
+        stbi_image_free(texels);
+        throw;
+    }
+    writeCache(cache, stamp, glyphs, texels, width, height);
+    stbi_image_free(texels);
+}
+
+std::vector<text::Font::GlyphRecord> text::Font::parseMetadata(std::filesystem::path const &metadata)
+{
     using json = nlohmann::json;
     std::ifstream metadataFileStream{metadata};
     if(!metadataFileStream) {
@@ -38,8 +90,10 @@ text::Font::Font(std::filesystem::path const &atlas, std::filesystem::path const
     m_pixelRange = m_atlas.dimensions.x / size * range;
 
     m_atlas.glyphs = {};
+    std::vector<GlyphRecord> glyphs;
+    glyphs.reserve(jsonGlyphs.size());
     for(json &jsonGlyph : jsonGlyphs) {
-        auto unicode = static_cast<wchar_t>(jsonGlyph.at("unicode").get<int>());
+        auto unicode = static_cast<char32_t>(jsonGlyph.at("unicode").get<int>());
         if(unicode == 32) {
             m_spaceSize = jsonGlyph.at("advance").get<float>() / magicValue;
             continue;
@@ -54,68 +108,172 @@ text::Font::Font(std::filesystem::path const &atlas, std::filesystem::path const
             .advance = jsonGlyph.at("advance").get<float>() / magicValue
         };
 
-        m_atlas.glyphs.try_emplace(unicode, glyphData);
+        m_atlas.glyphs.insert(unicode, glyphData);
+        glyphs.push_back(GlyphRecord{unicode, glyphData});
+    }
+
+    m_kerning.clear();
+    if(jsonMetadata.contains("kerning") && jsonMetadata.at("kerning").is_array()) {
+        for(json &jsonPair : jsonMetadata["kerning"]) {
+            m_kerning.push_back(KerningPair{
+                .pair = static_cast<uint64_t>(jsonPair.at("unicode1").get<uint32_t>()) << 32 | jsonPair.at("unicode2").get<uint32_t>(),
+                .advance = jsonPair.at("advance").get<float>() / magicValue
+            });
+        }
+        std::sort(m_kerning.begin(), m_kerning.end(), [](KerningPair const &a, KerningPair const &b){ return a.pair < b.pair; });
     }
+    return glyphs;
 }
-void text::Font::drawText(std::string const &text, glm::vec2 const &position, float size, glm::vec4 const &fgColor, glm::vec4 const &bgColor, glm::mat4 const &projectionMatrix)
+bool text::Font::loadCache(std::filesystem::path const &cache, SourceStamp const &stamp)
 {
-    struct GlyphRenderData {
-        glm::vec2 quadPosition;
-        glm::vec2 quadSize;
-        glm::vec2 glyphOffset;
-        glm::vec2 glyphSize;
+    MappedFile file{cache};
+    if(!file.isOpen() || file.size() < sizeof(CacheHeader)) return false;
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.stamp != stamp) return false;
+    if(header.width <= 0 || header.height <= 0) return false;
+
+    size_t glyphsSize = static_cast<size_t>(header.glyphCount) * sizeof(GlyphRecord);
+    size_t kerningSize = static_cast<size_t>(header.kerningCount) * sizeof(KerningPair);
+    size_t texelsSize = static_cast<size_t>(header.width) * header.height * 4;
+    if(file.size() != sizeof(CacheHeader) + glyphsSize + kerningSize + texelsSize) return false;
+
+    std::byte const *cursor = file.data() + sizeof(CacheHeader);
+    std::vector<GlyphRecord> glyphs(header.glyphCount);
+    std::memcpy(glyphs.data(), cursor, glyphsSize);
+    cursor += glyphsSize;
+    m_kerning.resize(header.kerningCount);
+    std::memcpy(m_kerning.data(), cursor, kerningSize);
+    cursor += kerningSize;
+
+    m_newLineSize = header.newLineSize;
+    m_spacing = header.spacing;
+    m_spaceSize = header.spaceSize;
+    m_pixelRange = header.pixelRange;
+    m_atlas.dimensions = header.dimensions;
+    m_atlas.glyphs = {};
+    for(GlyphRecord const &record : glyphs) {
+        m_atlas.glyphs.insert(record.codepoint, record.glyph);
+    }
+    m_atlas.texture = opengl::Texture::fromPixels(cursor, header.width, header.height, false, "msdf-atlas");
+    return true;
+}
+void text::Font::writeCache(std::filesystem::path const &cache, SourceStamp const &stamp, std::vector<GlyphRecord> const &glyphs, unsigned char const *texels, int width, int height) const
+{
+    CacheHeader header{
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .stamp = stamp,
+        .newLineSize = m_newLineSize,
+        .spacing = m_spacing,
+        .spaceSize = m_spaceSize,
+        .pixelRange = m_pixelRange,
+        .dimensions = m_atlas.dimensions,
+        .width = width,
+        .height = height,
+        .glyphCount = static_cast<uint32_t>(glyphs.size()),
+        .kerningCount = static_cast<uint32_t>(m_kerning.size())
     };
-    std::vector<GlyphRenderData> renderData;
+    // written next to the final name and renamed, so a crash never leaves a half written cache behind
+    std::filesystem::path temporary = std::filesystem::path{cache} += ".tmp";
     {
-        glm::vec2 currentPosition = {position.x, position.y};
-        for(auto const &character : text) { // fuck that shit
-            if(character == L' ') {
-                currentPosition.x += size * m_spaceSize;
-                continue;
-            } else if(character == L'\n') {
-                currentPosition.x = position.x;
-                currentPosition.y -= m_newLineSize * size;
-                continue;
-            }
-            auto dataIter = m_atlas.glyphs.find(character);
-            if(dataIter == m_atlas.glyphs.end()) {
-                std::cout << "failed to find glyph for char \'" << character << "\'!\n";
-            }
-            GlyphData const &data = dataIter->second;
-
-            GlyphRenderData currentRenderData{};
-            currentRenderData.quadPosition = { currentPosition.x, currentPosition.y + data.verticalOffset * size };
-            currentRenderData.quadSize = { data.size.x * size, data.size.y * size };
-            currentRenderData.glyphOffset = data.offset;
-            currentRenderData.glyphSize = data.size;
-            
-            renderData.push_back(currentRenderData);
-    
-            currentPosition.x += data.size.x * size + m_spacing;
+        std::ofstream stream{temporary, std::ios::binary | std::ios::trunc};
+        if(!stream) {
+            std::cout << "failed to write font cache \"" << cache.string() << "\"!\n";
+            return;
+        }
+        stream.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<char const *>(glyphs.data()), glyphs.size() * sizeof(GlyphRecord));
+        stream.write(reinterpret_cast<char const *>(m_kerning.data()), m_kerning.size() * sizeof(KerningPair));
+        stream.write(reinterpret_cast<char const *>(texels), static_cast<size_t>(width) * height * 4);
+        if(!stream) {
+            std::cout << "failed to write font cache \"" << cache.string() << "\"!\n";
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, cache, error);
+    if(error) std::filesystem::remove(temporary, error);
+}
+void text::Font::GlyphTable::insert(char32_t codepoint, GlyphData const &glyph)
+{
+    if(codepoint < DENSE_SIZE) {
+        if(m_densePresent[codepoint]) return; // first one wins, like map::try_emplace
+        m_dense[codepoint] = glyph;
+        m_densePresent[codepoint] = true;
+    } else {
+        m_sparse.try_emplace(codepoint, glyph);
+    }
+}
+float text::Font::getKerning(char32_t first, char32_t second) const
+{
+    if(m_kerning.empty()) return 0;
+    uint64_t pair = static_cast<uint64_t>(first) << 32 | second;
+    auto iter = std::lower_bound(m_kerning.begin(), m_kerning.end(), pair, [](KerningPair const &kerning, uint64_t pair){ return kerning.pair < pair; });
+    return iter != m_kerning.end() && iter->pair == pair ? iter->advance : 0;
+}
+char32_t text::decodeUTF8(char const *&it, char const *end)
+{
+    constexpr char32_t REPLACEMENT = 0xFFFD;
+    auto lead = static_cast<unsigned char>(*it++);
+    if(lead < 0x80) return lead;
+
+    unsigned length;
+    char32_t codepoint;
+    char32_t min;
+    if((lead & 0xE0) == 0xC0) { length = 1; codepoint = lead & 0x1F; min = 0x80; }
+    else if((lead & 0xF0) == 0xE0) { length = 2; codepoint = lead & 0x0F; min = 0x800; }
+    else if((lead & 0xF8) == 0xF0) { length = 3; codepoint = lead & 0x07; min = 0x10000; }
+    else return REPLACEMENT; // continuation byte or invalid lead
+
+    char const *start = it;
+    for(unsigned i = 0; i < length; ++i) {
+        if(it == end || (static_cast<unsigned char>(*it) & 0xC0) != 0x80) {
+            it = start;
+            return REPLACEMENT;
         }
+        codepoint = codepoint << 6 | (static_cast<unsigned char>(*it++) & 0x3F);
+    }
+    if(codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        it = start;
+        return REPLACEMENT;
     }
+    return codepoint;
+}
+void text::Font::layoutText(std::string const &text, float size, unsigned textIndex, std::vector<GlyphInstance> &glyphs) const
+{
+    glm::vec2 currentPosition{0};
+    glyphs.reserve(glyphs.size() + text.size());
+    char32_t previous = 0;
+    for(char const *it = text.data(), *end = text.data() + text.size(); it != end;) {
+        char32_t character = decodeUTF8(it, end);
+        if(character == U' ') {
+            currentPosition.x += size * m_spaceSize;
+            previous = character;
+            continue;
+        } else if(character == U'\n') {
+            currentPosition.x = 0;
+            currentPosition.y -= m_newLineSize * size;
+            previous = 0;
+            continue;
+        }
+        GlyphData const *glyph = m_atlas.glyphs.find(character);
+        if(!glyph) {
+            std::cout << "failed to find glyph for code point U+" << std::hex << static_cast<uint32_t>(character) << std::dec << "!\n";
+            continue;
+        }
+        GlyphData const &data = *glyph;
+        if(previous) currentPosition.x += getKerning(previous, character) * size;
+        previous = character;
+
+        glyphs.push_back(GlyphInstance{
+            .offset = {currentPosition.x, currentPosition.y + data.verticalOffset * size},
+            .size = data.size * size,
+            .glyphOffset = data.offset,
+            .glyphSize = data.size,
+            .text = textIndex
+        });
 
-    m_textShader.bind();
-    glDisable(GL_DEPTH_TEST);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_BLEND);
-    glUniform4fv(m_textShader.getUniform("u_fgColor"), 1, &fgColor.r);
-    glUniform4fv(m_textShader.getUniform("u_bgColor"), 1, &bgColor.r);
-    glUniform1i (m_textShader.getUniform("u_atlas"), 0);
-    glUniform1f (m_textShader.getUniform("u_screenPxRange"), m_pixelRange);
-    glUniformMatrix4fv(m_textShader.getUniform("u_projMat"), 1, GL_FALSE, &projectionMatrix[0][0]);
-    m_atlas.texture.bind(0);
-    opengl::VertexBuffer renderDataBuffer{renderData.size() * sizeof(GlyphRenderData), renderData.data()};
-    opengl::VertexArray quadVAO{renderDataBuffer, opengl::InterleavedInstancingVertexBufferLayout{ 
-        {2, GL_FLOAT, 1},
-        {2, GL_FLOAT, 1},
-        {2, GL_FLOAT, 1},
-        {2, GL_FLOAT, 1}
-    }};
-    glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, static_cast<int>(renderData.size()));
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindVertexArray(0);
-    glUseProgram(0);
-    glEnable(GL_DEPTH_TEST);
+        currentPosition.x += data.size.x * size + m_spacing;
+    }
 }
@@ -4,6 +4,10 @@
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <array>
+#include <bitset>
+#include <unordered_map>
+#include <cstdint>
 
 #include "opengl/Texture.hpp"
 #include "opengl/Shader.hpp"
@@ -26,28 +30,85 @@ namespace text
             float verticalOffset;
             float advance;
         };
+        // directly indexed for ascii / latin-1, hashed for the rest of unicode
+        class GlyphTable
+        {
+        public:
+            static constexpr char32_t DENSE_SIZE = 256;
+        private:
+            std::array<GlyphData, DENSE_SIZE> m_dense{};
+            std::bitset<DENSE_SIZE> m_densePresent;
+            std::unordered_map<char32_t, GlyphData> m_sparse;
+        public:
+            void insert(char32_t codepoint, GlyphData const &glyph);
+            inline GlyphData const *find(char32_t codepoint) const {
+                if(codepoint < DENSE_SIZE) return m_densePresent[codepoint] ? &m_dense[codepoint] : nullptr;
+                auto iter = m_sparse.find(codepoint);
+                return iter != m_sparse.end() ? &iter->second : nullptr;
+            }
+            inline size_t size() const { return m_densePresent.count() + m_sparse.size(); }
+        };
         struct Atlas {
             opengl::Texture texture;
-            std::map<wchar_t, GlyphData> glyphs;
+            GlyphTable glyphs;
             glm::vec2 dimensions;
         };
+        struct GlyphInstance // per instance vertex attributes of the drawText shader
+        {
+            glm::vec2 offset; // of the quad from the text position, scaled by the size
+            glm::vec2 size;
+            glm::vec2 glyphOffset; // in the atlas
+            glm::vec2 glyphSize;
+            unsigned text; // index of the text in its batch
+        };
     private:
-        opengl::ShaderProgram m_textShader;
+        struct KerningPair
+        {
+            uint64_t pair; // first codepoint in the high half, so the table sorts by it
+            float advance;
+        };
+        struct GlyphRecord
+        {
+            char32_t codepoint;
+            GlyphData glyph;
+        };
+        using SourceStamp = std::array<uint64_t, 4>; // size and write time of the metadata and the atlas
+        static constexpr uint32_t CACHE_VERSION = 1;
         Atlas m_atlas;
+        std::vector<KerningPair> m_kerning; // sorted by pair
         float m_newLineSize = 0;
         float m_spacing = 0;
         float m_spaceSize = 0;
         float m_pixelRange = 0;
         glm::vec2 m_atlasDimensions;
+
+        std::vector<GlyphRecord> parseMetadata(std::filesystem::path const &metadata);
+        // false if the cache is missing, broken or older than the sources
+        bool loadCache(std::filesystem::path const &cache, SourceStamp const &stamp);
+        void writeCache(std::filesystem::path const &cache, SourceStamp const &stamp, std::vector<GlyphRecord> const &glyphs, unsigned char const *texels, int width, int height) const;
     public:
         Font() = default;
         ~Font() = default;
+        /*
+         * the parsed metadata and the decoded atlas are cached in a binary file next to the metadata (.fontcache),
+         * later runs map it and upload the texels straight from it. the cache is rebuilt when either source changes
+         */
         Font(std::filesystem::path const &atlas, std::filesystem::path const &metadata);
 
-        void drawText(std::string const &text, glm::vec2 const &position, float size, glm::vec4 const &fgColor = {1, 1, 1, 1}, glm::vec4 const &bgColor = {0, 0, 0, 0}, glm::mat4 const &projectionMatrix = glm::mat4{1.0f});
+        // appends the glyph quads of the text, drawn by game::TextRenderer
+        void layoutText(std::string const &text, float size, unsigned textIndex, std::vector<GlyphInstance> &glyphs) const;
 
         inline Atlas const &getAtlas() const { return m_atlas; }
+        inline float getPixelRange() const { return m_pixelRange; }
+        // extra advance between two glyphs, in the units of layoutText's size
+        float getKerning(char32_t first, char32_t second) const;
     };
+    /*
+     * decodes the code point at it and moves it past it. malformed, overlong and truncated sequences
+     * decode to U+FFFD one byte at a time, so the loop always makes progress
+     */
+    char32_t decodeUTF8(char const *&it, char const *end);
+
     template <typename T> std::vector<T> charRange(T first, T last)
     {
         std::vector<T> result(last - first);